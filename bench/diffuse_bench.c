@@ -0,0 +1,459 @@
+//******************************************************************************
+//  @file
+//  diffuse_bench - Benchmark of the perform routine of the headless core
+//  Yves Candau - ycandau@gmail.com
+//
+//  Usage:
+//  diffuse_bench [-q] [-f scenario] [-k kernels] [-c control rate] [-l lut error] [-r] [-e] [-t threads] [-b baseline file] [-s save file]
+//    -q:  Quick run, a subset of the sizes and vector sizes
+//    -f:  Only run one scenario: fix / var / frozen / velocity / sparse
+//    -k:  Force the sample loop kernels: scalar / sse2 / avx2 / avx512
+//    -c:  Split the ramps into sub-blocks of this many samples
+//    -l:  Use curve tables with this error bound
+//    -r:  Ramp with the exponential ramping function instead of the crossfade function
+//    -e:  Ramp with exact exponential ramps, at sample resolution
+//    -t:  Split the perform routine across this many threads, for the matrices large enough
+//    -b:  Compare the results against a stored baseline
+//    -s:  Save the results as a new baseline
+//
+//  Reports for each scenario, matrix size and vector size:
+//    ns/route:  Average time per sample and per input-output route
+//    worst us:  Worst case time for one perform call
+//    touched:   Memory touched by a perform call, averaged over the calls, from the arrays of the path it takes:
+//               the vectors of the outputs and of the inputs that are not silent, with
+//               the rows of effective gains of the blocked engine, or the arrays of the active routes
+//               of the route loop and the partial outputs of the helper threads
+//
+
+// ========  HEADER FILES  ========
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "diffuse_core.h"
+
+// ========  DEFINES  ========
+
+#define BENCH_SAMPLERATE  48000.0
+#define BENCH_ROUTES      40000000.0  // Sample-routes to process per measurement
+#define BENCH_VEC_MIN     8           // Minimum number of perform calls per measurement
+#define BENCH_BASELINE_MAX 1024       // Maximum number of lines in a baseline file
+#define BENCH_SPARSE_ROUTES 4         // Number of outputs per input in the sparse scenario
+
+// ========  STRUCTURES  ========
+
+typedef enum _scenario {
+
+  SCEN_FIX,         // Static gains: MODE_TYPE_FIX
+  SCEN_VAR,         // All channels ramping: MODE_TYPE_VAR
+  SCEN_FROZEN,      // All channels frozen in the middle of a ramp
+  SCEN_VELOCITY,    // Short ramps with a fractional velocity: chunks and iterations
+  SCEN_SPARSE,      // Static gains, each input sent to BENCH_SPARSE_ROUTES outputs
+  SCEN_LAST
+
+} t_scenario;
+
+typedef struct _size {
+
+  t_int32 channel_cnt;
+  t_int32 out_cnt;
+
+} t_size;
+
+typedef struct _result {
+
+  char    scen[16];
+  t_int32 channel_cnt;
+  t_int32 out_cnt;
+  t_int32 vec_size;
+  double  ns_route;
+
+} t_result;
+
+// ========  GLOBAL VARIABLES  ========
+
+static const char* scen_names[SCEN_LAST] = { "fix", "var", "frozen", "velocity", "sparse" };
+static const char* simd_names[SIMD_LAST] = { "scalar", "sse2", "avx2", "avx512", "auto" };
+
+static t_simd_type simd_type = SIMD_AUTO;
+static t_int32 control_rate = 0;
+static t_double lut_err = 0;
+static t_bool is_ramp = false;
+static t_bool is_exact = false;
+static t_int32 thread_cnt = 1;
+
+static const t_size sizes[] = { {8, 8}, {16, 16}, {32, 32}, {64, 48}, {128, 64}, {256, 128} };
+static const t_int32 vec_sizes[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+
+static const t_size sizes_quick[] = { {8, 8}, {64, 48}, {256, 128} };
+static const t_int32 vec_sizes_quick[] = { 64, 512, 4096 };
+
+#define ARR_CNT(arr) ((t_int32)(sizeof(arr) / sizeof(arr[0])))
+
+// ========  FUNCTIONS  ========
+
+// ====  NOW_NS  ====
+
+static double now_ns(void) {
+
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+// ====  BENCH_RAMP  ====
+
+//******************************************************************************
+//  Start a ramp on a channel towards one of two states, alternating.
+//
+static void bench_ramp(t_core* core, t_channel* channel, t_state* states, t_int32 cntd) {
+
+  t_state* state = states + ((channel->state_ind == 0) ? 1 : 0);
+  state->U_cur = is_ramp ? state->U_rm_arr : state->U_xf_arr;
+  _channel_set_interp(core, channel, is_ramp ? INTERP_TYPE_RAMP : INTERP_TYPE_XFADE);
+  _state_ramp(core, channel, state, cntd, 0);
+}
+
+// ====  BENCH_TOUCHED  ====
+
+//******************************************************************************
+//  Bytes read or written by one perform call, from the path the core takes for the current state,
+//  with the same conditions as core_perform. Each array is counted once, however often it is walked.
+//
+static double bench_touched(t_core* core, t_int32 vec_size) {
+
+  double vec_bytes = (double)vec_size * sizeof(t_double);
+
+  // All the outputs are written, either with the mix or set to zero
+  double touched = core->out_cnt * vec_bytes;
+
+  // Blocked engine: the inputs that are not silent and their padded rows of effective gains
+  if ((vec_size <= core->mix_vec_max) && _core_is_static(core)
+    && (_core_route_cnt(core) >= core->mix_density_min * core->channel_cnt * core->out_cnt)) {
+
+    for (t_int32 in = 0; in < core->channel_cnt; in++) {
+      t_channel* channel = core->channel_arr + in;
+      if (!channel->is_on || channel->is_silent || (channel->gain_mast == 0)) { continue; }
+      touched += vec_bytes + (double)core->out_pad * sizeof(t_double);
+    }
+    return touched;
+  }
+
+  // Route loop: the active routes of each channel that is on, and the input if it is not silent
+  // A fixed route reads its effective gain, a ramping route the four rows of the channel
+  // and the scratch of the curve: abscissa and ordinate, and the ratio of an exact ramp
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+    t_channel* channel = core->channel_arr + in;
+    if (!channel->is_on || (channel->route_cnt == 0)) { continue; }
+
+    t_bool is_fixed = (channel->mode_type == MODE_TYPE_FIX) || (channel->is_frozen) || (channel->cntd == INDEFINITE);
+    t_int32 route_vals = is_fixed ? 1 : (channel->is_exact ? 7 : 6);
+
+    if (!channel->is_silent) { touched += vec_bytes; }
+    touched += (double)channel->route_cnt * (sizeof(t_int32) + route_vals * sizeof(t_double));
+  }
+
+  // The helpers add into their own outputs, which are then added together
+  if (core->workers && (core->channel_cnt * core->out_cnt >= core->thread_routes_min)) {
+    touched += (double)(core->thread_cnt - 1) * core->out_cnt * vec_bytes;
+  }
+
+  return touched;
+}
+
+// ====  BENCH_SETUP  ====
+
+//******************************************************************************
+//  Set the channels of a core for one scenario.
+//
+static void bench_setup(t_core* core, t_state* states, t_scenario scen) {
+
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+    t_channel* channel = core->channel_arr + in;
+    channel->is_on = true;
+
+    // Every input sent to every output, with distinct gains
+    // or in the sparse scenario to a few neighbouring outputs
+    for (t_int32 out = 0; out < core->out_cnt; out++) {
+      channel->A_cur[out] = 0.1 + 0.8 * (t_double)((in + out) % 7) / 7.0;
+      if ((scen == SCEN_SPARSE) && ((out + core->out_cnt - in % core->out_cnt) % core->out_cnt >= BENCH_SPARSE_ROUTES)) {
+        channel->A_cur[out] = 0;
+      }
+    }
+    _channel_set_interp(core, channel, is_ramp ? INTERP_TYPE_RAMP : INTERP_TYPE_XFADE);
+    _channel_calc_absc(core, channel);
+    _channel_calc_routes(core, channel);
+
+    switch (scen) {
+
+    case SCEN_FIX:
+      break;
+
+    case SCEN_VAR:
+      bench_ramp(core, channel, states, (t_int32)(60 * BENCH_SAMPLERATE));
+      break;
+
+    case SCEN_FROZEN:
+      bench_ramp(core, channel, states, (t_int32)(60 * BENCH_SAMPLERATE));
+      channel->is_frozen = true;
+      break;
+
+    case SCEN_VELOCITY:
+      channel->velocity = 0.37;
+      bench_ramp(core, channel, states, (t_int32)(0.01 * BENCH_SAMPLERATE) + in);
+      break;
+
+    default:
+      break;
+    }
+  }
+}
+
+// ====  BENCH_RUN  ====
+
+//******************************************************************************
+//  Run one measurement and print the result.
+//
+static t_my_err bench_run(t_scenario scen, t_size size, t_int32 vec_size, t_result* result) {
+
+  t_core core[1];
+  t_state states[2];
+  t_double** in_arr = NULL;
+  t_double** out_arr = NULL;
+  t_my_err err = ERR_ALLOC;
+
+  core_init(core, size.channel_cnt, size.out_cnt, BENCH_SAMPLERATE);
+  core->kernels = kernels_select(simd_type);
+  core->control_rate = control_rate;
+  core->ramp_is_exact = is_exact;
+  core_set_threads(core, thread_cnt);
+  _state_init(states, NULL);
+  _state_init(states + 1, NULL);
+
+  in_arr = (t_double**)calloc(size.channel_cnt, sizeof(t_double*));
+  out_arr = (t_double**)calloc(size.out_cnt, sizeof(t_double*));
+  if (!in_arr || !out_arr) { goto cleanup; }
+
+  for (t_int32 in = 0; in < size.channel_cnt; in++) {
+    if (!(in_arr[in] = (t_double*)malloc(sizeof(t_double) * vec_size))) { goto cleanup; }
+    for (t_int32 smp = 0; smp < vec_size; smp++) { in_arr[in][smp] = sin(0.01 * (smp + 17 * in)); }
+  }
+  for (t_int32 out = 0; out < size.out_cnt; out++) {
+    if (!(out_arr[out] = (t_double*)malloc(sizeof(t_double) * vec_size))) { goto cleanup; }
+  }
+
+  if (core_alloc(core) != ERR_NONE) { goto cleanup; }
+  if (_state_alloc(states, size.out_cnt, 0, 0) != ERR_NONE) { goto cleanup; }
+  if (_state_alloc(states + 1, size.out_cnt, 0, 1) != ERR_NONE) { goto cleanup; }
+  states[0].index = 0;
+  states[1].index = 1;
+  core_set_curves(core, lut_err);
+  core_curves_publish(core);
+  _state_calc_absc(core, states);
+  _state_calc_absc(core, states + 1);
+
+  core_dsp(core, BENCH_SAMPLERATE, vec_size);
+  bench_setup(core, states, scen);
+
+  // Number of perform calls for the measurement
+  double routes = (double)size.channel_cnt * size.out_cnt * vec_size;
+  t_int32 vec_cnt = (t_int32)(BENCH_ROUTES / routes);
+  if (vec_cnt < BENCH_VEC_MIN) { vec_cnt = BENCH_VEC_MIN; }
+
+  // Warm up the caches
+  core_perform(core, in_arr, out_arr, vec_size);
+
+  double total = 0;
+  double worst = 0;
+  double touched = 0;
+
+  for (t_int32 vec = 0; vec < vec_cnt; vec++) {
+
+    // The path of each call depends on the state at its start: averaged over the calls
+    touched += bench_touched(core, vec_size) / vec_cnt;
+
+    double t0 = now_ns();
+    core_perform(core, in_arr, out_arr, vec_size);
+    double t1 = now_ns() - t0;
+
+    total += t1;
+    if (t1 > worst) { worst = t1; }
+
+    // Restart the ramps that ended, outside of the measurement
+    if (scen == SCEN_VELOCITY) {
+      for (t_int32 in = 0; in < size.channel_cnt; in++) {
+        t_channel* channel = core->channel_arr + in;
+        if (channel->mode_type == MODE_TYPE_FIX) {
+          bench_ramp(core, channel, states, (t_int32)(0.01 * BENCH_SAMPLERATE) + in);
+        }
+      }
+    }
+  }
+
+  strncpy(result->scen, scen_names[scen], sizeof(result->scen) - 1);
+  result->scen[sizeof(result->scen) - 1] = '\0';
+  result->channel_cnt = size.channel_cnt;
+  result->out_cnt = size.out_cnt;
+  result->vec_size = vec_size;
+  result->ns_route = total / (vec_cnt * routes);
+
+  printf("%-9s %4i x %-4i %6i   %9.4f   %10.1f   %9.1f",
+    result->scen, size.channel_cnt, size.out_cnt, vec_size, result->ns_route, worst / 1000, touched / 1024);
+
+  err = ERR_NONE;
+
+cleanup:
+
+  core_free(core);
+  _state_free(states);
+  _state_free(states + 1);
+
+  if (in_arr) {
+    for (t_int32 in = 0; in < size.channel_cnt; in++) { free(in_arr[in]); }
+    free(in_arr);
+  }
+  if (out_arr) {
+    for (t_int32 out = 0; out < size.out_cnt; out++) { free(out_arr[out]); }
+    free(out_arr);
+  }
+
+  return err;
+}
+
+// ====  BASELINE_LOAD  ====
+
+//******************************************************************************
+//  Load a baseline file: one result per line, lines starting with # are ignored.
+//  Returns the number of results loaded.
+//
+static t_int32 baseline_load(const char* path, t_result* base_arr, t_int32 base_max) {
+
+  FILE* file = fopen(path, "r");
+  if (!file) { return 0; }
+
+  char line[256];
+  t_int32 cnt = 0;
+
+  while ((cnt < base_max) && fgets(line, sizeof(line), file)) {
+
+    t_result* base = base_arr + cnt;
+    if (line[0] == '#') { continue; }
+    if (sscanf(line, "%15s %i %i %i %lf", base->scen, &base->channel_cnt, &base->out_cnt,
+        &base->vec_size, &base->ns_route) == 5) {
+      cnt++;
+    }
+  }
+
+  fclose(file);
+  return cnt;
+}
+
+// ====  BASELINE_FIND  ====
+
+static t_result* baseline_find(t_result* base_arr, t_int32 base_cnt, t_result* result) {
+
+  for (t_int32 i = 0; i < base_cnt; i++) {
+    t_result* base = base_arr + i;
+    if ((!strcmp(base->scen, result->scen)) && (base->channel_cnt == result->channel_cnt)
+        && (base->out_cnt == result->out_cnt) && (base->vec_size == result->vec_size)) {
+      return base;
+    }
+  }
+
+  return NULL;
+}
+
+// ========  MAIN  ========
+
+int main(int argc, char** argv) {
+
+  t_bool is_quick = false;
+  const char* filter = NULL;
+  const char* base_path = NULL;
+  const char* save_path = NULL;
+
+  // ==== Arguments
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-q")) { is_quick = true; }
+    else if ((!strcmp(argv[i], "-f")) && (i + 1 < argc)) { filter = argv[++i]; }
+    else if ((!strcmp(argv[i], "-k")) && (i + 1 < argc)) {
+      const char* name = argv[++i];
+      for (t_int32 st = 0; st < SIMD_LAST; st++) {
+        if (!strcmp(name, simd_names[st])) { simd_type = (t_simd_type)st; }
+      }
+    }
+    else if ((!strcmp(argv[i], "-c")) && (i + 1 < argc)) { control_rate = atoi(argv[++i]); }
+    else if ((!strcmp(argv[i], "-l")) && (i + 1 < argc)) { lut_err = atof(argv[++i]); }
+    else if (!strcmp(argv[i], "-r")) { is_ramp = true; }
+    else if (!strcmp(argv[i], "-e")) { is_ramp = true; is_exact = true; }
+    else if ((!strcmp(argv[i], "-t")) && (i + 1 < argc)) { thread_cnt = atoi(argv[++i]); }
+    else if ((!strcmp(argv[i], "-b")) && (i + 1 < argc)) { base_path = argv[++i]; }
+    else if ((!strcmp(argv[i], "-s")) && (i + 1 < argc)) { save_path = argv[++i]; }
+    else {
+      fprintf(stderr, "Usage:  %s [-q] [-f fix / var / frozen / velocity / sparse] [-k scalar / sse2 / avx2 / avx512]"
+        " [-c control rate] [-l lut error] [-r] [-e] [-t threads] [-b baseline file] [-s save file]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  // ==== Baseline
+
+  t_result base_arr[BENCH_BASELINE_MAX];
+  t_int32 base_cnt = 0;
+
+  if (base_path) {
+    base_cnt = baseline_load(base_path, base_arr, BENCH_BASELINE_MAX);
+    if (!base_cnt) { fprintf(stderr, "Baseline \"%s\" not found or empty.\n", base_path); }
+  }
+
+  FILE* save_file = NULL;
+  if (save_path) {
+    save_file = fopen(save_path, "w");
+    if (!save_file) { fprintf(stderr, "Cannot write to \"%s\".\n", save_path); return 1; }
+    fprintf(save_file, "# scenario inputs outputs vector_size ns_per_route\n");
+  }
+
+  // ==== Measurements
+
+  const t_size* size_arr = is_quick ? sizes_quick : sizes;
+  t_int32 size_cnt = is_quick ? ARR_CNT(sizes_quick) : ARR_CNT(sizes);
+  const t_int32* vec_arr = is_quick ? vec_sizes_quick : vec_sizes;
+  t_int32 vec_cnt = is_quick ? ARR_CNT(vec_sizes_quick) : ARR_CNT(vec_sizes);
+
+  printf("kernels:  %s\n", kernels_select(simd_type)->name);
+  printf("scenario  in   x out   vector   ns/route    worst us   touched KiB%s\n", base_cnt ? "   baseline   change" : "");
+
+  for (t_int32 scen = 0; scen < SCEN_LAST; scen++) {
+
+    if (filter && strcmp(filter, scen_names[scen])) { continue; }
+
+    for (t_int32 sz = 0; sz < size_cnt; sz++) {
+      for (t_int32 vs = 0; vs < vec_cnt; vs++) {
+
+        t_result result;
+        if (bench_run((t_scenario)scen, size_arr[sz], vec_arr[vs], &result) != ERR_NONE) {
+          printf("  allocation failed\n");
+          continue;
+        }
+
+        t_result* base = baseline_find(base_arr, base_cnt, &result);
+        if (base) { printf("   %8.4f   %+5.1f%%", base->ns_route, 100 * (result.ns_route / base->ns_route - 1)); }
+        printf("\n");
+        fflush(stdout);
+
+        if (save_file) {
+          fprintf(save_file, "%s %i %i %i %.4f\n",
+            result.scen, result.channel_cnt, result.out_cnt, result.vec_size, result.ns_route);
+        }
+      }
+    }
+  }
+
+  if (save_file) { fclose(save_file); }
+
+  return 0;
+}
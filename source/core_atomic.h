@@ -0,0 +1,54 @@
+#ifndef YC_CORE_ATOMIC_H_
+#define YC_CORE_ATOMIC_H_
+
+// ========  HEADER FILE FOR THE ATOMIC OPERATIONS  ========
+// Shared by the audio thread, the control threads and the helper threads.
+// All the operations are sequentially consistent, which the sleep protocol of the worker pool needs.
+// They never block, so they can be used on the audio thread.
+// core_atomic_fence orders the plain reads and writes around it, for the data guarded by a counter.
+
+// ========  INCLUDES  ========
+
+#include "core_types.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ========  FUNCTIONS  ========
+
+#if defined(_MSC_VER)
+
+static inline int32_t core_atomic_load   (volatile int32_t* ptr) { return _InterlockedCompareExchange((volatile long*)ptr, 0, 0); }
+static inline void    core_atomic_store  (volatile int32_t* ptr, int32_t val) { _InterlockedExchange((volatile long*)ptr, val); }
+static inline int32_t core_atomic_add    (volatile int32_t* ptr, int32_t val) { return _InterlockedExchangeAdd((volatile long*)ptr, val) + val; }
+static inline t_bool  core_atomic_cas    (volatile int32_t* ptr, int32_t expected, int32_t desired) {
+  return (_InterlockedCompareExchange((volatile long*)ptr, desired, expected) == expected);
+}
+static inline int64_t core_atomic_load64 (volatile int64_t* ptr) { return _InterlockedCompareExchange64(ptr, 0, 0); }
+static inline void    core_atomic_store64(volatile int64_t* ptr, int64_t val) { _InterlockedExchange64(ptr, val); }
+static inline t_bool  core_atomic_cas64  (volatile int64_t* ptr, int64_t expected, int64_t desired) {
+  return (_InterlockedCompareExchange64(ptr, desired, expected) == expected);
+}
+static inline void    core_atomic_fence  (void) { volatile long dummy = 0; _InterlockedExchange(&dummy, 0); }
+
+#else
+
+static inline int32_t core_atomic_load   (volatile int32_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+static inline void    core_atomic_store  (volatile int32_t* ptr, int32_t val) { __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST); }
+static inline int32_t core_atomic_add    (volatile int32_t* ptr, int32_t val) { return __atomic_add_fetch(ptr, val, __ATOMIC_SEQ_CST); }
+static inline t_bool  core_atomic_cas    (volatile int32_t* ptr, int32_t expected, int32_t desired) {
+  return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline int64_t core_atomic_load64 (volatile int64_t* ptr) { return __atomic_load_n(ptr, __ATOMIC_SEQ_CST); }
+static inline void    core_atomic_store64(volatile int64_t* ptr, int64_t val) { __atomic_store_n(ptr, val, __ATOMIC_SEQ_CST); }
+static inline t_bool  core_atomic_cas64  (volatile int64_t* ptr, int64_t expected, int64_t desired) {
+  return __atomic_compare_exchange_n(ptr, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+static inline void    core_atomic_fence  (void) { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+
+#endif
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef YC_CORE_TYPES_H_
+#define YC_CORE_TYPES_H_
+
+// ========  HEADER FILE FOR THE TYPES SHARED BY THE MAX OBJECT AND THE CORE  ========
+// Define DIFFUSE_HEADLESS to build the mixing core without the Max SDK.
+
+#ifndef DIFFUSE_HEADLESS
+
+#include "ext.h"      // Header file for all objects, should always be first
+#include "z_dsp.h"    // Header file for MSP objects, included here for t_double type
+
+#define CORE_NEWPTR(size)  sysmem_newptr(size)
+#define CORE_FREEPTR(ptr)  sysmem_freeptr(ptr)
+
+#else
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+typedef double  t_double;
+typedef int32_t t_int32;
+typedef bool    t_bool;
+
+typedef struct _symbol t_symbol;    // Opaque: the core only stores symbols for the Max object
+
+#ifndef PI
+#define PI    3.14159265358979323846
+#endif
+
+#ifndef TWOPI
+#define TWOPI 6.28318530717958647692
+#endif
+
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define CORE_NEWPTR(size)  malloc(size)
+#define CORE_FREEPTR(ptr)  free(ptr)
+
+#endif
+
+// ====  ALIGNED ALLOCATION  ====
+// Allocate CORE_ALIGN - 1 extra bytes, keep the block to free it, and use the aligned pointer.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CORE_ALIGN  64    // One cache line, and the width of an AVX-512 register
+#define CORE_ALIGN_PTR(ptr)  ((void*)(((uintptr_t)(ptr) + CORE_ALIGN - 1) & ~(uintptr_t)(CORE_ALIGN - 1)))
+#define CORE_ALIGN_CNT(cnt)  ((((cnt) + 7) / 8) * 8)    // Round a count of doubles up to a multiple of CORE_ALIGN bytes
+
+// ====  ARENA  ====
+// Carve several arrays out of a single allocation, each one aligned on CORE_ALIGN.
+// A first pass with a NULL base only adds up the size and returns NULL pointers,
+// a second pass with the aligned base of the allocated block returns the arrays.
+
+typedef struct _arena {
+
+  char*  base;    // Aligned base of the block, NULL to only measure
+  size_t size;    // Number of bytes carved so far
+
+} t_arena;
+
+static inline void* arena_carve(t_arena* arena, size_t size) {
+
+  size_t offset = arena->size;
+  arena->size += (size + CORE_ALIGN - 1) & ~(size_t)(CORE_ALIGN - 1);
+  return arena->base ? (void*)(arena->base + offset) : NULL;
+}
+
+// ====  ENUM  ====
+
+typedef enum _my_err {
+
+  ERR_NULL,    // For initialization, should never be returned
+  ERR_NONE,
+  ERR_ARG_TYPE,
+  ERR_ARG_VALUE,
+  ERR_ALLOC,
+  ERR_ALREADY_ALLOC,
+  ERR_NULL_PTR,
+  ERR_NOT_YET_ALLOC,
+  ERR_DICT_NONE,
+  ERR_DICT_PROTECT,
+  ERR_SYNTAX,
+  ERR_INDEX,
+  ERR_COUNT,
+  ERR_STR_LEN,
+  ERR_ARR_FULL,
+  ERR_ARG0,
+  ERR_ARG1,
+  ERR_ARG2,
+  ERR_ARG3,
+  ERR_ARG4,
+  ERR_LOCKED,
+  ERR_MISC
+
+} t_my_err;
+
+// ========  END OF HEADER FILE  ========
+
+#endif
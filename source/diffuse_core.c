@@ -0,0 +1,2428 @@
+//******************************************************************************
+//  @file
+//  diffuse_core - The mixing core of diffuse~, independent of the Max SDK
+//  Yves Candau - ycandau@gmail.com
+//
+//  @ingroup myExternals
+//
+
+// ========  HEADER FILES  ========
+
+#include "diffuse_core.h"
+
+// ========  CORE METHODS  ========
+
+// ====  CORE_INIT  ====
+
+//******************************************************************************
+//  Initialize the core. Call before core_alloc to set all array pointers to NULL.
+//
+void core_init(t_core* core, t_int32 channel_cnt, t_int32 out_cnt, t_double samplerate) {
+
+  core->channel_cnt = channel_cnt;
+  core->out_cnt     = out_cnt;
+  core->gain_stride = CORE_ALIGN_CNT(out_cnt);
+
+  // Curves: all the sets start the same, the audio thread reads the first one
+  _curves_init(core->curves_arr);
+  _curves_init(core->curves_arr + 1);
+  _curves_init(core->curves_edit);
+  core->curves = core->curves_arr;
+  core->curves_cur = core->curves_arr;
+  core->curves_is_dirty = false;
+  core->curves_post = 0;
+  core->curves_read = 0;
+
+  // Amplitude variables
+  core->master = 1.0;
+  core->master_targ = 1.0;
+  core->master_cntd = 0;
+
+  // Gain smoothing
+  core->control_rate = 0;
+  core->ramp_is_exact = false;
+  core->smooth_time = SMOOTH_TIME_DEF;
+  core->is_smoothing = false;
+  core->gain_is_moving = false;
+
+  // Samplerates
+  core->samplerate = samplerate;
+  core->msr        = core->samplerate / 1000;
+  core->smooth_smp = (t_int32)(core->smooth_time * core->msr);
+
+  // Sample loop kernels: the best instruction set supported
+  core->kernels = kernels_select(SIMD_AUTO);
+
+  // Ramp completions: not queued by default
+  core->end_is_on = false;
+  core->smp_time = 0;
+  core->end_write = 0;
+  core->end_read = 0;
+  core->end_lost = 0;
+
+  // Blocked engine: the outputs are processed in blocks of KERNELS_MIX_OUT
+  core->out_pad = ((out_cnt + KERNELS_MIX_OUT - 1) / KERNELS_MIX_OUT) * KERNELS_MIX_OUT;
+  core->mix_vec_max = 0;
+  core->mix_smp_tile = 0;
+  core->mix_in_tile = 0;
+  core->mix_density_min = MIX_DENSITY_MIN;
+  core->mix_in_cnt = 0;
+
+  // Threads: only the audio thread by default
+  core->thread_req = 1;
+  core->thread_cnt = 1;
+  core->thread_routes_min = THREAD_ROUTES_MIN;
+  core->perform_in_arr = NULL;
+  core->perform_frames = 0;
+
+  // Silence detection: on, only for digital silence
+  core->silence_is_on = true;
+  core->silence_thresh = SILENCE_THRESH_DEF;
+  core->silence_hold = SILENCE_HOLD_DEF;
+  core->silence_hold_smp = (t_int32)(core->silence_hold * core->msr);
+
+  // Set the array pointers to NULL
+  core->channel_arr = NULL;
+  core->block = NULL;
+  core->U_cur_mat = NULL;
+  core->A_cur_mat = NULL;
+  core->U_targ_mat = NULL;
+  core->A_targ_mat = NULL;
+  core->gain_eff_mat = NULL;
+  core->route_mat = NULL;
+  core->out_gain = NULL;
+  core->out_is_dirty = NULL;
+  core->gain_is_dirty = false;
+  core->out_gain_targ = NULL;
+  core->out_gain_prev = NULL;
+  core->out_gain_cntd = NULL;
+  core->out_is_moving = NULL;
+  core->out_is_written = NULL;
+  core->out_idle_cnt = 0;
+  core->mix_gain_arr = NULL;
+  core->mix_in_arr = NULL;
+  core->mix_out_arr = NULL;
+  core->mix_scratch = NULL;
+  core->curve_u_arr = NULL;
+  core->curve_a_arr = NULL;
+  core->curve_r_arr = NULL;
+  core->workers = NULL;
+  core->thread_arr = NULL;
+  core->thread_block = NULL;
+  core->cmd_arr = NULL;
+  core->cmd_row_arr = NULL;
+  core->end_arr = NULL;
+  core->cmd_ring_size = CMD_RING_SIZE;
+  while (core->cmd_ring_size < 2 * channel_cnt) { core->cmd_ring_size *= 2; }
+  core->cmd_row_cnt = CMD_ROW_CNT;
+  while (core->cmd_row_cnt < 2 * channel_cnt) { core->cmd_row_cnt *= 2; }
+  core->cmd_pend = 0;
+  core->row_pend = 0;
+  core->cmd_is_batch = false;
+  core->cmd_write = 0;
+  core->cmd_read = 0;
+  core->row_write = 0;
+  core->row_read = 0;
+}
+
+// ====  _CORE_LAYOUT  ====
+
+//******************************************************************************
+//  Carve the arrays of the core out of an arena.
+//  With a NULL base it only adds up the size of the block, and sets all the pointers to NULL.
+//
+void _core_layout(t_core* core, t_arena* arena) {
+
+  // The input channels and the gain matrices
+  t_int32 mat_size = core->channel_cnt * core->gain_stride;
+
+  core->channel_arr  = (t_channel*)arena_carve(arena, sizeof(t_channel) * core->channel_cnt);
+  core->U_cur_mat    = (t_double*)arena_carve(arena, sizeof(t_double) * mat_size);
+  core->A_cur_mat    = (t_double*)arena_carve(arena, sizeof(t_double) * mat_size);
+  core->U_targ_mat   = (t_double*)arena_carve(arena, sizeof(t_double) * mat_size);
+  core->A_targ_mat   = (t_double*)arena_carve(arena, sizeof(t_double) * mat_size);
+  core->gain_eff_mat = (t_double*)arena_carve(arena, sizeof(t_double) * mat_size);
+  core->route_mat    = (t_int32*)arena_carve(arena, sizeof(t_int32) * mat_size);
+
+  // The vectors of the output gains
+  core->out_gain       = (t_double*)arena_carve(arena, sizeof(t_double) * core->out_cnt);
+  core->out_gain_targ  = (t_double*)arena_carve(arena, sizeof(t_double) * core->out_cnt);
+  core->out_gain_prev  = (t_double*)arena_carve(arena, sizeof(t_double) * core->out_cnt);
+  core->out_gain_cntd  = (t_int32*)arena_carve(arena, sizeof(t_int32) * core->out_cnt);
+  core->out_is_dirty   = (t_bool*)arena_carve(arena, sizeof(t_bool) * core->out_cnt);
+  core->out_is_moving  = (t_bool*)arena_carve(arena, sizeof(t_bool) * core->out_cnt);
+  core->out_is_written = (t_bool*)arena_carve(arena, sizeof(t_bool) * core->out_cnt);
+
+  // The arrays of the blocked engine
+  core->mix_gain_arr = (const t_double**)arena_carve(arena, sizeof(t_double*) * core->channel_cnt);
+  core->mix_in_arr   = (t_double**)arena_carve(arena, sizeof(t_double*) * core->channel_cnt);
+  core->mix_out_arr  = (t_double**)arena_carve(arena, sizeof(t_double*) * core->out_pad);
+
+  // The curve tables and the breakpoint curve tables of the sets of curves,
+  // the set changed by the control thread only has the breakpoint curve tables
+  for (t_int32 set = 0; set < 3; set++) {
+    t_curves* curves = (set < 2) ? core->curves_arr + set : core->curves_edit;
+    size_t lut_size = (set < 2) ? sizeof(t_double) * (CURVE_LUT_SIZE_MAX + 1) : 0;
+    curves->ramp_lut.y_arr      = lut_size ? (t_double*)arena_carve(arena, lut_size) : NULL;
+    curves->ramp_inv_lut.y_arr  = lut_size ? (t_double*)arena_carve(arena, lut_size) : NULL;
+    curves->xfade_lut.y_arr     = lut_size ? (t_double*)arena_carve(arena, lut_size) : NULL;
+    curves->xfade_inv_lut.y_arr = lut_size ? (t_double*)arena_carve(arena, lut_size) : NULL;
+    curves->ramp_tab.y_arr      = (t_double*)arena_carve(arena, sizeof(t_double) * (CURVE_BREAK_SIZE + 1));
+    curves->ramp_inv_tab.y_arr  = (t_double*)arena_carve(arena, sizeof(t_double) * (CURVE_BREAK_SIZE + 1));
+    curves->xfade_tab.y_arr     = (t_double*)arena_carve(arena, sizeof(t_double) * (CURVE_BREAK_SIZE + 1));
+    curves->xfade_inv_tab.y_arr = (t_double*)arena_carve(arena, sizeof(t_double) * (CURVE_BREAK_SIZE + 1));
+  }
+
+  // The vectors for the batch curve functions
+  core->curve_u_arr = (t_double*)arena_carve(arena, sizeof(t_double) * core->gain_stride);
+  core->curve_a_arr = (t_double*)arena_carve(arena, sizeof(t_double) * core->gain_stride);
+  core->curve_r_arr = (t_double*)arena_carve(arena, sizeof(t_double) * core->gain_stride);
+
+  // The vector of threads, the command queue and the ring of ramp completions
+  core->thread_arr  = (t_core_thread*)arena_carve(arena, sizeof(t_core_thread) * WORKERS_THREAD_MAX);
+  core->cmd_arr     = (t_cmd*)arena_carve(arena, sizeof(t_cmd) * core->cmd_ring_size);
+  core->cmd_row_arr = (t_double*)arena_carve(arena, sizeof(t_double) * core->cmd_row_cnt * 2 * core->gain_stride);
+  core->end_arr     = (t_end_event*)arena_carve(arena, sizeof(t_end_event) * END_RING_SIZE);
+}
+
+// ====  CORE_ALLOC  ====
+
+//******************************************************************************
+//  Allocate the arrays of the core, all in one block aligned on a cache line.
+//  Call only after core_init. On failure call core_free to release what was allocated.
+//  Returns:
+//  ERR_NONE:  Succesful initialization
+//  ERR_ALLOC:  Failed allocation
+//
+t_my_err core_alloc(t_core* core) {
+
+  // Add up the size of the arrays, then allocate the block and test
+  t_arena arena = { NULL, 0 };
+  _core_layout(core, &arena);
+
+  core->block = CORE_NEWPTR(arena.size + CORE_ALIGN - 1);
+  if (!core->block) { return ERR_ALLOC; }
+
+  // Carve the arrays out of the block
+  arena.base = (char*)CORE_ALIGN_PTR(core->block);
+  arena.size = 0;
+  _core_layout(core, &arena);
+
+  // Initialize and allocate each channel
+  for (t_int32 ch = 0; ch < core->channel_cnt; ch++) { _channel_init(core, core->channel_arr + ch); }
+  for (t_int32 ch = 0; ch < core->channel_cnt; ch++) {
+    if (_channel_alloc(core, core->channel_arr + ch, 0, 0) != ERR_NONE) { return ERR_ALLOC; }
+  }
+
+  // Initialize the vectors of gains and flags
+  for (t_int32 ch = 0; ch < core->out_cnt; ch++) {
+    core->out_gain[ch] = 1.0;
+    core->out_gain_targ[ch] = 1.0;
+    core->out_gain_prev[ch] = 1.0;
+    core->out_gain_cntd[ch] = 0;
+    core->out_is_dirty[ch] = false;
+    core->out_is_moving[ch] = false;
+  }
+
+  // The audio thread uses the arrays of the core
+  core->thread_arr[0].out_arr = NULL;
+  core->thread_arr[0].out_is_written = core->out_is_written;
+  core->thread_arr[0].curve_u_arr = core->curve_u_arr;
+  core->thread_arr[0].curve_a_arr = core->curve_a_arr;
+  core->thread_arr[0].curve_r_arr = core->curve_r_arr;
+
+  return ERR_NONE;
+}
+
+// ====  CORE_FREE  ====
+
+//******************************************************************************
+//  Free the arrays of the core.
+//
+void core_free(t_core* core) {
+
+  // Stop the helper threads first
+  _core_threads_free(core);
+
+  if (core->mix_scratch) { CORE_FREEPTR(core->mix_scratch); core->mix_scratch = NULL; }
+  core->mix_vec_max = 0;
+
+  // All the other arrays live in the block: free it and set their pointers to NULL
+  if (core->block) {
+    for (t_int32 ch = 0; ch < core->channel_cnt; ch++) { _channel_free(core, core->channel_arr + ch); }
+    CORE_FREEPTR(core->block);
+    core->block = NULL;
+  }
+
+  t_arena arena = { NULL, 0 };
+  _core_layout(core, &arena);
+
+  for (t_int32 set = 0; set < 3; set++) {
+    t_curves* curves = (set < 2) ? core->curves_arr + set : core->curves_edit;
+    curves->ramp_lut.size = 0;
+    curves->ramp_inv_lut.size = 0;
+    curves->xfade_lut.size = 0;
+    curves->xfade_inv_lut.size = 0;
+    curves->ramp_tab.size = 0;
+    curves->ramp_inv_tab.size = 0;
+    curves->xfade_tab.size = 0;
+    curves->xfade_inv_tab.size = 0;
+  }
+}
+
+// ====  CORE_DSP  ====
+
+//******************************************************************************
+//  Recalculate everything that depends on the samplerate and vector size.
+//  Returns:
+//  ERR_NONE:  Succesful update
+//  ERR_ALLOC:  Failed allocation, the blocked engine is disabled but the core remains usable
+//  or the helper threads could not be started and the perform routine runs on the audio thread only
+//
+t_my_err core_dsp(t_core* core, t_double samplerate, t_int32 maxvectorsize) {
+
+  core->samplerate = samplerate;
+  core->msr        = core->samplerate / 1000;
+
+  core->silence_hold_smp = (t_int32)(core->silence_hold * core->msr);
+  core->smooth_smp = (t_int32)(core->smooth_time * core->msr);
+
+  // The completion times count the samples from the start of the audio, at the new samplerate
+  core->smp_time = 0;
+
+  // Reallocate the scratch output of the blocked engine for the new vector size
+  if (core->mix_scratch) { CORE_FREEPTR(core->mix_scratch); core->mix_scratch = NULL; }
+  core->mix_vec_max = 0;
+  _core_threads_free(core);
+
+  if (maxvectorsize <= 0) { return ERR_NONE; }
+
+  core->mix_scratch = (t_double*)CORE_NEWPTR(sizeof(t_double) * maxvectorsize);
+  if (!core->mix_scratch) { return ERR_ALLOC; }
+
+  core->mix_vec_max = maxvectorsize;
+  _core_mix_tiles(core, maxvectorsize);
+
+  // Restart the helper threads, with outputs for the new vector size
+  if ((core->thread_req <= 1) || (!core->thread_arr)) { return ERR_NONE; }
+
+  // Per helper, in doubles: the curve scratch, the output signals with aligned rows,
+  // then the vector of output pointers and the vector of written flags
+  t_int32 helper_cnt = core->thread_req - 1;
+  t_int32 vec_stride = CORE_ALIGN_CNT(maxvectorsize);
+  t_int32 flag_cnt = CORE_ALIGN_CNT((t_int32)((sizeof(t_bool) * core->out_cnt + sizeof(t_double) - 1) / sizeof(t_double)));
+  t_int32 thread_size = 3 * core->gain_stride + core->out_cnt * vec_stride + CORE_ALIGN_CNT(core->out_cnt) + flag_cnt;
+
+  core->thread_block = CORE_NEWPTR(sizeof(t_double) * thread_size * helper_cnt + CORE_ALIGN - 1);
+  if (!core->thread_block) { return ERR_ALLOC; }
+
+  t_double* block = (t_double*)CORE_ALIGN_PTR(core->thread_block);
+  for (t_int32 th = 1; th <= helper_cnt; th++, block += thread_size) {
+
+    t_core_thread* thread = core->thread_arr + th;
+    thread->curve_u_arr = block;
+    thread->curve_a_arr = thread->curve_u_arr + core->gain_stride;
+    thread->curve_r_arr = thread->curve_a_arr + core->gain_stride;
+
+    t_double* smp_arr = thread->curve_r_arr + core->gain_stride;
+    thread->out_arr = (t_double**)(smp_arr + core->out_cnt * vec_stride);
+    thread->out_is_written = (t_bool*)(smp_arr + core->out_cnt * vec_stride + CORE_ALIGN_CNT(core->out_cnt));
+
+    for (t_int32 out = 0; out < core->out_cnt; out++) {
+      thread->out_arr[out] = smp_arr + out * vec_stride;
+      thread->out_is_written[out] = false;
+    }
+  }
+
+  // On failure everything runs on the audio thread
+  core->workers = workers_new(core->thread_req);
+  if (!core->workers) { _core_threads_free(core); return ERR_ALLOC; }
+  core->thread_cnt = core->thread_req;
+
+  return ERR_NONE;
+}
+
+// ====  CORE_SET_THREADS  ====
+
+//******************************************************************************
+//  Set the number of threads of the perform routine, including the audio thread.
+//  The helper threads are started by the next call to core_dsp.
+//  Only matrices with at least thread_routes_min routes are split across threads.
+//
+void core_set_threads(t_core* core, t_int32 thread_cnt) {
+
+  core->thread_req = MAX(1, MIN(thread_cnt, WORKERS_THREAD_MAX));
+}
+
+// ====  _CORE_THREADS_FREE  ====
+
+//******************************************************************************
+//  Stop the helper threads and free their outputs.
+//
+void _core_threads_free(t_core* core) {
+
+  if (core->workers) { workers_free(core->workers); core->workers = NULL; }
+  core->thread_cnt = 1;
+  if (core->thread_block) { CORE_FREEPTR(core->thread_block); core->thread_block = NULL; }
+}
+
+// ========  COMMAND QUEUE  ========
+// The control thread does not write to the channels or gains that the perform routine reads:
+// it posts commands, and core_perform applies them all at the start of the next vector.
+// There is one producer and one consumer, so the queue needs no lock: each side only writes
+// its own counter, and reads the counter of the other side to know how far it can go.
+// An owner posting from several control threads takes a lock around posting, which the audio
+// thread never takes. When the audio is not running the owner calls core_cmd_drain itself,
+// from the control thread.
+// The commands posted between core_post_begin and core_post_end are published together,
+// so they are all applied at the start of the same vector.
+
+// ====  _CORE_CMD_RESERVE and _CORE_CMD_COMMIT  ====
+
+//******************************************************************************
+//  Reserve the next command of the queue, with a pair of rows if is_row is set.
+//  Fill it, then publish it with _core_cmd_commit, or at the end of the batch.
+//  Returns the command, or NULL if the queue is full.
+//
+t_cmd* _core_cmd_reserve(t_core* core, t_cmd_type type, t_int32 index, t_bool is_row) {
+
+  if (!core->cmd_arr) { return NULL; }
+
+  uint32_t write = (uint32_t)core->cmd_pend;
+  if (write - (uint32_t)core_atomic_load(&core->cmd_read) >= (uint32_t)core->cmd_ring_size) { return NULL; }
+
+  t_cmd* cmd = core->cmd_arr + (write & (core->cmd_ring_size - 1));
+  cmd->type = type;
+  cmd->index = index;
+  cmd->val_i = 0;
+  cmd->val_j = 0;
+  cmd->val_k = 0;
+  cmd->val_d = 0;
+  cmd->val_e = 0;
+  cmd->row_u = NULL;
+  cmd->row_a = NULL;
+
+  if (is_row) {
+    uint32_t row = (uint32_t)core->row_pend;
+    if (row - (uint32_t)core_atomic_load(&core->row_read) >= (uint32_t)core->cmd_row_cnt) { return NULL; }
+    cmd->row_u = core->cmd_row_arr + (row & (core->cmd_row_cnt - 1)) * 2 * core->gain_stride;
+    cmd->row_a = cmd->row_u + core->gain_stride;
+  }
+
+  return cmd;
+}
+
+void _core_cmd_commit(t_core* core, t_cmd* cmd) {
+
+  if (cmd->row_u) { core->row_pend = (int32_t)((uint32_t)core->row_pend + 1); }
+  core->cmd_pend = (int32_t)((uint32_t)core->cmd_pend + 1);
+
+  if (!core->cmd_is_batch) { core_post_end(core); }
+}
+
+// ====  CORE_POST_BEGIN, CORE_POST_END and CORE_POST_CANCEL  ====
+
+//******************************************************************************
+//  Start a batch: the commands posted until core_post_end are published together.
+//  If one of them does not fit, core_post_cancel drops the ones already posted.
+//
+void core_post_begin(t_core* core) {
+
+  core->cmd_is_batch = true;
+}
+
+void core_post_end(t_core* core) {
+
+  core->cmd_is_batch = false;
+
+  // The rows first: a command is only read once published, and its rows with it
+  core_atomic_store(&core->row_write, core->row_pend);
+  core_atomic_store(&core->cmd_write, core->cmd_pend);
+}
+
+void core_post_cancel(t_core* core) {
+
+  core->cmd_is_batch = false;
+  core->row_pend = core->row_write;
+  core->cmd_pend = core->cmd_write;
+}
+
+// ====  CORE_CMD_DRAIN  ====
+
+//******************************************************************************
+//  Apply all the commands posted, in order.
+//  Called by core_perform on the audio thread, or by the owner when the audio is not running.
+//
+void core_cmd_drain(t_core* core) {
+
+  if (!core->cmd_arr) { return; }
+
+  uint32_t read = (uint32_t)core->cmd_read;
+  uint32_t write = (uint32_t)core_atomic_load(&core->cmd_write);
+
+  for ( ; read != write; read++) {
+
+    t_cmd* cmd = core->cmd_arr + (read & (core->cmd_ring_size - 1));
+    _core_cmd_apply(core, cmd);
+
+    // Release the slots only once the command is applied
+    if (cmd->row_u) { core_atomic_store(&core->row_read, (int32_t)((uint32_t)core->row_read + 1)); }
+    core_atomic_store(&core->cmd_read, (int32_t)(read + 1));
+  }
+}
+
+// ====  CORE_CMD_IS_EMPTY  ====
+
+//******************************************************************************
+//  Returns true if all the commands posted have been applied. Called by the producer.
+//
+t_bool core_cmd_is_empty(t_core* core) {
+
+  return (core_atomic_load(&core->cmd_read) == core->cmd_write);
+}
+
+// ====  _CORE_CMD_APPLY  ====
+
+//******************************************************************************
+//  Apply one command to the core.
+//
+void _core_cmd_apply(t_core* core, t_cmd* cmd) {
+
+  t_channel* channel = (cmd->index >= 0) ? core->channel_arr + cmd->index : NULL;
+  t_int32 in_beg = (cmd->index >= 0) ? cmd->index : 0;
+  t_int32 in_end = (cmd->index >= 0) ? cmd->index + 1 : core->channel_cnt;
+
+  switch (cmd->type) {
+
+  case CMD_CHANNEL_SET:
+    for (t_int32 out = 0; out < channel->out_cnt; out++) { channel->A_cur[out] = cmd->row_a[out]; }
+    _channel_calc_routes(core, channel);
+    channel->is_gain_dirty = true;
+    break;
+
+  case CMD_RAMP:
+    _channel_set_interp(core, channel, (t_interp_type)cmd->val_i);
+    channel->cntd = cmd->val_j;
+    channel->mode_type = MODE_TYPE_VAR;
+    channel->state_ind = cmd->val_k;
+    for (t_int32 out = 0; out < channel->out_cnt; out++) {
+      channel->U_targ[out] = cmd->row_u[out];
+      channel->A_targ[out] = cmd->row_a[out];
+    }
+    _channel_calc_routes(core, channel);
+    break;
+
+  case CMD_ON:
+    for (t_int32 in = in_beg; in < in_end; in++) { core->channel_arr[in].is_on = (cmd->val_i != 0); }
+    break;
+
+  case CMD_FREEZE:
+    for (t_int32 in = in_beg; in < in_end; in++) { core->channel_arr[in].is_frozen = (cmd->val_i != 0); }
+    break;
+
+  case CMD_VELOCITY:
+    for (t_int32 in = in_beg; in < in_end; in++) { core->channel_arr[in].velocity = cmd->val_d; }
+    break;
+
+  case CMD_MUTE_RAMP:    channel->is_mute_ramp = (cmd->val_i != 0); break;
+  case CMD_GAIN_IN:      core_set_gain_in(core, channel, cmd->val_d); break;
+  case CMD_GAIN_OUT:     core_set_gain_out(core, cmd->index, cmd->val_d); break;
+  case CMD_MASTER:       core_set_master(core, cmd->val_d); break;
+  case CMD_SMOOTH:       core_set_smooth(core, cmd->val_d); break;
+  case CMD_CONTROL_RATE: core->control_rate = cmd->val_i; break;
+  case CMD_EXACT:        core->ramp_is_exact = (cmd->val_i != 0); break;
+  case CMD_SILENCE:      core_set_silence(core, (cmd->val_i != 0), cmd->val_d, cmd->val_e); break;
+  case CMD_CURVES:       _core_curves_apply(core, core->curves_arr + cmd->val_i); break;
+
+  default: break;
+  }
+}
+
+// ====  CORE_POST  ====
+
+//******************************************************************************
+//  Post a command without rows.
+//  t_cmd_type type:  The command
+//  t_int32 index:  The index of the channel or output, or -1 for all the channels
+//  t_int32 val_i, t_double val_d, t_double val_e:  The values of the command, see t_cmd_type
+//  Returns:
+//  ERR_NONE:  The command is applied at the start of the next vector
+//  ERR_ARR_FULL:  The queue is full, the command is dropped
+//
+t_my_err core_post(t_core* core, t_cmd_type type, t_int32 index, t_int32 val_i, t_double val_d, t_double val_e) {
+
+  t_cmd* cmd = _core_cmd_reserve(core, type, index, false);
+  if (!cmd) { return ERR_ARR_FULL; }
+
+  cmd->val_i = val_i;
+  cmd->val_d = val_d;
+  cmd->val_e = val_e;
+  _core_cmd_commit(core, cmd);
+
+  return ERR_NONE;
+}
+
+// ====  CORE_POST_GAINS  ====
+
+//******************************************************************************
+//  Post the gains of a channel: out_cnt values from a_arr.
+//  Returns ERR_NONE, or ERR_ARR_FULL if the queue is full.
+//
+t_my_err core_post_gains(t_core* core, t_int32 index, const t_double* a_arr) {
+
+  t_cmd* cmd = _core_cmd_reserve(core, CMD_CHANNEL_SET, index, true);
+  if (!cmd) { return ERR_ARR_FULL; }
+
+  for (t_int32 out = 0; out < core->out_cnt; out++) { cmd->row_a[out] = a_arr[out]; }
+  _core_cmd_commit(core, cmd);
+
+  return ERR_NONE;
+}
+
+// ====  CORE_POST_RAMP  ====
+
+//******************************************************************************
+//  Post a ramp of a channel to a state, the command version of _state_ramp.
+//  The state is copied, so it can be changed as soon as the function returns.
+//  t_interp_type type:  Ramping or crossfade function, state->U_cur has to match it
+//  t_int32 cntd:  The countdown in samples
+//  t_int32 offset:  Rotation of the state values over the outputs
+//  Returns ERR_NONE, or ERR_ARR_FULL if the queue is full.
+//
+t_my_err core_post_ramp(t_core* core, t_int32 index, t_interp_type type, const t_state* state, t_int32 cntd, t_int32 offset) {
+
+  t_cmd* cmd = _core_cmd_reserve(core, CMD_RAMP, index, true);
+  if (!cmd) { return ERR_ARR_FULL; }
+
+  cmd->val_i = (t_int32)type;
+  cmd->val_j = cntd;
+  cmd->val_k = state->index;
+
+  for (t_int32 ch1 = 0; ch1 < state->cnt; ch1++) {
+    t_int32 ch2 = (ch1 + offset) % core->out_cnt;
+    cmd->row_u[ch2] = state->U_cur[ch1];
+    cmd->row_a[ch2] = state->A_arr[ch1];
+  }
+
+  _core_cmd_commit(core, cmd);
+
+  return ERR_NONE;
+}
+
+// ========  RAMP COMPLETIONS  ========
+// The audio thread does not send the end_ramp messages: it queues the completions with the sample
+// at which they happened, and the owner reads them from its own thread, for instance from a clock.
+// There is one producer and one consumer, so the ring needs no lock, as for the command queue.
+// When the ring is full the completions are dropped and counted.
+
+// ====  _CORE_END_PUSH  ====
+
+//******************************************************************************
+//  Queue the ramps that ended in the current vector, in the order of their sample times,
+//  and in the order of the channels for the same sample time.
+//  Called by core_perform on the audio thread, after the channel loop.
+//
+void _core_end_push(t_core* core) {
+
+  uint32_t write = (uint32_t)core->end_write;
+  uint32_t beg = write;
+  uint32_t read = (uint32_t)core_atomic_load(&core->end_read);
+
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+    t_channel* channel = core->channel_arr + in;
+    if (!channel->is_end_pending) { continue; }
+    channel->is_end_pending = false;
+
+    if (write - read >= END_RING_SIZE) { core_atomic_add(&core->end_lost, 1); continue; }
+
+    // Insertion sort on the sample time: there are few completions in a vector
+    t_end_event event = { core->smp_time + channel->end_smp, in, channel->state_ind };
+    uint32_t pos = write;
+    while ((pos != beg) && (core->end_arr[(pos - 1) & (END_RING_SIZE - 1)].time > event.time)) {
+      core->end_arr[pos & (END_RING_SIZE - 1)] = core->end_arr[(pos - 1) & (END_RING_SIZE - 1)];
+      pos--;
+    }
+    core->end_arr[pos & (END_RING_SIZE - 1)] = event;
+    write++;
+  }
+
+  if (write != beg) { core_atomic_store(&core->end_write, (int32_t)write); }
+}
+
+// ====  CORE_END_FRONT and CORE_END_POP  ====
+
+//******************************************************************************
+//  Read the ramp completions from the thread of the owner:
+//  core_end_front returns the oldest one, or NULL if there is none, and core_end_pop releases it.
+//
+t_end_event* core_end_front(t_core* core) {
+
+  if (!core->end_arr) { return NULL; }
+
+  uint32_t read = (uint32_t)core->end_read;
+  if ((uint32_t)core_atomic_load(&core->end_write) == read) { return NULL; }
+
+  return core->end_arr + (read & (END_RING_SIZE - 1));
+}
+
+void core_end_pop(t_core* core) {
+
+  core_atomic_store(&core->end_read, (int32_t)((uint32_t)core->end_read + 1));
+}
+
+// ====  CORE_END_LOST  ====
+
+//******************************************************************************
+//  Returns the number of ramp completions dropped since the last call, and resets it.
+//
+t_int32 core_end_lost(t_core* core) {
+
+  t_int32 lost = core_atomic_load(&core->end_lost);
+  if (lost) { core_atomic_add(&core->end_lost, -lost); }
+  return lost;
+}
+
+// ====  _CORE_MIX_TILES  ====
+
+//******************************************************************************
+//  Choose the tile sizes of the blocked engine.
+//  The samples of all the outputs for one sample tile should stay in L2,
+//  and the samples of the inputs for one input tile should stay in L1.
+//  The sample tile is kept to a multiple of 16 so that the kernels have no remainder.
+//
+void _core_mix_tiles(t_core* core, t_int32 maxvectorsize) {
+
+  t_int32 smp_tile = MIX_L2_BUDGET / (t_int32)(sizeof(t_double) * core->out_pad);
+  smp_tile = (smp_tile / 16) * 16;
+  smp_tile = MAX(smp_tile, 16);
+  smp_tile = MIN(smp_tile, maxvectorsize);
+
+  t_int32 in_tile = MIX_L1_BUDGET / (t_int32)(sizeof(t_double) * smp_tile);
+  in_tile = MAX(in_tile, 1);
+  in_tile = MIN(in_tile, MAX(core->channel_cnt, 1));
+
+  core->mix_smp_tile = smp_tile;
+  core->mix_in_tile = in_tile;
+}
+
+// ====  _CORE_IS_STATIC  ====
+
+//******************************************************************************
+//  Test if the gains of all the active channels are constant over the vector:
+//  frozen, or with an indefinite countdown, and no gain being smoothed.
+//
+t_bool _core_is_static(t_core* core) {
+
+  if (core->gain_is_moving) { return false; }
+
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+    t_channel* channel = core->channel_arr + in;
+    if (channel->is_on && !channel->is_frozen && (channel->cntd != INDEFINITE)) { return false; }
+  }
+
+  return true;
+}
+
+// ====  _CORE_ROUTE_CNT  ====
+
+//******************************************************************************
+//  Count the active routes of the channels that are on and not silent.
+//
+t_int32 _core_route_cnt(t_core* core) {
+
+  t_int32 route_cnt = 0;
+
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+    t_channel* channel = core->channel_arr + in;
+    if (channel->is_on && !channel->is_silent) { route_cnt += channel->route_cnt; }
+  }
+
+  return route_cnt;
+}
+
+// ====  CORE_SET_SILENCE  ====
+
+//******************************************************************************
+//  Set the silence detection.
+//  t_bool is_on:  Skip the silent inputs or not
+//  t_double thresh:  Absolute sample value at or below which a sample is silent
+//  t_double hold:  Time in ms an input has to stay silent before being skipped
+//
+void core_set_silence(t_core* core, t_bool is_on, t_double thresh, t_double hold) {
+
+  core->silence_is_on = is_on;
+  core->silence_thresh = thresh;
+  core->silence_hold = hold;
+  core->silence_hold_smp = (t_int32)(hold * core->msr);
+
+  // Start counting again
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+    core->channel_arr[in].silence_cnt = 0;
+    core->channel_arr[in].is_silent = false;
+  }
+}
+
+// ====  CORE_SET_MASTER  ====
+
+//******************************************************************************
+//  Set the master gain, and flag all the effective gains for recalculation.
+//  With a smoothing time the gain only moves towards the new value.
+//
+void core_set_master(t_core* core, t_double master) {
+
+  core->master_targ = master;
+
+  // Smoothing: the gain moves in _core_smooth_gains
+  if (core->smooth_smp > 0) {
+    core->master_cntd = core->smooth_smp;
+    core->is_smoothing = true;
+    return;
+  }
+
+  core->master = master;
+  core->master_cntd = 0;
+
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+    t_channel* channel = core->channel_arr + in;
+    channel->gain_mast = core->master * channel->gain;
+    channel->is_gain_dirty = true;
+  }
+}
+
+// ====  CORE_SET_GAIN_IN  ====
+
+//******************************************************************************
+//  Set the gain of an input channel, and flag its row of effective gains for recalculation.
+//  With a smoothing time the gain only moves towards the new value.
+//
+void core_set_gain_in(t_core* core, t_channel* channel, t_double gain) {
+
+  channel->gain_targ = gain;
+
+  if (core->smooth_smp > 0) {
+    channel->gain_cntd = core->smooth_smp;
+    core->is_smoothing = true;
+    return;
+  }
+
+  channel->gain = gain;
+  channel->gain_cntd = 0;
+
+  channel->gain_mast = core->master * channel->gain;
+  channel->gain_mast_prev = channel->gain_mast;
+  channel->is_gain_dirty = true;
+  channel->is_gain_moving = false;
+}
+
+// ====  CORE_SET_GAIN_OUT  ====
+
+//******************************************************************************
+//  Set the gain of an output channel, and flag its column of effective gains for recalculation.
+//  With a smoothing time the gain only moves towards the new value.
+//
+void core_set_gain_out(t_core* core, t_int32 out, t_double gain) {
+
+  core->out_gain_targ[out] = gain;
+
+  if (core->smooth_smp > 0) {
+    core->out_gain_cntd[out] = core->smooth_smp;
+    core->is_smoothing = true;
+    return;
+  }
+
+  core->out_gain[out] = gain;
+  core->out_gain_cntd[out] = 0;
+  core->out_is_dirty[out] = true;
+  core->gain_is_dirty = true;
+}
+
+// ====  CORE_SET_SMOOTH  ====
+
+//******************************************************************************
+//  Set the smoothing time of master, gain_in and gain_out, in ms.
+//  Gains that are already moving keep their current countdown.
+//
+void core_set_smooth(t_core* core, t_double time) {
+
+  core->smooth_time = time;
+  core->smooth_smp = (t_int32)(time * core->msr);
+}
+
+// ========  CURVES  ========
+// The control thread never changes the curves that the audio thread reads: the setters change
+// curves_edit, and core_curves_publish copies it to the set of curves_arr not in use, with its tables,
+// and publishes it with CMD_CURVES. The audio thread switches to it at the start of the next vector,
+// in order with the other commands: a ramp posted before the switch runs with the previous curves,
+// a ramp posted after with the new ones.
+// The set not in use is only changed again once the switch has been applied, see core_curves_is_free:
+// until then the changes stay in curves_edit, and the owner calls core_curves_publish again later.
+
+// ====  CORE_CURVES_IS_FREE  ====
+
+//******************************************************************************
+//  Returns true if the curves can be published: the previous change has been applied.
+//  While the audio is running this takes one vector, otherwise the owner drains the queue.
+//
+t_bool core_curves_is_free(t_core* core) {
+
+  return (core_atomic_load(&core->curves_read) == core->curves_post);
+}
+
+// ====  CORE_CURVES_PUBLISH  ====
+
+//******************************************************************************
+//  Publish the changes made to the curves by the setters, with the tables rebuilt.
+//  Returns:
+//  ERR_NONE:  Nothing to publish, or the change is applied at the start of the next vector
+//  ERR_LOCKED:  The previous change is not applied yet
+//  ERR_ARR_FULL:  The queue is full
+//  On ERR_LOCKED and ERR_ARR_FULL the change is kept in curves_edit: call again later.
+//
+t_my_err core_curves_publish(t_core* core) {
+
+  if (!core->curves_is_dirty) { return ERR_NONE; }
+  if (!core_curves_is_free(core)) { return ERR_LOCKED; }
+
+  t_cmd* cmd = _core_cmd_reserve(core, CMD_CURVES, -1, false);
+  if (!cmd) { return ERR_ARR_FULL; }
+
+  t_curves* curves = core->curves_arr + ((core->curves == core->curves_arr) ? 1 : 0);
+  _curves_copy(curves, core->curves_edit);
+  _curves_build(curves);
+
+  cmd->val_i = (t_int32)(curves - core->curves_arr);
+  core->curves = curves;
+  core->curves_is_dirty = false;
+  core->curves_post++;
+  _core_cmd_commit(core, cmd);
+
+  return ERR_NONE;
+}
+
+// ====  _CORE_CURVES_APPLY  ====
+
+//******************************************************************************
+//  Switch the audio thread to a set of curves, applying CMD_CURVES.
+//  The channels drop the tables of the previous set, so that a ramp in progress keeps its curve
+//  and finishes with the exact function. New ramps pick up the new tables.
+//  Breakpoint curves have no function to fall back on: their channels move to the compiled tables
+//  of the new set, which always hold the latest breakpoint curves.
+//
+void _core_curves_apply(t_core* core, t_curves* curves) {
+
+  core->curves_cur = curves;
+
+  for (t_int32 ch = 0; ch < core->channel_cnt; ch++) {
+
+    t_channel* channel = core->channel_arr + ch;
+    if (!channel->interp_lut && !channel->interp_inv_lut) { continue; }
+
+    if ((channel->interp_type == INTERP_TYPE_RAMP) && (channel->ramp_type == RAMP_TABLE)) {
+      channel->interp_lut = &curves->ramp_tab;
+      channel->interp_inv_lut = &curves->ramp_inv_tab;
+    }
+    else if ((channel->interp_type == INTERP_TYPE_XFADE) && (channel->xfade_type == XFADE_TABLE)) {
+      channel->interp_lut = &curves->xfade_tab;
+      channel->interp_inv_lut = &curves->xfade_inv_tab;
+    }
+    else {
+      channel->interp_lut = NULL;
+      channel->interp_inv_lut = NULL;
+    }
+  }
+
+  // Release the previous set only once no channel uses it
+  core_atomic_store(&core->curves_read, core->curves_read + 1);
+}
+
+// ====  CORE_SET_CURVES  ====
+
+//******************************************************************************
+//  Set the error bound of the curve tables, 0 to evaluate the functions exactly.
+//  The tables are rebuilt by core_curves_publish.
+//
+void core_set_curves(t_core* core, t_double lut_err) {
+
+  core->curves_edit->lut_err = lut_err;
+  core->curves_is_dirty = true;
+}
+
+// ====  CORE_SET_RAMP  ====
+
+//******************************************************************************
+//  Set the ramping function and its parameter, published by core_curves_publish.
+//  The parameter is validated once here, so that the unchecked versions of the functions
+//  can be used in the perform routine.
+//  Returns:
+//  ERR_NONE:  The function is changed
+//  ERR_ARG_VALUE:  Invalid type, or invalid parameter for the type: the function is unchanged
+//  RAMP_TABLE is only valid once a curve has been compiled by core_set_ramp_table.
+//
+t_my_err core_set_ramp(t_core* core, t_ramp_type type, t_double param) {
+
+  if (!_curves_set_ramp(core->curves_edit, type, param)) { return ERR_ARG_VALUE; }
+  core->curves_is_dirty = true;
+  return ERR_NONE;
+}
+
+// ====  CORE_SET_XFADE  ====
+
+//******************************************************************************
+//  Set the crossfade function and its parameter, published by core_curves_publish.
+//  Returns:
+//  ERR_NONE:  The function is changed
+//  ERR_ARG_VALUE:  Invalid type: the function is unchanged
+//  XFADE_TABLE is only valid once a curve has been compiled by core_set_xfade_table.
+//
+t_my_err core_set_xfade(t_core* core, t_xfade_type type, t_double param) {
+
+  if (!_curves_set_xfade(core->curves_edit, type, param)) { return ERR_ARG_VALUE; }
+  core->curves_is_dirty = true;
+  return ERR_NONE;
+}
+
+// ====  CORE_SET_RAMP_TABLE  ====
+
+//******************************************************************************
+//  Compile a breakpoint curve and set it as the ramping function, published by core_curves_publish.
+//  t_double* x_arr, y_arr:  cnt breakpoints, see curve_break_build
+//  t_bool is_spline:  Monotone cubic between the breakpoints, or linear
+//  A ramp in progress on the previous breakpoint curve continues on the new one.
+//  Returns:
+//  ERR_NONE:  The function is changed
+//  ERR_ARG_VALUE:  Invalid breakpoints: the function is unchanged
+//
+t_my_err core_set_ramp_table(t_core* core, const t_double* x_arr, const t_double* y_arr, t_int32 cnt, t_bool is_spline) {
+
+  t_curves* curves = core->curves_edit;
+
+  if (!curve_break_build(&curves->ramp_tab, &curves->ramp_inv_tab, x_arr, y_arr, cnt, is_spline)) { return ERR_ARG_VALUE; }
+  _curves_set_ramp(curves, RAMP_TABLE, curves->ramp_param);
+  core->curves_is_dirty = true;
+  return ERR_NONE;
+}
+
+// ====  CORE_SET_XFADE_TABLE  ====
+
+//******************************************************************************
+//  Compile a breakpoint curve and set it as the crossfade function, as core_set_ramp_table.
+//
+t_my_err core_set_xfade_table(t_core* core, const t_double* x_arr, const t_double* y_arr, t_int32 cnt, t_bool is_spline) {
+
+  t_curves* curves = core->curves_edit;
+
+  if (!curve_break_build(&curves->xfade_tab, &curves->xfade_inv_tab, x_arr, y_arr, cnt, is_spline)) { return ERR_ARG_VALUE; }
+  _curves_set_xfade(curves, XFADE_TABLE, curves->xfade_param);
+  core->curves_is_dirty = true;
+  return ERR_NONE;
+}
+
+// ====  _CORE_INTERP_ARR  ====
+
+//******************************************************************************
+//  Convert a vector of abscissa values to ordinate values,
+//  with the latest ramping or crossfade function. Called from the control thread.
+//
+void _core_interp_arr(t_core* core, t_interp_type type, t_double* a_arr, const t_double* u_arr, t_int32 cnt) {
+
+  const t_curves* curves = core->curves;
+  const t_curve_lut* lut = _curves_get_lut(curves, type, false);
+
+  if (lut) { curve_lut_eval_arr(lut, a_arr, u_arr, cnt); }
+  else if (type == INTERP_TYPE_RAMP) { curves->ramp_arr_func(core->kernels, a_arr, u_arr, curves->ramp_param, cnt); }
+  else { curves->xfade_arr_func(core->kernels, a_arr, u_arr, curves->xfade_param, cnt); }
+}
+
+// ====  _CORE_INTERP_INV_ARR  ====
+
+//******************************************************************************
+//  Convert a vector of ordinate values to abscissa values,
+//  with the latest ramping or crossfade function. Called from the control thread.
+//
+void _core_interp_inv_arr(t_core* core, t_interp_type type, t_double* u_arr, const t_double* a_arr, t_int32 cnt) {
+
+  const t_curves* curves = core->curves;
+  const t_curve_lut* lut = _curves_get_lut(curves, type, true);
+
+  if (lut) { curve_lut_eval_arr(lut, u_arr, a_arr, cnt); }
+  else if (type == INTERP_TYPE_RAMP) { curves->ramp_inv_arr_func(core->kernels, u_arr, a_arr, curves->ramp_param, cnt); }
+  else { curves->xfade_inv_arr_func(core->kernels, u_arr, a_arr, curves->xfade_param, cnt); }
+}
+
+// ====  _CORE_SMOOTH_STEP  ====
+
+//******************************************************************************
+//  Move a value linearly towards its target over a number of samples.
+//  Returns true if the value moved.
+//
+t_bool _core_smooth_step(t_double* value, t_double targ, t_int32* cntd, t_int32 len) {
+
+  if (*cntd <= 0) { return false; }
+
+  if (len >= *cntd) { *value = targ; *cntd = 0; }
+  else { *value += (targ - *value) * len / *cntd; *cntd -= len; }
+
+  return true;
+}
+
+// ====  _CORE_SMOOTH_GAINS  ====
+
+//******************************************************************************
+//  Move the smoothed gains to their values at the end of the vector,
+//  keeping the values at the start of the vector to interpolate in between.
+//  Flags the rows and columns of effective gains that moved.
+//  Does nothing when no gain is moving, so static gains cost nothing.
+//
+void _core_smooth_gains(t_core* core, t_int32 sampleframes) {
+
+  // Run one more vector after the last move to clear the moving flags
+  if (!core->is_smoothing && !core->gain_is_moving) { return; }
+
+  t_bool is_smoothing = false;
+  t_bool is_moving = false;
+
+  // Master gain
+  t_bool is_master_moving = _core_smooth_step(&core->master, core->master_targ, &core->master_cntd, sampleframes);
+  is_smoothing |= (core->master_cntd > 0);
+  is_moving |= is_master_moving;
+
+  // Input gains
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+    t_channel* channel = core->channel_arr + in;
+    channel->gain_mast_prev = channel->gain_mast;
+    channel->is_gain_moving = _core_smooth_step(&channel->gain, channel->gain_targ, &channel->gain_cntd, sampleframes);
+    channel->is_gain_moving |= is_master_moving;
+    is_smoothing |= (channel->gain_cntd > 0);
+    is_moving |= channel->is_gain_moving;
+
+    if (channel->is_gain_moving) {
+      channel->gain_mast = core->master * channel->gain;
+      channel->is_gain_dirty = true;
+    }
+  }
+
+  // Output gains
+  for (t_int32 out = 0; out < core->out_cnt; out++) {
+
+    core->out_gain_prev[out] = core->out_gain[out];
+    core->out_is_moving[out] = _core_smooth_step(core->out_gain + out, core->out_gain_targ[out], core->out_gain_cntd + out, sampleframes);
+    is_smoothing |= (core->out_gain_cntd[out] > 0);
+    is_moving |= core->out_is_moving[out];
+
+    if (core->out_is_moving[out]) {
+      core->out_is_dirty[out] = true;
+      core->gain_is_dirty = true;
+    }
+  }
+
+  core->is_smoothing = is_smoothing;
+  core->gain_is_moving = is_moving;
+}
+
+// ====  _CORE_UPDATE_GAINS  ====
+
+//******************************************************************************
+//  Recalculate the columns of effective gains for the output gains that changed.
+//  The dirty rows are skipped: they are recalculated entirely before being used.
+//
+void _core_update_gains(t_core* core) {
+
+  if (!core->gain_is_dirty) { return; }
+
+  for (t_int32 out = 0; out < core->out_cnt; out++) {
+
+    if (!core->out_is_dirty[out]) { continue; }
+
+    for (t_int32 in = 0; in < core->channel_cnt; in++) {
+      t_channel* channel = core->channel_arr + in;
+      if (channel->is_gain_dirty) { continue; }
+      channel->gain_eff[out] = channel->gain_mast * core->out_gain[out] * channel->A_cur[out];
+    }
+
+    core->out_is_dirty[out] = false;
+  }
+
+  core->gain_is_dirty = false;
+}
+
+// ====  _CORE_DETECT_SILENCE  ====
+
+//******************************************************************************
+//  Flag the inputs that have been silent for at least the hold time.
+//  The scan stops at the first sample above the threshold, so it is cheap for active inputs.
+//  NaN samples are not considered silent.
+//
+void _core_detect_silence(t_core* core, t_double** in_arr, t_int32 sampleframes) {
+
+  if (!core->silence_is_on) { return; }
+
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+    t_channel* channel = core->channel_arr + in;
+    if (!channel->is_on) { continue; }
+
+    const t_double* sig_in = in_arr[in];
+    t_bool is_silent = true;
+
+    for (t_int32 smp = 0; smp < sampleframes; smp++) {
+      if (!(fabs(sig_in[smp]) <= core->silence_thresh)) { is_silent = false; break; }
+    }
+
+    // Count the silent samples up to the hold time
+    if (!is_silent) { channel->silence_cnt = 0; }
+    else if (channel->silence_cnt < core->silence_hold_smp) { channel->silence_cnt += sampleframes; }
+
+    channel->is_silent = is_silent && (channel->silence_cnt >= core->silence_hold_smp);
+  }
+}
+
+// ====  _CORE_PERFORM_MIX  ====
+
+//******************************************************************************
+//  Blocked engine: mix the inputs into the outputs as a matrix product,
+//  when the gains of all the active channels are constant over the vector.
+//  The outputs are processed in blocks of KERNELS_MIX_OUT, and the inputs and samples in tiles,
+//  so that the accumulators stay in registers and the input samples in L1.
+//  The first input tile stores into the outputs, so they do not have to be set to zero.
+//
+void _core_perform_mix(t_core* core, t_double** in_arr, t_double** out_arr, t_int32 sampleframes) {
+
+  t_int32 stride = core->out_pad;
+  t_int32 in_cnt = 0;
+
+  // Gather the active inputs and their rows of effective gains
+  // The rows are padded with zeros up to gain_stride, which is at least out_pad
+  for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+    t_channel* channel = core->channel_arr + in;
+    if (!channel->is_on || channel->is_silent || (channel->gain_mast == 0)) { continue; }
+
+    if (channel->is_gain_dirty) { _channel_calc_gain(core, channel); }
+
+    core->mix_gain_arr[in_cnt] = channel->gain_eff;
+    core->mix_in_arr[in_cnt++] = in_arr[in];
+  }
+
+  // No active input: set all the output vectors to zero
+  if (in_cnt == 0) {
+    for (t_int32 out = 0; out < core->out_cnt; out++) {
+      for (t_int32 smp = 0; smp < sampleframes; smp++) { out_arr[out][smp] = 0; }
+    }
+    core->out_idle_cnt = core->out_cnt;
+    return;
+  }
+
+  // All the outputs are stored to by the first input tile
+  core->out_idle_cnt = 0;
+
+  // The padding outputs all write to the scratch vector
+  for (t_int32 out = 0; out < stride; out++) {
+    core->mix_out_arr[out] = (out < core->out_cnt) ? out_arr[out] : core->mix_scratch;
+  }
+
+  // Large matrices: split the blocks of outputs across the threads
+  // Each output is still summed in the same order, so the result does not depend on the threads
+  core->mix_in_cnt = in_cnt;
+
+  if (core->workers && (in_cnt * core->out_cnt >= core->thread_routes_min)) {
+    core->perform_frames = sampleframes;
+    core->perform_task_cnt = _core_task_cnt(core, stride / KERNELS_MIX_OUT);
+    workers_run(core->workers, _core_task_mix, core, core->perform_task_cnt);
+    return;
+  }
+
+  _core_mix_outs(core, 0, stride, sampleframes);
+}
+
+// ====  _CORE_MIX_OUTS  ====
+
+//******************************************************************************
+//  Blocked engine: loop through the tiles for the outputs from out_beg to out_end,
+//  two multiples of KERNELS_MIX_OUT.
+//
+void _core_mix_outs(t_core* core, t_int32 out_beg, t_int32 out_end, t_int32 sampleframes) {
+
+  t_int32 in_cnt = core->mix_in_cnt;
+
+  // ####  LOOP THROUGH THE TILES  ####
+
+  for (t_int32 smp = 0; smp < sampleframes; smp += core->mix_smp_tile) {
+
+    t_int32 smp_len = MIN(core->mix_smp_tile, sampleframes - smp);
+
+    for (t_int32 in = 0; in < in_cnt; in += core->mix_in_tile) {
+
+      t_int32 in_len = MIN(core->mix_in_tile, in_cnt - in);
+
+      for (t_int32 out = out_beg; out < out_end; out += KERNELS_MIX_OUT) {
+        core->kernels->mix(core->mix_out_arr + out, core->mix_in_arr + in, core->mix_gain_arr + in,
+          out, in_len, smp, smp_len, in == 0);
+      }
+    }
+  }
+}
+
+// ====  THREAD TASKS  ====
+// The jobs of the perform routine on the worker pool: the argument is the core,
+// and each task processes a range of the work items, balanced over perform_task_cnt tasks
+
+//******************************************************************************
+//  Number of tasks for item_cnt work items: a few per thread, so that a thread
+//  that starts late or is preempted does not hold up the others.
+//
+t_int32 _core_task_cnt(t_core* core, t_int32 item_cnt) {
+
+  return MAX(1, MIN(item_cnt, THREAD_TASKS_PER * core->thread_cnt));
+}
+
+//******************************************************************************
+//  Blocked engine: one task for a range of output blocks.
+//
+void _core_task_mix(void* arg, t_int32 task, t_int32 thread) {
+
+  t_core* core = (t_core*)arg;
+  t_int32 blk_cnt = core->out_pad / KERNELS_MIX_OUT;
+  t_int32 blk_beg = (t_int32)((int64_t)blk_cnt * task / core->perform_task_cnt);
+  t_int32 blk_end = (t_int32)((int64_t)blk_cnt * (task + 1) / core->perform_task_cnt);
+  (void)thread;
+
+  _core_mix_outs(core, blk_beg * KERNELS_MIX_OUT, blk_end * KERNELS_MIX_OUT, core->perform_frames);
+}
+
+//******************************************************************************
+//  Channel loop: one task for a range of input channels, into the outputs of the thread.
+//
+void _core_task_channel(void* arg, t_int32 task, t_int32 thread) {
+
+  t_core* core = (t_core*)arg;
+  t_int32 in_beg = (t_int32)((int64_t)core->channel_cnt * task / core->perform_task_cnt);
+  t_int32 in_end = (t_int32)((int64_t)core->channel_cnt * (task + 1) / core->perform_task_cnt);
+
+  for (t_int32 in = in_beg; in < in_end; in++) {
+    _core_perform_channel(core, core->thread_arr + thread, in, core->perform_in_arr, core->perform_frames);
+  }
+}
+
+//******************************************************************************
+//  Channel loop: one task for a range of outputs, adding the outputs of the helper threads
+//  into the outputs of the audio thread. The flags of the helpers are reset for the next vector.
+//
+void _core_task_reduce(void* arg, t_int32 task, t_int32 thread) {
+
+  t_core* core = (t_core*)arg;
+  t_int32 out_beg = (t_int32)((int64_t)core->out_cnt * task / core->perform_task_cnt);
+  t_int32 out_end = (t_int32)((int64_t)core->out_cnt * (task + 1) / core->perform_task_cnt);
+  t_core_thread* audio = core->thread_arr;
+  t_int32 len = core->perform_frames;
+  (void)thread;
+
+  for (t_int32 th = 1; th < core->thread_cnt; th++) {
+
+    t_core_thread* helper = core->thread_arr + th;
+
+    for (t_int32 out = out_beg; out < out_end; out++) {
+
+      if (!helper->out_is_written[out]) { continue; }
+      helper->out_is_written[out] = false;
+
+      t_double* dst = audio->out_arr[out];
+      t_double* src = helper->out_arr[out];
+
+      if (audio->out_is_written[out]) {
+        for (t_int32 smp = 0; smp < len; smp++) { dst[smp] += src[smp]; }
+      } else {
+        for (t_int32 smp = 0; smp < len; smp++) { dst[smp] = src[smp]; }
+        audio->out_is_written[out] = true;
+      }
+    }
+  }
+}
+
+// ====  _CORE_PERFORM_CHANNEL  ====
+
+//******************************************************************************
+//  Mix one input channel into the outputs of a thread of the perform routine.
+//  Only changes the state of the channel, so different channels can run on different threads.
+//
+void _core_perform_channel(t_core* core, t_core_thread* thread, t_int32 in, t_double** in_arr, t_int32 sampleframes) {
+
+  t_channel* channel = core->channel_arr + in;
+
+  // If the channel is off don't do anything in this loop
+  if (!channel->is_on) { return; }
+
+  // Local variables
+  t_int32 chunk_len = -1;
+  t_int32 smp_left = 0;
+  t_int32 smp_proc = 0;
+  t_int32 smp_left_x_vel = 0;
+  t_int32 cntd_d_vel = 0;
+  t_bool is_fixed = false;
+  t_bool is_moving = false;
+  t_double gain_beg = 0.0;
+  t_double gain_end = 0.0;
+  t_double d_gain = 0.0;
+  t_double dA = 0.0;
+  t_double A_U_dU = 0.0;
+  t_int32 ctrl_left = 0;
+  t_double ctrl_d_vel = 0.0;
+  t_bool is_ctrl_partial = false;
+
+  t_double* sig_in = NULL;
+  t_double* sig_out = NULL;
+
+  // We are tracking where we are using:
+  //   smp_left:      the number of samples left to process in this perform cycle
+  //   chunk_len:     the number of samples to process in a chunk,
+  //                  until end of perform cycle or end of countdown, whichever comes first, cannot be 0
+  //   channel->cntd: the total number of sampleframes left to process (unscaled by the velocity)
+
+  // ####  LOOP THROUGH THE CHUNKS  ####
+
+  smp_left = sampleframes;
+  while (smp_left) {
+
+    // == Temporary variables - scaling by the velocity
+    smp_left_x_vel = (t_int32)(smp_left * channel->velocity);
+    cntd_d_vel = (t_int32)(channel->cntd / channel->velocity);          // cannot be 0, unless cntd is 0
+    if ((cntd_d_vel == 0) && (channel->cntd != 0)) { cntd_d_vel = 1; }  // correct for rounding down to 0 when cntd is not 0
+
+    // Keep track of the number of samples processed so far
+    smp_proc = sampleframes - smp_left;
+
+    // Control rate: countdown left to the next sub-block boundary, from 1 to control_rate
+    // The boundaries are set on the countdown, so they do not depend on the vector size
+    ctrl_left = ((core->control_rate > 0) && (channel->cntd > 0)) ? ((channel->cntd - 1) % core->control_rate) + 1 : 0;
+    ctrl_d_vel = ctrl_left / channel->velocity;
+    is_ctrl_partial = false;
+
+    // == Determine the chunk length and update the countdown and smp_left accordingly
+    // == Six cases depending on the countdown
+
+    // == If the bank is set to freeze
+    // == process the whole audio vector with no ramping or countdown
+    if (channel->is_frozen) { chunk_len = sampleframes; smp_left = 0; }
+
+    // == Zero countdown:  Iterate the mode and skip this chunk loop
+    else if (channel->cntd == 0) {
+      _state_iterate(core, channel, smp_proc);
+      continue;
+    }
+
+    // == Indefinite countdown:  The chunk is the whole length of the perform cycle
+    else if (channel->cntd == INDEFINITE) { chunk_len = smp_left; smp_left = 0; }
+
+    // == Control rate:  The chunk ends on a sub-block boundary, before the end of the countdown and perform cycle
+    else if ((ctrl_left > 0) && (ctrl_left < channel->cntd) && (ctrl_left <= smp_left_x_vel)) {
+      chunk_len = MAX(MIN((t_int32)ctrl_d_vel, smp_left), 1); smp_left -= chunk_len; channel->cntd -= ctrl_left;
+    }
+
+    // == Countdown extends beyond perform cycle:  The chunk is the whole length of the perform cycle
+    // With a control rate the chunk ends inside a sub-block
+    else if (channel->cntd > smp_left_x_vel) {
+      chunk_len = smp_left; smp_left = 0; channel->cntd -= smp_left_x_vel; is_ctrl_partial = (ctrl_left > 0);
+    }
+    // No velocity version:
+    // else if (reson->cntd > smp_left) { chunk_len = smp_left; smp_left = 0; reson->cntd -= chunk_len; }
+
+    // == Countdown shorter than perform cycle:  Keep processing chunks and mode changes
+    else { chunk_len = cntd_d_vel; smp_left -= chunk_len; channel->cntd = 0; }    // smp_left never gets to -1 in spite of rounding
+    // No velocity version:
+    // else { chunk_len = reson->cntd; smp_left -= chunk_len; reson->cntd = 0; }
+
+    // The effective gains are only used when there is no ramping
+    is_fixed = (channel->mode_type == MODE_TYPE_FIX) || (channel->is_frozen) || (channel->cntd == INDEFINITE);
+    if (is_fixed && channel->is_gain_dirty) { _channel_calc_gain(core, channel); }
+
+    // ####  EVALUATE THE CURVE FOR ALL THE ACTIVE ROUTES  ####
+    // Increment U and calculate A(U + dU) into curve_a_arr, with the version specialized for the curve
+
+    if ((!is_fixed) && (channel->mode_type == MODE_TYPE_VAR)) {
+      _core_curve_routes(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial);
+    }
+
+    // ####  LOOP THROUGH THE ACTIVE ROUTES  ####
+    // Outputs with a current and target gain of 0 are not in the list
+
+    for (t_int32 route = 0; route < channel->route_cnt; route++) {
+
+      t_int32 out = channel->route_arr[route];
+
+      // Initialize the input and output pointers to the current position in the vectors
+      sig_in = in_arr[in] + smp_proc;
+      sig_out = thread->out_arr[out] + smp_proc;
+
+      // >>>>  IF THE CHANNEL IS FIXED, FROZEN OR INDEFINITE
+
+      // A gain is being smoothed: interpolate the non ramping gain linearly over the vector
+      is_moving = core->gain_is_moving && (channel->is_gain_moving || core->out_is_moving[out]);
+
+      if (is_moving) {
+        gain_beg = channel->gain_mast_prev * core->out_gain_prev[out];
+        gain_end = channel->gain_mast * core->out_gain[out];
+        d_gain = (gain_end - gain_beg) / sampleframes;
+        gain_end = gain_beg + d_gain * (smp_proc + chunk_len);
+        gain_beg = gain_beg + d_gain * smp_proc;
+      }
+
+      // == Add values without ramping
+      if (is_fixed && is_moving) {
+
+        if (((gain_beg == 0) && (gain_end == 0)) || (channel->A_cur[out] == 0) || (channel->is_silent)) { continue; }
+
+        // ####  LOOP THROUGH THE SAMPLES  ####
+        // The gain ramps linearly over the chunk: use the ramping kernel
+
+        core->kernels->var(sig_out, sig_in, channel->A_cur[out] * gain_beg,
+          channel->A_cur[out] * (gain_end - gain_beg) / chunk_len, chunk_len,
+          _core_is_first_write(thread, out, chunk_len, sampleframes));
+      }
+
+      else if (is_fixed) {
+
+        // If the effective gain is 0 or the input is silent skip the sample loop
+        // Could be from: master, gain input, output gain, or input-output multiplier
+        if ((channel->gain_eff[out] == 0) || (channel->is_silent)) { continue; }
+
+        // ####  LOOP THROUGH THE SAMPLES  ####
+        // The effective gain is premultiplied, and only recalculated when one of its factors changes
+
+        core->kernels->fix(sig_out, sig_in, channel->gain_eff[out], chunk_len,
+          _core_is_first_write(thread, out, chunk_len, sampleframes));
+      }
+
+      // >>>>  IF THE CHANNEL IS RAMPING
+
+      // == Add values with ramping
+      else if (channel->mode_type == MODE_TYPE_VAR) {
+
+        // Calculate the non ramping gain: master, input channel and output channel
+        if (!is_moving) { gain_beg = gain_end = channel->gain_mast * core->out_gain[out]; }
+
+        // Calculate dA: linear ramping of amplitude over the chunk length
+
+        // A(U + dU): the target amplitude value at the end of the chunk length, calculated above
+        A_U_dU = thread->curve_a_arr[route];
+
+        // With a control rate, a chunk that ends inside a sub-block stays on the straight line
+        // to the amplitude at the end of the sub-block, so the curve does not depend on the vector size
+        if (is_ctrl_partial && !channel->is_exact) {
+          A_U_dU = channel->A_cur[out] + (A_U_dU - channel->A_cur[out]) * chunk_len / ctrl_d_vel;
+        }
+
+        // If one of the gains is 0 or the input is silent update A_cur, and skip the sample loop
+        // Could be from: master, gain input, output gain, or input to output multiplier
+        if (((gain_beg == 0) && (gain_end == 0)) || (channel->is_silent)
+          || ((channel->A_cur[out] == 0) && ((channel->A_targ[out] == 0)))) {
+          channel->A_cur[out] = A_U_dU; continue;
+        }
+
+        // Calculate dA
+        dA = (A_U_dU - channel->A_cur[out]) / chunk_len;    // chunk_len cannot be 0
+
+        // ####  LOOP THROUGH THE SAMPLES  ####
+        // The amplitude of each sample is calculated from its index in the chunk,
+        // and A_cur is written back once at the end of the chunk
+        // While a gain is smoothed, the product of amplitude and gain is interpolated over the chunk
+
+        d_gain = is_moving ? (A_U_dU * gain_end - channel->A_cur[out] * gain_beg) / chunk_len : dA * gain_beg;
+
+        // Exact exponential ramp: the amplitude follows the curve sample by sample with the recurrence,
+        // and is anchored back on the curve at the end of each chunk
+        // While a gain is smoothed the product is not a recurrence, and stays on the straight line
+        if (channel->is_exact && !is_moving) {
+          core->kernels->geo(sig_out, sig_in, channel->A_cur[out] * gain_beg, thread->curve_r_arr[route],
+            thread->curve_u_arr[route] * gain_beg, chunk_len,
+            _core_is_first_write(thread, out, chunk_len, sampleframes));
+          channel->A_cur[out] = A_U_dU;
+          continue;
+        }
+
+        core->kernels->var(sig_out, sig_in, channel->A_cur[out] * gain_beg, d_gain, chunk_len,
+          _core_is_first_write(thread, out, chunk_len, sampleframes));
+        channel->A_cur[out] = A_U_dU;
+      }
+
+      // == OTHERWISE:  MODE_TYPE_OFF, nothing to add
+
+    }  // End the loop through the active routes
+
+    // A_cur changed over the chunk
+    if (!is_fixed) { channel->is_gain_dirty = true; }
+  }  // End the loop through the chunks
+}
+
+// ====  CORE_PERFORM  ====
+
+//******************************************************************************
+//  Mix the input vectors into the output vectors.
+//
+void core_perform(t_core* core, t_double** in_arr, t_double** out_arr, t_int32 sampleframes) {
+
+  // Apply the changes posted by the control thread since the last vector
+  core_cmd_drain(core);
+
+  core->thread_arr[0].out_arr = out_arr;
+
+  // Flag the inputs that are silent
+  _core_detect_silence(core, in_arr, sampleframes);
+
+  // Move the smoothed gains, then apply the changes of output gains to the effective gains
+  _core_smooth_gains(core, sampleframes);
+  _core_update_gains(core);
+
+  // No channel is ramping and the routing is dense enough: use the blocked engine
+  // Otherwise the channel loop only visits the active routes of each channel
+  if ((sampleframes <= core->mix_vec_max) && _core_is_static(core)
+    && (_core_route_cnt(core) >= core->mix_density_min * core->channel_cnt * core->out_cnt)) {
+    _core_perform_mix(core, in_arr, out_arr, sampleframes);
+    core->smp_time += sampleframes;
+    return;
+  }
+
+  // No output has been written to yet: the first route to reach an output stores instead of accumulating
+  for (t_int32 out = 0; out < core->out_cnt; out++) { core->out_is_written[out] = false; }
+
+  //  ####  LOOP THROUGH THE INPUT CHANNELS  ####
+
+  // Large matrices: split the channels across the threads, each with its own outputs,
+  // then split the outputs to add them together
+  // The state of a channel is only changed by the thread that runs it
+  if (core->workers && (core->channel_cnt * core->out_cnt >= core->thread_routes_min)) {
+
+    core->perform_in_arr = in_arr;
+    core->perform_frames = sampleframes;
+    core->perform_task_cnt = _core_task_cnt(core, core->channel_cnt);
+    workers_run(core->workers, _core_task_channel, core, core->perform_task_cnt);
+
+    core->perform_task_cnt = _core_task_cnt(core, core->out_cnt);
+    workers_run(core->workers, _core_task_reduce, core, core->perform_task_cnt);
+  }
+
+  else {
+    for (t_int32 in = 0; in < core->channel_cnt; in++) {
+      _core_perform_channel(core, core->thread_arr, in, in_arr, sampleframes);
+    }
+  }
+
+  // Queue the ramps that ended for the owner, from the calling thread
+  if (core->end_is_on) { _core_end_push(core); }
+  core->smp_time += sampleframes;
+
+  // Set the outputs that received no contribution to zero
+  core->out_idle_cnt = 0;
+
+  for (t_int32 out = 0; out < core->out_cnt; out++) {
+    if (core->out_is_written[out]) { continue; }
+    for (t_int32 smp = 0; smp < sampleframes; smp++) { out_arr[out][smp] = 0; }
+    core->out_idle_cnt++;
+  }
+}
+
+// ====  CURVE SPECIALIZATIONS  ====
+// One version of _core_curve_routes per curve type, generated by CORE_CURVE_ROUTES,
+// with the algebra of the curve inlined around the math kernels instead of an indirect call:
+//   CONST:   Calculated once per call from the parameter a
+//   PRE:     The argument of the math kernels, from the abscissa u
+//   KERNEL:  The math kernels, applied in place to val_arr
+//   POST:    The ordinate, from the abscissa u and the result y of the kernels
+
+#define CORE_CURVE_ROUTES(NAME, CONST, PRE, KERNEL, POST)                                   \
+static void NAME(t_core* core, t_core_thread* thread, t_channel* channel, t_int32 chunk_len, \
+    t_int32 cntd_d_vel, t_double ctrl_d_vel, t_bool is_ctrl_partial) {                       \
+                                                                                             \
+  const t_kernels* kernels = core->kernels;                                                  \
+  const t_double a = channel->interp_param;                                                  \
+  const t_double c = (CONST);                                                                \
+  t_double* u_arr = thread->curve_u_arr;                                                     \
+  t_double* val_arr = thread->curve_a_arr;                                                   \
+  t_int32 cnt = channel->route_cnt;                                                          \
+  (void)kernels; (void)a; (void)c;                                                           \
+                                                                                             \
+  for (t_int32 route = 0; route < cnt; route++) {                                            \
+                                                                                             \
+    t_int32 out = channel->route_arr[route];                                                 \
+                                                                                             \
+    /* Increment the normalized ordinate value U by dU for the chunk length: */              \
+    /* recalculate each chunk to avoid cumulative errors */                                  \
+    t_double U_prev = channel->U_cur[out];                                                   \
+    channel->U_cur[out] += chunk_len * (channel->U_targ[out] - U_prev) / cntd_d_vel;         \
+                                                                                             \
+    /* The abscissa at the end of the chunk, or with a control rate at the end of the sub-block */ \
+    t_double u = (is_ctrl_partial)                                                           \
+      ? U_prev + ctrl_d_vel * (channel->U_targ[out] - U_prev) / cntd_d_vel : channel->U_cur[out]; \
+    u_arr[route] = u;                                                                        \
+    val_arr[route] = (PRE);                                                                  \
+  }                                                                                          \
+                                                                                             \
+  KERNEL;                                                                                    \
+                                                                                             \
+  for (t_int32 route = 0; route < cnt; route++) {                                            \
+    t_double u = u_arr[route];                                                               \
+    t_double y = val_arr[route];                                                             \
+    (void)u; (void)y;                                                                        \
+    val_arr[route] = (POST);                                                                 \
+  }                                                                                          \
+}
+
+// ramp_poly:  exp(a * log(u)), the multiplication sits between the two kernels
+static void _curve_kernel_poly(const t_kernels* kernels, t_double* val_arr, t_double a, t_int32 cnt) {
+
+  kernels->log(val_arr, val_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { val_arr[i] *= a; }
+  kernels->exp(val_arr, val_arr, cnt);
+}
+
+CORE_CURVE_ROUTES(_core_curve_none,   0, (u < 0.5) ? 0 : 1, (void)0, y)
+CORE_CURVE_ROUTES(_core_curve_linear, 0, u, (void)0, y)
+CORE_CURVE_ROUTES(_core_curve_lut,    0, curve_lut_eval(channel->interp_lut, u), (void)0, y)
+CORE_CURVE_ROUTES(_core_curve_poly,   0, u, _curve_kernel_poly(kernels, val_arr, a, cnt), (u != 0) ? y : 0)
+CORE_CURVE_ROUTES(_core_curve_exp,    1 / (exp(a) - 1), a * u, kernels->exp(val_arr, val_arr, cnt), (y - 1) * c)
+CORE_CURVE_ROUTES(_core_curve_sqrt,   0, sqrt(u), (void)0, y)
+CORE_CURVE_ROUTES(_core_curve_sinus,  0, u * (PI / 2), kernels->sin(val_arr, val_arr, cnt), y)
+
+//******************************************************************************
+//  ramp_exp at sample resolution:  A(U) = (exp(a U) - 1) c is affine in exp(a U), and U is linear over the chunk,
+//  so the amplitude follows the recurrence A[i + 1] = r A[i] + (r - 1) c with r = exp(a dU) per sample.
+//  Calculates the exact amplitude at the end of the chunk into curve_a_arr, to start the next chunk from,
+//  the ratio r into curve_r_arr and the offset (r - 1) c into curve_u_arr.
+//  The control rate does not apply, the curve is the same for any vector size.
+//
+static void _core_curve_exp_exact(t_core* core, t_core_thread* thread, t_channel* channel, t_int32 chunk_len,
+    t_int32 cntd_d_vel) {
+
+  const t_kernels* kernels = core->kernels;
+  const t_double a = channel->interp_param;
+  const t_double c = 1 / (exp(a) - 1);
+  t_double* val_arr = thread->curve_a_arr;
+  t_double* r_arr = thread->curve_r_arr;
+  t_double* ofs_arr = thread->curve_u_arr;
+  t_int32 cnt = channel->route_cnt;
+
+  for (t_int32 route = 0; route < cnt; route++) {
+
+    t_int32 out = channel->route_arr[route];
+    t_double dU = (channel->U_targ[out] - channel->U_cur[out]) / cntd_d_vel;
+    channel->U_cur[out] += chunk_len * dU;
+    val_arr[route] = a * channel->U_cur[out];
+    r_arr[route] = a * dU;
+  }
+
+  kernels->exp(val_arr, val_arr, cnt);
+  kernels->exp(r_arr, r_arr, cnt);
+
+  for (t_int32 route = 0; route < cnt; route++) {
+    val_arr[route] = (val_arr[route] - 1) * c;
+    ofs_arr[route] = (r_arr[route] - 1) * c;
+  }
+}
+
+// ====  _CORE_CURVE_ROUTES  ====
+
+//******************************************************************************
+//  Advance the abscissa of the active routes of a ramping channel over a chunk,
+//  and calculate the ordinates at the end of the chunk into the curve_a_arr of the thread.
+//  Dispatches once per chunk to the version specialized for the curve of the channel.
+//
+void _core_curve_routes(t_core* core, t_core_thread* thread, t_channel* channel, t_int32 chunk_len, t_int32 cntd_d_vel,
+    t_double ctrl_d_vel, t_bool is_ctrl_partial) {
+
+  if (channel->is_exact) {
+    _core_curve_exp_exact(core, thread, channel, chunk_len, cntd_d_vel);
+  }
+
+  else if (channel->interp_lut) {
+    _core_curve_lut(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial);
+  }
+
+  else if (channel->interp_type == INTERP_TYPE_RAMP) {
+
+    switch (channel->ramp_type) {
+    case RAMP_NONE: _core_curve_none(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    case RAMP_POLY: _core_curve_poly(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    case RAMP_EXP:  _core_curve_exp(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    default:        _core_curve_linear(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    }
+  }
+
+  else {
+
+    switch (channel->xfade_type) {
+    case XFADE_NONE:       _core_curve_none(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    case XFADE_SQRT:       _core_curve_sqrt(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    case XFADE_SINUSOIDAL: _core_curve_sinus(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    default:               _core_curve_linear(core, thread, channel, chunk_len, cntd_d_vel, ctrl_d_vel, is_ctrl_partial); break;
+    }
+  }
+}
+
+// ====  _CORE_IS_FIRST_WRITE  ====
+
+//******************************************************************************
+//  Called before a route writes to an output, and flags the output as written.
+//  Returns true if the route is the first one and should store instead of accumulating.
+//  The first write can only store if it covers the whole vector:
+//  for a shorter chunk the output vector is set to zero first, and the route accumulates.
+//
+t_bool _core_is_first_write(t_core_thread* thread, t_int32 out, t_int32 chunk_len, t_int32 sampleframes) {
+
+  if (thread->out_is_written[out]) { return false; }
+
+  thread->out_is_written[out] = true;
+  if (chunk_len == sampleframes) { return true; }
+
+  for (t_int32 smp = 0; smp < sampleframes; smp++) { thread->out_arr[out][smp] = 0; }
+  return false;
+}
+
+// ========  CURVES METHODS  ========
+
+// ====  _CURVES_INIT  ====
+
+//******************************************************************************
+//  Initialize a set of curves: exponential ramps and sinusoidal crossfades, without tables.
+//  The table arrays are set by _core_layout.
+//
+void _curves_init(t_curves* curves) {
+
+  // Ramping parameter, function, and inverse function
+  curves->ramp_type = RAMP_EXP;
+  curves->ramp_param = 4;
+  curves->ramp_func = ramp_exp;
+  curves->ramp_inv_func = ramp_exp_inv;
+  curves->ramp_arr_func = ramp_exp_arr;
+  curves->ramp_inv_arr_func = ramp_exp_inv_arr;
+
+  // Crossfade parameter, function, and inverse function
+  curves->xfade_type = XFADE_SINUSOIDAL;
+  curves->xfade_param = -3;
+  curves->xfade_func = xfade_sinus;
+  curves->xfade_inv_func = xfade_sinus_inv;
+  curves->xfade_arr_func = xfade_sinus_arr;
+  curves->xfade_inv_arr_func = xfade_sinus_inv_arr;
+
+  // Curve tables: off, built by _curves_build
+  curves->lut_err = 0;
+  curves->ramp_lut.size = 0;
+  curves->ramp_inv_lut.size = 0;
+  curves->xfade_lut.size = 0;
+  curves->xfade_inv_lut.size = 0;
+  curves->ramp_tab.size = 0;
+  curves->ramp_inv_tab.size = 0;
+  curves->xfade_tab.size = 0;
+  curves->xfade_inv_tab.size = 0;
+}
+
+// ====  _CURVES_COPY  ====
+
+//******************************************************************************
+//  Copy a set of curves into another one, with the breakpoint curve tables.
+//  The other tables are not copied: _curves_build rebuilds them.
+//
+static void _curves_copy_tab(t_curve_lut* dst, const t_curve_lut* src) {
+
+  dst->size = src->size;
+  for (t_int32 ind = 0; ind <= src->size; ind++) { dst->y_arr[ind] = src->y_arr[ind]; }
+}
+
+void _curves_copy(t_curves* dst, const t_curves* src) {
+
+  dst->ramp_type = src->ramp_type;
+  dst->ramp_param = src->ramp_param;
+  dst->ramp_func = src->ramp_func;
+  dst->ramp_inv_func = src->ramp_inv_func;
+  dst->ramp_arr_func = src->ramp_arr_func;
+  dst->ramp_inv_arr_func = src->ramp_inv_arr_func;
+
+  dst->xfade_type = src->xfade_type;
+  dst->xfade_param = src->xfade_param;
+  dst->xfade_func = src->xfade_func;
+  dst->xfade_inv_func = src->xfade_inv_func;
+  dst->xfade_arr_func = src->xfade_arr_func;
+  dst->xfade_inv_arr_func = src->xfade_inv_arr_func;
+
+  dst->lut_err = src->lut_err;
+
+  _curves_copy_tab(&dst->ramp_tab, &src->ramp_tab);
+  _curves_copy_tab(&dst->ramp_inv_tab, &src->ramp_inv_tab);
+  _curves_copy_tab(&dst->xfade_tab, &src->xfade_tab);
+  _curves_copy_tab(&dst->xfade_inv_tab, &src->xfade_inv_tab);
+}
+
+// ====  _CURVES_SET_RAMP  ====
+
+//******************************************************************************
+//  Set the ramping function and its parameter of a set of curves.
+//  Returns false for an invalid type, or an invalid parameter for the type: the function is unchanged.
+//  RAMP_TABLE is only valid once a curve has been compiled in ramp_tab.
+//
+t_bool _curves_set_ramp(t_curves* curves, t_ramp_type type, t_double param) {
+
+  if ((type == RAMP_TABLE) && (curves->ramp_tab.size == 0)) { return false; }
+  if ((type == RAMP_POLY) && (param <= 0)) { return false; }
+  if ((type == RAMP_EXP) && ((param == 0) || (fabs(param) > RAMP_EXP_PARAM_MAX))) { return false; }
+
+  switch (type) {
+
+  case RAMP_NONE:
+    curves->ramp_func = ramp_none;
+    curves->ramp_inv_func = ramp_none_inv;
+    curves->ramp_arr_func = ramp_none_arr;
+    curves->ramp_inv_arr_func = ramp_none_inv_arr;
+    break;
+
+  case RAMP_LINEAR:
+    curves->ramp_func = ramp_linear;
+    curves->ramp_inv_func = ramp_linear_inv;
+    curves->ramp_arr_func = ramp_linear_arr;
+    curves->ramp_inv_arr_func = ramp_linear_inv_arr;
+    break;
+
+  case RAMP_POLY:
+    curves->ramp_func = ramp_poly;
+    curves->ramp_inv_func = ramp_poly_inv;
+    curves->ramp_arr_func = ramp_poly_arr;
+    curves->ramp_inv_arr_func = ramp_poly_inv_arr;
+    break;
+
+  case RAMP_EXP:
+    curves->ramp_func = ramp_exp;
+    curves->ramp_inv_func = ramp_exp_inv;
+    curves->ramp_arr_func = ramp_exp_arr;
+    curves->ramp_inv_arr_func = ramp_exp_inv_arr;
+    break;
+
+  case RAMP_SIGMOID:
+    curves->ramp_func = ramp_sigmoid;
+    curves->ramp_inv_func = ramp_sigmoid_inv;
+    curves->ramp_arr_func = ramp_sigmoid_arr;
+    curves->ramp_inv_arr_func = ramp_sigmoid_inv_arr;
+    break;
+
+  // The functions are placeholders: the compiled tables are always used
+  case RAMP_TABLE:
+    curves->ramp_func = ramp_linear;
+    curves->ramp_inv_func = ramp_linear_inv;
+    curves->ramp_arr_func = ramp_linear_arr;
+    curves->ramp_inv_arr_func = ramp_linear_inv_arr;
+    break;
+
+  default:
+    return false;
+  }
+
+  curves->ramp_type = type;
+  curves->ramp_param = param;
+
+  return true;
+}
+
+// ====  _CURVES_SET_XFADE  ====
+
+//******************************************************************************
+//  Set the crossfade function and its parameter of a set of curves.
+//  Returns false for an invalid type: the function is unchanged.
+//  XFADE_TABLE is only valid once a curve has been compiled in xfade_tab.
+//
+t_bool _curves_set_xfade(t_curves* curves, t_xfade_type type, t_double param) {
+
+  if ((type == XFADE_TABLE) && (curves->xfade_tab.size == 0)) { return false; }
+
+  switch (type) {
+
+  case XFADE_NONE:
+    curves->xfade_func = xfade_none;
+    curves->xfade_inv_func = xfade_none_inv;
+    curves->xfade_arr_func = xfade_none_arr;
+    curves->xfade_inv_arr_func = xfade_none_inv_arr;
+    break;
+
+  case XFADE_LINEAR:
+    curves->xfade_func = xfade_linear;
+    curves->xfade_inv_func = xfade_linear_inv;
+    curves->xfade_arr_func = xfade_linear_arr;
+    curves->xfade_inv_arr_func = xfade_linear_inv_arr;
+    break;
+
+  case XFADE_SQRT:
+    curves->xfade_func = xfade_sqrt;
+    curves->xfade_inv_func = xfade_sqrt_inv;
+    curves->xfade_arr_func = xfade_sqrt_arr;
+    curves->xfade_inv_arr_func = xfade_sqrt_inv_arr;
+    break;
+
+  case XFADE_SINUSOIDAL:
+    curves->xfade_func = xfade_sinus;
+    curves->xfade_inv_func = xfade_sinus_inv;
+    curves->xfade_arr_func = xfade_sinus_arr;
+    curves->xfade_inv_arr_func = xfade_sinus_inv_arr;
+    break;
+
+  // The functions are placeholders: the compiled tables are always used
+  case XFADE_TABLE:
+    curves->xfade_func = xfade_linear;
+    curves->xfade_inv_func = xfade_linear_inv;
+    curves->xfade_arr_func = xfade_linear_arr;
+    curves->xfade_inv_arr_func = xfade_linear_inv_arr;
+    break;
+
+  default:
+    return false;
+  }
+
+  curves->xfade_type = type;
+  curves->xfade_param = param;
+
+  return true;
+}
+
+// ====  _CURVES_BUILD  ====
+
+//******************************************************************************
+//  Rebuild the tables of a set of curves from its functions, parameters and error bound.
+//  Breakpoint curves are not tabulated a second time.
+//
+void _curves_build(t_curves* curves) {
+
+  t_double ramp_err = (curves->ramp_type == RAMP_TABLE) ? 0 : curves->lut_err;
+  t_double xfade_err = (curves->xfade_type == XFADE_TABLE) ? 0 : curves->lut_err;
+
+  curve_lut_build(&curves->ramp_lut, curves->ramp_func, curves->ramp_param, ramp_err);
+  curve_lut_build(&curves->ramp_inv_lut, curves->ramp_inv_func, curves->ramp_param, ramp_err);
+  curve_lut_build(&curves->xfade_lut, curves->xfade_func, curves->xfade_param, xfade_err);
+  curve_lut_build(&curves->xfade_inv_lut, curves->xfade_inv_func, curves->xfade_param, xfade_err);
+}
+
+// ====  _CURVES_GET_LUT  ====
+
+//******************************************************************************
+//  Return the table to evaluate the ramping or crossfade function of a set of curves with,
+//  or NULL to evaluate the function exactly. Breakpoint curves always return their compiled table.
+//
+const t_curve_lut* _curves_get_lut(const t_curves* curves, t_interp_type type, t_bool is_inv) {
+
+  if (type == INTERP_TYPE_RAMP) {
+    if (curves->ramp_type == RAMP_TABLE) { return (is_inv ? &curves->ramp_inv_tab : &curves->ramp_tab); }
+    return curve_lut_get(is_inv ? &curves->ramp_inv_lut : &curves->ramp_lut);
+  }
+
+  if (curves->xfade_type == XFADE_TABLE) { return (is_inv ? &curves->xfade_inv_tab : &curves->xfade_tab); }
+  return curve_lut_get(is_inv ? &curves->xfade_inv_lut : &curves->xfade_lut);
+}
+
+// ========  CHANNEL METHODS  ========
+
+// ====  _CHANNEL_INIT  ====
+
+//******************************************************************************
+//  Initialize a channel. Call before _channel_alloc to set all array pointers to NULL.
+//
+void _channel_init(t_core* core, t_channel* channel) {
+
+  // Initialize the channel parameters
+  channel->cntd = INDEFINITE;
+  channel->velocity = 1.0;
+  channel->gain = 1.0;
+
+  _channel_set_interp(core, channel, INTERP_TYPE_XFADE);
+
+  channel->is_on = false;
+  channel->is_frozen = false;
+  channel->is_mute_ramp = false;
+  channel->is_end_pending = false;
+  channel->end_smp = 0;
+  channel->is_silent = false;
+  channel->silence_cnt = 0;
+
+  channel->gain_targ = channel->gain;
+  channel->gain_cntd = 0;
+
+  channel->gain_mast = core->master * channel->gain;
+  channel->gain_mast_prev = channel->gain_mast;
+  channel->is_gain_dirty = true;
+  channel->is_gain_moving = false;
+
+  channel->out_cnt = core->out_cnt;
+  channel->state_ind = -1;
+
+  channel->mode_type = MODE_TYPE_FIX;
+
+  // Set the array pointers to NULL
+  channel->U_cur = NULL;
+  channel->A_cur = NULL;
+  channel->U_targ = NULL;
+  channel->A_targ = NULL;
+  channel->route_arr = NULL;
+  channel->route_cnt = 0;
+  channel->gain_eff = NULL;
+}
+
+// ====  _CHANNEL_ALLOC  ====
+
+//******************************************************************************
+//  Point the arrays of a channel to its rows in the gain matrices of the core,
+//  and initialize the values. The padding at the end of the rows is set to 0.
+//  Call only after _channel_init, once core_alloc has allocated the matrices.
+//  Returns:
+//  ERR_NONE:  Succesful initialization
+//  ERR_NOT_YET_ALLOC:  The gain matrices are not allocated
+//
+t_my_err _channel_alloc(t_core* core, t_channel* channel, t_double u, t_double a) {
+
+  if (!core->block) { return ERR_NOT_YET_ALLOC; }
+
+  // The rows of the channel in the matrices
+  t_int32 row = (t_int32)(channel - core->channel_arr) * core->gain_stride;
+
+  channel->U_cur = core->U_cur_mat + row;
+  channel->A_cur = core->A_cur_mat + row;
+  channel->U_targ = core->U_targ_mat + row;
+  channel->A_targ = core->A_targ_mat + row;
+  channel->route_arr = core->route_mat + row;
+  channel->gain_eff = core->gain_eff_mat + row;
+
+  // Initialize the values in the arrays
+  for (t_int32 param = 0; param < core->gain_stride; param++) {
+    channel->U_cur[param] = (param < channel->out_cnt) ? u : 0;
+    channel->A_cur[param] = (param < channel->out_cnt) ? a : 0;
+    channel->U_targ[param] = (param < channel->out_cnt) ? u : 0;
+    channel->A_targ[param] = (param < channel->out_cnt) ? a : 0;
+    channel->gain_eff[param] = 0;
+  }
+
+  _channel_calc_routes(core, channel);
+  channel->is_gain_dirty = true;
+
+  return ERR_NONE;
+}
+
+// ====  _CHANNEL_FREE  ====
+
+//******************************************************************************
+//  Free a channel. The arrays belong to the gain matrices of the core,
+//  so only the pointers are reset.
+//
+void _channel_free(t_core* core, t_channel* channel) {
+
+  channel->U_cur = NULL;
+  channel->A_cur = NULL;
+  channel->U_targ = NULL;
+  channel->A_targ = NULL;
+  channel->route_arr = NULL;
+  channel->route_cnt = 0;
+  channel->gain_eff = NULL;
+}
+
+// ====  _CHANNEL_SET_INTERP  ====
+
+//******************************************************************************
+//  Set a channel to ramp with the ramping or crossfade function in use by the audio thread.
+//  The channel keeps its own copy, so that a ramp in progress is not affected by a change of function.
+//
+void _channel_set_interp(t_core* core, t_channel* channel, t_interp_type type) {
+
+  const t_curves* curves = core->curves_cur;
+
+  channel->interp_type = type;
+  channel->ramp_type = curves->ramp_type;
+  channel->xfade_type = curves->xfade_type;
+
+  if (type == INTERP_TYPE_RAMP) {
+    channel->interp_func = curves->ramp_func;
+    channel->interp_inv_func = curves->ramp_inv_func;
+    channel->interp_arr_func = curves->ramp_arr_func;
+    channel->interp_inv_arr_func = curves->ramp_inv_arr_func;
+    channel->interp_param = curves->ramp_param;
+    channel->interp_lut = _curves_get_lut(curves, type, false);
+    channel->interp_inv_lut = _curves_get_lut(curves, type, true);
+  }
+
+  else {
+    channel->interp_func = curves->xfade_func;
+    channel->interp_inv_func = curves->xfade_inv_func;
+    channel->interp_arr_func = curves->xfade_arr_func;
+    channel->interp_inv_arr_func = curves->xfade_inv_arr_func;
+    channel->interp_param = curves->xfade_param;
+    channel->interp_lut = _curves_get_lut(curves, type, false);
+    channel->interp_inv_lut = _curves_get_lut(curves, type, true);
+  }
+
+  // Exact exponential ramps are calculated at sample resolution, the tables would defeat the purpose
+  channel->is_exact = core->ramp_is_exact && (type == INTERP_TYPE_RAMP) && (curves->ramp_type == RAMP_EXP);
+  if (channel->is_exact) { channel->interp_lut = NULL; channel->interp_inv_lut = NULL; }
+}
+
+// ====  _CHANNEL_INTERP_ARR  ====
+
+//******************************************************************************
+//  Convert a vector of abscissa values to ordinate values, with the function of the channel.
+//
+void _channel_interp_arr(t_core* core, t_channel* channel, t_double* a_arr, const t_double* u_arr, t_int32 cnt) {
+
+  if (channel->interp_lut) { curve_lut_eval_arr(channel->interp_lut, a_arr, u_arr, cnt); }
+  else { channel->interp_arr_func(core->kernels, a_arr, u_arr, channel->interp_param, cnt); }
+}
+
+// ====  _CHANNEL_INTERP_INV_ARR  ====
+
+//******************************************************************************
+//  Convert a vector of ordinate values to abscissa values, with the function of the channel.
+//
+void _channel_interp_inv_arr(t_core* core, t_channel* channel, t_double* u_arr, const t_double* a_arr, t_int32 cnt) {
+
+  if (channel->interp_inv_lut) { curve_lut_eval_arr(channel->interp_inv_lut, u_arr, a_arr, cnt); }
+  else { channel->interp_inv_arr_func(core->kernels, u_arr, a_arr, channel->interp_param, cnt); }
+}
+
+// ====  _CHANNEL_CALC_ABSC  ====
+
+//******************************************************************************
+//  Recalculate the abscissa values for a channel.
+//
+void _channel_calc_absc(t_core* core, t_channel* channel) {
+
+  _channel_interp_inv_arr(core, channel, channel->U_cur, channel->A_cur, channel->out_cnt);
+  _channel_interp_inv_arr(core, channel, channel->U_targ, channel->A_targ, channel->out_cnt);
+}
+
+// ====  _CHANNEL_CALC_ROUTES  ====
+
+//******************************************************************************
+//  Rebuild the list of active routes of a channel: the outputs with a non zero gain.
+//  When ramping, a route is active if either its current or target gain is not 0,
+//  so that it stays in the list for the whole ramp.
+//  Call whenever A_cur or A_targ are changed.
+//
+void _channel_calc_routes(t_core* core, t_channel* channel) {
+
+  t_bool is_ramp = (channel->mode_type == MODE_TYPE_VAR);
+  t_int32 route_cnt = 0;
+
+  for (t_int32 out = 0; out < channel->out_cnt; out++) {
+    if ((channel->A_cur[out] != 0) || (is_ramp && (channel->A_targ[out] != 0))) {
+      channel->route_arr[route_cnt++] = out;
+    }
+  }
+
+  channel->route_cnt = route_cnt;
+}
+
+// ====  _CHANNEL_CALC_GAIN  ====
+
+//******************************************************************************
+//  Recalculate the row of effective gains of a channel, and clear its dirty flag.
+//
+void _channel_calc_gain(t_core* core, t_channel* channel) {
+
+  for (t_int32 out = 0; out < channel->out_cnt; out++) {
+    channel->gain_eff[out] = channel->gain_mast * core->out_gain[out] * channel->A_cur[out];
+  }
+
+  channel->is_gain_dirty = false;
+}
+
+// ========  STATE METHODS  ========
+
+// ====  _STATE_INIT  ====
+
+//******************************************************************************
+//  Initialize a state. Call before _state_alloc to set all array pointers to NULL.
+//
+void _state_init(t_state* state, t_symbol* name) {
+
+  // Initialize the name, the core only stores it
+  state->name = name;
+
+  // Initialize the array pointers to NULL
+  state->A_arr    = NULL;
+  state->U_rm_arr = NULL;
+  state->U_xf_arr = NULL;
+  state->U_cur    = NULL;
+
+  // Initialize the count to -1
+  state->cnt = -1;
+  state->index = -1;
+}
+
+// ====  _STATE_ALLOC  ====
+
+//******************************************************************************
+//  Allocate arrays for a state.
+//  Call only after _state_init to make sure the array pointers were set NULL.
+//  Returns:
+//  ERR_NONE:  Succesful initialization
+//  ERR_COUNT:  Invalid count argument, should be one at least
+//  ERR_ALLOC:  Failed allocation
+//
+t_my_err _state_alloc(t_state* state, t_int32 param_cnt, t_double u, t_double a) {
+
+  // The count should not be negative
+  if (param_cnt < 0) {
+    state->cnt = -1;
+    return ERR_COUNT;
+  }
+
+  // ... if it is equal to 0:
+  else if (param_cnt == 0) {
+    state->cnt = 0;
+    return ERR_NONE;
+  }
+
+  // ... if it is at least 1:
+  else {
+
+    // Allocate the arrays
+    state->A_arr = (t_double*)CORE_NEWPTR(sizeof(t_double) * param_cnt);
+    state->U_rm_arr = (t_double*)CORE_NEWPTR(sizeof(t_double) * param_cnt);
+    state->U_xf_arr = (t_double*)CORE_NEWPTR(sizeof(t_double) * param_cnt);
+    state->U_cur = state->U_xf_arr;
+
+    // Then test the allocation
+    if (state->A_arr && state->U_rm_arr && state->U_xf_arr) {
+
+      // Set the count
+      state->cnt = param_cnt;
+
+      // Initialize the array values
+      for (t_int32 res = 0; res < state->cnt; res++) {
+        state->A_arr[res] = a;
+        state->U_rm_arr[res] = u;
+        state->U_xf_arr[res] = u;
+      }
+
+      return ERR_NONE;
+    }
+
+    // Otherwise there was an allocation error
+    else {
+      state->cnt = -1;
+      if (state->A_arr) { CORE_FREEPTR(state->A_arr); state->A_arr = NULL; }
+      if (state->U_rm_arr) { CORE_FREEPTR(state->U_rm_arr); state->U_rm_arr = NULL; }
+      if (state->U_xf_arr) { CORE_FREEPTR(state->U_xf_arr); state->U_xf_arr = NULL; }
+      return ERR_ALLOC;
+    }
+  }
+}
+
+// ====  _STATE_FREE  ====
+
+//******************************************************************************
+//  Free one state
+//
+void _state_free(t_state* state) {
+
+  state->cnt = 0;
+
+  if (state->A_arr) {
+    CORE_FREEPTR(state->A_arr);
+    state->A_arr = NULL;
+  }
+
+  if (state->U_rm_arr) {
+    CORE_FREEPTR(state->U_rm_arr);
+    state->U_rm_arr = NULL;
+  }
+
+  if (state->U_xf_arr) {
+    CORE_FREEPTR(state->U_xf_arr);
+    state->U_xf_arr = NULL;
+  }
+}
+
+// ====  _STATE_LAYOUT  ====
+
+//******************************************************************************
+//  Carve the arrays of a state out of an arena, and initialize the values.
+//  With a NULL base it only adds up the size, and sets the pointers to NULL.
+//  The arrays belong to the block of the arena, so do not call _state_free on the state.
+//
+void _state_layout(t_state* state, t_arena* arena, t_int32 param_cnt, t_double u, t_double a) {
+
+  state->A_arr = (t_double*)arena_carve(arena, sizeof(t_double) * param_cnt);
+  state->U_rm_arr = (t_double*)arena_carve(arena, sizeof(t_double) * param_cnt);
+  state->U_xf_arr = (t_double*)arena_carve(arena, sizeof(t_double) * param_cnt);
+  state->U_cur = state->U_xf_arr;
+
+  if (!arena->base) { state->cnt = 0; return; }
+
+  state->cnt = param_cnt;
+  for (t_int32 res = 0; res < state->cnt; res++) {
+    state->A_arr[res] = a;
+    state->U_rm_arr[res] = u;
+    state->U_xf_arr[res] = u;
+  }
+}
+
+// ====  _STATE_CALC_ABSC  ====
+
+//******************************************************************************
+//  Calculate the abscissa values for the current ramping and crossfade functions
+//
+void _state_calc_absc(t_core* core, t_state * state) {
+
+  _core_interp_inv_arr(core, INTERP_TYPE_RAMP, state->U_rm_arr, state->A_arr, state->cnt);
+  _core_interp_inv_arr(core, INTERP_TYPE_XFADE, state->U_xf_arr, state->A_arr, state->cnt);
+}
+
+// ====  _STATE_RAMP  ====
+
+//******************************************************************************
+//  Ramp a channel to a state
+//  Used by the interface ramping methods
+//
+void _state_ramp(t_core* core, t_channel* channel, t_state* state, t_int32 cntd, t_int32 offset) {
+
+  // Set the countdown
+  channel->cntd = cntd;
+  channel->mode_type = MODE_TYPE_VAR;
+  channel->state_ind = state->index;
+
+  // Set all the target values to the state values
+  t_int32 ch2;
+
+  for (t_int32 ch1 = 0; ch1 < state->cnt; ch1++) {
+    ch2 = (ch1 + offset) % core->out_cnt;
+    channel->U_targ[ch2] = state->U_cur[ch1];
+    channel->A_targ[ch2] = state->A_arr[ch1];
+  }
+
+  _channel_calc_routes(core, channel);
+}
+
+// ====  _STATE_ITERATE  ====
+
+//******************************************************************************
+//  Iterate the channel when the countdown reaches 0
+//  t_int32 smp_offset:  The offset in the current vector of the sample at which the countdown reached 0
+//
+void _state_iterate(t_core* core, t_channel* channel, t_int32 smp_offset) {
+
+  // Queue a completion in case it is not muted, after the channel loop
+  if ((!channel->is_mute_ramp) && (core->end_is_on)) {
+    channel->is_end_pending = true;
+    channel->end_smp = smp_offset;
+  }
+
+  // Update
+  switch (channel->mode_type) {
+  case MODE_TYPE_VAR:
+
+    channel->cntd = INDEFINITE;
+    channel->mode_type = MODE_TYPE_FIX;
+
+    for (t_int32 ch = 0; ch < channel->out_cnt; ch++) {
+      channel->U_cur[ch] = channel->U_targ[ch];
+      channel->A_cur[ch] = channel->A_targ[ch];
+    }
+
+    _channel_calc_routes(core, channel);
+    channel->is_gain_dirty = true;
+    break;
+
+  default:
+    break;
+  }
+}
@@ -0,0 +1,446 @@
+#ifndef YC_DIFFUSE_CORE_H_
+#define YC_DIFFUSE_CORE_H_
+
+// ========  HEADER FILE FOR THE MIXING CORE  ========
+// The DSP and state logic of diffuse~, independent of the Max SDK.
+// Build with DIFFUSE_HEADLESS defined to use it outside of Max.
+
+// ========  INCLUDES  ========
+
+#include "core_types.h"
+#include "envelopes.h"
+#include "diffuse_kernels.h"
+#include "diffuse_workers.h"
+#include "core_atomic.h"
+
+// ========  DEFINES  ========
+
+#define INDEFINITE    -1    // Has to be negative to be intrinsically differentiated from valid countdown value
+
+#define MIX_L1_BUDGET  (16 * 1024)    // Bytes of L1 cache for the input tile of the blocked engine
+#define MIX_L2_BUDGET  (128 * 1024)   // Bytes of L2 cache for the output tile of the blocked engine
+#define MIX_DENSITY_MIN  0.25         // Default density of active routes below which the blocked engine is not used
+
+#define SILENCE_THRESH_DEF  0.0       // Default silence threshold: only digital silence, so skipping is lossless
+#define SILENCE_HOLD_DEF    0.0       // Default silence hold time in ms
+
+#define SMOOTH_TIME_DEF     0.0       // Default smoothing time in ms for master, gain_in and gain_out: immediate
+
+#define THREAD_ROUTES_MIN   4096      // Default number of routes below which the perform routine stays on one thread
+#define THREAD_TASKS_PER    4         // Number of tasks per thread in a job of the perform routine
+
+#define CMD_RING_SIZE  256    // Minimum number of commands the queue holds between two vectors: a power of 2
+#define CMD_ROW_CNT    32     // Minimum number of commands carrying gain rows the queue holds: a power of 2
+
+#define END_RING_SIZE  1024   // Number of ramp completions the ring holds until the owner reads them: a power of 2
+
+// ========  STRUCTURES  ========
+
+typedef struct _state     t_state;
+typedef struct _channel   t_channel;
+typedef struct _core      t_core;
+typedef struct _core_thread t_core_thread;
+typedef struct _cmd       t_cmd;
+
+// ========  STRUCTURE:  STATE  ========
+// Used to store a state
+
+typedef struct _state {
+
+  t_double* A_arr;      // Vector of abscissa values: 0 to 1
+  t_double* U_rm_arr;   // Vector of ordinate values using the ramping function: 0 to 1
+  t_double* U_xf_arr;   // Vector of ordinate values using the crossfade function: 0 to 1
+
+  t_double* U_cur;  // Pointer used to select between ramping and crossfading
+
+  t_int32 cnt;      // Number of output channels
+  t_int32 index;    // Index of the state, _state_init sets to -1, _state_arr_new sets to index
+
+  t_symbol* name;   // Name of the state
+
+} t_state;
+
+// ========  STRUCTURE:  CHANNEL  ========
+// Used to store an input channel
+
+typedef enum _mode_type {
+
+  MODE_TYPE_OFF,    // The channel is off: no processing in the perform function
+  MODE_TYPE_FIX,    // The channel is fixed: no ramping
+  MODE_TYPE_VAR,    // The channel is variable: amplitude ramping
+
+} t_mode_type;
+
+typedef enum _interp_type {
+
+  INTERP_TYPE_RAMP,     // Use the ramping function of the core
+  INTERP_TYPE_XFADE,    // Use the crossfade function of the core
+
+} t_interp_type;
+
+typedef struct _channel {
+
+  // Hot fields, read by the perform routine for each vector:
+  // kept together at the start of the structure, in the first cache line
+
+  t_double* A_cur;    // Row of N current ordinate values: 0 to 1
+  t_double* U_cur;    // Row of N current abscissa values: 0 to 1
+  t_double* U_targ;   // Row of N target abscissa values: 0 to 1
+  t_double* A_targ;   // Row of N target ordinate values: 0 to 1
+
+  t_double* gain_eff; // Row of N effective gains: master x input gain x output gain x A_cur
+  t_double  gain_mast;// Master gain x input gain
+  t_double  gain_mast_prev; // Master gain x input gain at the start of the vector, while smoothing
+
+  t_int32* route_arr; // Row of the indexes of the outputs with a non zero gain
+  t_int32  route_cnt; // Number of active routes in route_arr
+
+  t_double velocity;  // Velocity multiplier to affect the rate of change
+  t_double gain;      // Gain for the input channel
+  t_int32  cntd;      // Countdown in samples
+
+  t_mode_type mode_type;
+
+  t_bool is_on;         // Is the channel on or not
+  t_bool is_frozen;     // Is the channel frozen or not
+  t_bool is_silent;     // Is the input silent: skip the sample loops but keep ramping
+  t_bool is_gain_dirty; // Does gain_eff have to be recalculated
+  t_bool is_gain_moving;// Is gain_mast being smoothed over the current vector
+
+  t_int32 silence_cnt;  // Number of consecutive silent samples at the input
+
+  // Cold fields, used when a ramp is set or ends
+
+  t_bool is_mute_ramp;  // Send a message on ramp completion or not
+  t_bool is_end_pending;// The ramp ended in the current vector: queued after the channel loop
+  t_int32 end_smp;      // Offset in the current vector of the sample at which the ramp ended
+
+  t_double gain_targ; // Target of the input gain while smoothing
+  t_int32  gain_cntd; // Countdown in samples of the input gain smoothing
+
+  t_ramp   interp_func;
+  t_ramp   interp_inv_func;
+  t_ramp_arr interp_arr_func;       // Batch version of interp_func
+  t_ramp_arr interp_inv_arr_func;   // Batch version of interp_inv_func
+  t_interp_type interp_type;        // Ramping or crossfade function
+  t_ramp_type   ramp_type;          // Type of interp_func when ramping
+  t_xfade_type  xfade_type;         // Type of interp_func when crossfading
+  t_double interp_param;
+  const t_curve_lut* interp_lut;      // Table for interp_func, or NULL to evaluate it exactly
+  const t_curve_lut* interp_inv_lut;  // Table for interp_inv_func, or NULL to evaluate it exactly
+  t_bool   is_exact;  // Exponential ramp calculated at sample resolution, instead of a straight line per chunk
+
+  t_int32  out_cnt;   // Number of output channels
+  t_int32  state_ind; // Index of the state ramping to
+
+} t_channel;
+
+// ========  STRUCTURE:  CORE  ========
+
+//******************************************************************************
+//  Ramp completion, queued by the audio thread for the owner of the core.
+//
+typedef struct _end_event {
+
+  int64_t time;     // Sample at which the ramp ended, counted from the start of the audio
+  t_int32 channel;  // The index of the channel
+  t_int32 state;    // The index of the state that was ramped to
+
+} t_end_event;
+
+// ========  STRUCTURE:  CURVES  ========
+// The ramping and crossfade functions, with their tables
+
+typedef struct _curves {
+
+  t_ramp_type ramp_type;    // Ramping type, the parameter is validated for it by core_set_ramp
+  t_double ramp_param;      // Ramping parameter
+  t_ramp   ramp_func;       // Ramping function
+  t_ramp   ramp_inv_func;   // Inverse ramping function
+  t_ramp_arr ramp_arr_func;     // Batch ramping function
+  t_ramp_arr ramp_inv_arr_func; // Batch inverse ramping function
+
+  t_xfade_type xfade_type;  // Crossfade type
+  t_double xfade_param;     // Crossfade parameter
+  t_ramp   xfade_func;      // Crossfade function
+  t_ramp   xfade_inv_func;  // Inverse crossfade function
+  t_ramp_arr xfade_arr_func;     // Batch crossfade function
+  t_ramp_arr xfade_inv_arr_func; // Batch inverse crossfade function
+
+  // Curve tables: used instead of the functions above when within the error bound
+  t_double    lut_err;        // Error bound of the tables, 0 to evaluate the functions exactly
+  t_curve_lut ramp_lut;       // Table of the ramping function
+  t_curve_lut ramp_inv_lut;   // Table of the inverse ramping function
+  t_curve_lut xfade_lut;      // Table of the crossfade function
+  t_curve_lut xfade_inv_lut;  // Table of the inverse crossfade function
+
+  // Breakpoint curves: always evaluated with their compiled tables, whatever the error bound
+  t_curve_lut ramp_tab;       // Table of the ramping breakpoint curve
+  t_curve_lut ramp_inv_tab;   // Table of its inverse
+  t_curve_lut xfade_tab;      // Table of the crossfade breakpoint curve
+  t_curve_lut xfade_inv_tab;  // Table of its inverse
+
+} t_curves;
+
+// ========  STRUCTURE:  CORE THREAD  ========
+// What a thread of the perform routine writes to: the first one is the audio thread and uses
+// the arrays of the core, the others write to their own output buffers that are summed afterwards
+
+typedef struct _core_thread {
+
+  t_double** out_arr;         // Vector of the output signals written to by the thread
+  t_bool*    out_is_written;  // Vector of flags: has the output been written to in the current vector
+  t_double*  curve_u_arr;     // Scratch for the batch curve functions, gain_stride values each
+  t_double*  curve_a_arr;
+  t_double*  curve_r_arr;
+
+} t_core_thread;
+
+// ========  STRUCTURE:  COMMAND  ========
+// A change to the channels or gains, posted by the control thread with core_post_* and applied
+// by the audio thread at the start of the next vector, so that it is never seen half written
+
+typedef enum _cmd_type {
+
+  CMD_CHANNEL_SET,  // Set the gains of a channel:  index, row_a
+  CMD_RAMP,         // Ramp a channel:  index, val_i: interp type, val_j: countdown, val_k: state, row_u and row_a: targets
+  CMD_ON,           // Set channels on or off:  index, val_i
+  CMD_FREEZE,       // Freeze or unfreeze channels:  index, val_i
+  CMD_VELOCITY,     // Set the velocity of channels:  index, val_d
+  CMD_MUTE_RAMP,    // Mute the end of ramp messages of a channel:  index, val_i
+  CMD_GAIN_IN,      // Set the gain of an input:  index, val_d
+  CMD_GAIN_OUT,     // Set the gain of an output:  index, val_d
+  CMD_MASTER,       // Set the master gain:  val_d
+  CMD_SMOOTH,       // Set the smoothing time:  val_d
+  CMD_CONTROL_RATE, // Set the control rate:  val_i
+  CMD_EXACT,        // Use exact exponential ramps:  val_i
+  CMD_SILENCE,      // Set the silence detection:  val_i: on, val_d: threshold, val_e: hold time
+  CMD_CURVES,       // Switch to a set of curves:  val_i: index in curves_arr
+
+} t_cmd_type;
+
+typedef struct _cmd {
+
+  t_cmd_type type;
+  t_int32  index;     // Index of the channel or output, or -1 for all the channels
+  t_int32  val_i;
+  t_int32  val_j;
+  t_int32  val_k;
+  t_double val_d;
+  t_double val_e;
+  t_double* row_u;    // Rows of out_cnt values in the row ring, or NULL
+  t_double* row_a;
+
+} t_cmd;
+
+typedef struct _core {
+
+  t_channel* channel_arr;   // Array of input channels
+  t_int32    channel_cnt;   // Number of input channels
+
+  // Gain matrices: channel_cnt rows of gain_stride values, with 64-byte aligned rows
+  // The arrays of each channel point to its rows
+  t_int32   gain_stride;    // Number of values per row: out_cnt rounded up to a multiple of 8
+  t_double* U_cur_mat;      // Current abscissa values
+  t_double* A_cur_mat;      // Current ordinate values
+  t_double* U_targ_mat;     // Target abscissa values
+  t_double* A_targ_mat;     // Target ordinate values
+  t_double* gain_eff_mat;   // Effective gains, updated from dirty flags
+  t_int32*  route_mat;      // Active routes of each channel: channel_cnt x gain_stride
+  void*     block;          // Single allocation holding all the arrays of core_alloc, see _core_layout
+
+  t_double  master;         // Master gain
+  t_double  master_targ;    // Target of the master gain while smoothing
+  t_int32   master_cntd;    // Countdown in samples of the master gain smoothing
+  t_int32   out_cnt;        // Number of output channels
+  t_double* out_gain;       // Vector of gains for the output channels
+  t_bool*   out_is_dirty;   // Vector of flags: the output gain changed since the last vector
+  t_bool    gain_is_dirty;  // At least one output gain changed
+
+  // Gain smoothing: each gain moves linearly to its target over the smoothing time
+  t_double* out_gain_targ;  // Vector of targets of the output gains
+  t_double* out_gain_prev;  // Vector of output gains at the start of the vector
+  t_int32*  out_gain_cntd;  // Vector of countdowns in samples of the output gains
+  t_bool*   out_is_moving;  // Vector of flags: is the output gain moving over the current vector
+  t_int32   control_rate;   // Length in samples of the sub-blocks that ramps are split into, 0 for the vector
+  t_bool    ramp_is_exact;  // Exponential ramps at sample resolution, with a recurrence instead of a straight line
+  t_double  smooth_time;    // Smoothing time in ms
+  t_int32   smooth_smp;     // Smoothing time in samples
+  t_bool    is_smoothing;   // Is at least one gain still moving towards its target
+  t_bool    gain_is_moving; // Did at least one gain move over the current vector
+  t_bool*   out_is_written; // Vector of flags: has the output been written to in the current vector
+  t_int32   out_idle_cnt;   // Number of outputs that received no contribution in the last vector
+
+  // Curves: the control thread changes its own set, and publishes a copy of it in the set
+  // the audio thread is not reading, with CMD_CURVES, see core_curves_publish
+  t_curves  curves_arr[2];  // The two sets of curves published
+  t_curves  curves_edit[1]; // Set changed by the control thread, without the tables of the functions
+  t_curves* curves;         // Latest set published, read by the control thread
+  t_curves* curves_cur;     // Set in use, read by the audio thread, switched by CMD_CURVES
+  t_bool    curves_is_dirty; // The set changed by the control thread is not published yet
+  int32_t   curves_post;    // Number of sets published: written by the producer
+  volatile int32_t curves_read; // Number of sets applied: written by the consumer
+
+  // Abscissa and ordinate values of the active routes of a channel, for the batch curve functions
+  t_double* curve_u_arr;
+  t_double* curve_a_arr;
+  t_double* curve_r_arr;    // Ratio of the recurrence per sample, for the exact exponential ramps
+
+  t_double  samplerate;     // Stores the samplerate
+  t_double  msr;            // The samplerate in milliseconds
+
+  const t_kernels* kernels; // Sample loop kernels for the instruction set of the CPU
+
+  // Blocked engine, used when no channel is ramping
+  t_int32    out_pad;       // Number of outputs rounded up to a multiple of KERNELS_MIX_OUT
+  const t_double** mix_gain_arr; // Vector of the effective gain rows of the active inputs
+  t_double** mix_in_arr;    // Vector of the active input signals
+  t_int32    mix_in_cnt;    // Number of active inputs in the current vector
+  t_double** mix_out_arr;   // Vector of the output signals, padded with mix_scratch
+  t_double*  mix_scratch;   // Output signal for the padding outputs, discarded
+  t_int32    mix_vec_max;   // Maximum vector size that mix_scratch can hold
+  t_int32    mix_smp_tile;  // Number of samples in a tile
+  t_int32    mix_in_tile;   // Number of inputs in a tile
+  t_double   mix_density_min; // Density of active routes below which the sparse channel loop is used instead
+
+  // Silence detection
+  t_bool   silence_is_on;     // Skip the inputs that are silent
+  t_double silence_thresh;    // Absolute sample value at or below which a sample is silent
+  t_double silence_hold;      // Time in ms an input has to stay silent before being skipped
+  t_int32  silence_hold_smp;  // The hold time in samples
+
+  // Threads: for very large matrices the perform routine is split across a pool of helper threads
+  t_int32    thread_req;        // Number of threads requested, including the audio thread, applied by core_dsp
+  t_int32    thread_cnt;        // Number of threads running the perform routine, including the audio thread
+  t_int32    thread_routes_min; // Number of routes below which the perform routine stays on one thread
+  t_workers* workers;           // The pool of helper threads, or NULL to run on the audio thread only
+  t_core_thread* thread_arr;    // Vector of WORKERS_THREAD_MAX threads, the first one is the audio thread
+  void*      thread_block;      // Single allocation holding the outputs and scratch of the helper threads
+  t_double** perform_in_arr;    // Inputs of the current vector, for the tasks
+  t_int32    perform_frames;    // Size of the current vector, for the tasks
+  t_int32    perform_task_cnt;  // Number of tasks of the current job
+
+  // Command queue: one producer, the control thread, and one consumer, the audio thread
+  // The counters only increase, the rings are indexed by the counters modulo their sizes
+  // Both rings hold at least two batches over all the channels
+  t_int32   cmd_ring_size;    // Number of commands the queue holds: a power of 2
+  t_int32   cmd_row_cnt;      // Number of pairs of rows the queue holds: a power of 2
+  t_cmd*    cmd_arr;          // Ring of cmd_ring_size commands
+  t_double* cmd_row_arr;      // Ring of cmd_row_cnt pairs of rows of gain_stride values
+  int32_t   cmd_pend;         // Number of commands reserved by the producer, ahead of cmd_write during a batch
+  int32_t   row_pend;         // Number of pairs of rows reserved by the producer, ahead of row_write during a batch
+  t_bool    cmd_is_batch;     // Between core_post_begin and core_post_end: the commands are published together
+  volatile int32_t cmd_write; // Number of commands posted: written by the producer
+  volatile int32_t cmd_read;  // Number of commands applied: written by the consumer
+  volatile int32_t row_write; // Number of pairs of rows posted: written by the producer
+  volatile int32_t row_read;  // Number of pairs of rows applied: written by the consumer
+
+  // Ramp completions: one producer, the audio thread, and one consumer, the owner on its own thread
+  t_bool       end_is_on;     // Queue the ramp completions or not
+  int64_t      smp_time;      // Sample time of the start of the current vector
+  t_end_event* end_arr;       // Ring of END_RING_SIZE ramp completions
+  volatile int32_t end_write; // Number of completions queued: written by the producer
+  volatile int32_t end_read;  // Number of completions read: written by the consumer
+  volatile int32_t end_lost;  // Number of completions dropped because the ring was full
+
+} t_core;
+
+// ========  METHOD PROTOTYPES  ========
+
+// ========  CORE METHODS  ========
+
+void     core_init    (t_core* core, t_int32 channel_cnt, t_int32 out_cnt, t_double samplerate);
+t_my_err core_alloc   (t_core* core);
+void     core_free    (t_core* core);
+t_my_err core_dsp     (t_core* core, t_double samplerate, t_int32 maxvectorsize);
+void     core_perform (t_core* core, t_double** in_arr, t_double** out_arr, t_int32 sampleframes);
+
+t_bool   _core_is_static    (t_core* core);
+t_int32  _core_route_cnt    (t_core* core);
+void     core_set_silence   (t_core* core, t_bool is_on, t_double thresh, t_double hold);
+void     _core_detect_silence (t_core* core, t_double** in_arr, t_int32 sampleframes);
+
+void     core_set_master    (t_core* core, t_double master);
+void     core_set_gain_in   (t_core* core, t_channel* channel, t_double gain);
+void     core_set_gain_out  (t_core* core, t_int32 out, t_double gain);
+void     _core_update_gains (t_core* core);
+void     core_set_smooth    (t_core* core, t_double time);
+void     core_set_curves    (t_core* core, t_double lut_err);
+void     core_set_threads   (t_core* core, t_int32 thread_cnt);
+
+t_cmd*   _core_cmd_reserve  (t_core* core, t_cmd_type type, t_int32 index, t_bool is_row);
+void     _core_cmd_commit   (t_core* core, t_cmd* cmd);
+void     core_cmd_drain     (t_core* core);
+t_bool   core_cmd_is_empty  (t_core* core);
+void     _core_cmd_apply    (t_core* core, t_cmd* cmd);
+void     core_post_begin    (t_core* core);
+void     core_post_end      (t_core* core);
+void     core_post_cancel   (t_core* core);
+t_my_err core_post          (t_core* core, t_cmd_type type, t_int32 index, t_int32 val_i, t_double val_d, t_double val_e);
+t_my_err core_post_gains    (t_core* core, t_int32 index, const t_double* a_arr);
+t_my_err core_post_ramp     (t_core* core, t_int32 index, t_interp_type type, const t_state* state, t_int32 cntd, t_int32 offset);
+void     _core_end_push     (t_core* core);
+t_end_event* core_end_front (t_core* core);
+void     core_end_pop       (t_core* core);
+t_int32  core_end_lost      (t_core* core);
+t_my_err core_set_ramp      (t_core* core, t_ramp_type type, t_double param);
+t_my_err core_set_xfade     (t_core* core, t_xfade_type type, t_double param);
+t_my_err core_set_ramp_table  (t_core* core, const t_double* x_arr, const t_double* y_arr, t_int32 cnt, t_bool is_spline);
+t_my_err core_set_xfade_table (t_core* core, const t_double* x_arr, const t_double* y_arr, t_int32 cnt, t_bool is_spline);
+t_bool   core_curves_is_free (t_core* core);
+t_my_err core_curves_publish (t_core* core);
+void     _core_curves_apply  (t_core* core, t_curves* curves);
+void     _core_curve_routes (t_core* core, t_core_thread* thread, t_channel* channel, t_int32 chunk_len, t_int32 cntd_d_vel,
+  t_double ctrl_d_vel, t_bool is_ctrl_partial);
+void     _core_interp_arr     (t_core* core, t_interp_type type, t_double* a_arr, const t_double* u_arr, t_int32 cnt);
+void     _core_interp_inv_arr (t_core* core, t_interp_type type, t_double* u_arr, const t_double* a_arr, t_int32 cnt);
+void     _core_smooth_gains (t_core* core, t_int32 sampleframes);
+t_bool   _core_smooth_step  (t_double* value, t_double targ, t_int32* cntd, t_int32 len);
+void     _core_mix_tiles    (t_core* core, t_int32 maxvectorsize);
+void     _core_perform_mix  (t_core* core, t_double** in_arr, t_double** out_arr, t_int32 sampleframes);
+t_bool   _core_is_first_write (t_core_thread* thread, t_int32 out, t_int32 chunk_len, t_int32 sampleframes);
+void     _core_perform_channel (t_core* core, t_core_thread* thread, t_int32 in, t_double** in_arr, t_int32 sampleframes);
+void     _core_threads_free (t_core* core);
+void     _core_layout       (t_core* core, t_arena* arena);
+void     _core_mix_outs     (t_core* core, t_int32 out_beg, t_int32 out_end, t_int32 sampleframes);
+t_int32  _core_task_cnt     (t_core* core, t_int32 item_cnt);
+void     _core_task_mix     (void* arg, t_int32 task, t_int32 thread);
+void     _core_task_channel (void* arg, t_int32 task, t_int32 thread);
+void     _core_task_reduce  (void* arg, t_int32 task, t_int32 thread);
+
+// ========  CURVES METHODS  ========
+
+void     _curves_init      (t_curves* curves);
+void     _curves_copy      (t_curves* dst, const t_curves* src);
+t_bool   _curves_set_ramp  (t_curves* curves, t_ramp_type type, t_double param);
+t_bool   _curves_set_xfade (t_curves* curves, t_xfade_type type, t_double param);
+void     _curves_build     (t_curves* curves);
+const t_curve_lut* _curves_get_lut (const t_curves* curves, t_interp_type type, t_bool is_inv);
+
+// ========  CHANNEL METHODS  ========
+
+void       _channel_init  (t_core* core, t_channel* channel);
+t_my_err   _channel_alloc (t_core* core, t_channel* channel, t_double u, t_double a);
+void       _channel_free  (t_core* core, t_channel* channel);
+
+void       _channel_set_interp  (t_core* core, t_channel* channel, t_interp_type type);
+void       _channel_interp_arr     (t_core* core, t_channel* channel, t_double* a_arr, const t_double* u_arr, t_int32 cnt);
+void       _channel_interp_inv_arr (t_core* core, t_channel* channel, t_double* u_arr, const t_double* a_arr, t_int32 cnt);
+void       _channel_calc_absc   (t_core* core, t_channel* channel);
+void       _channel_calc_routes (t_core* core, t_channel* channel);
+void       _channel_calc_gain   (t_core* core, t_channel* channel);
+
+// ========  STATE METHODS  ========
+
+void     _state_init  (t_state* state, t_symbol* name);
+t_my_err _state_alloc (t_state* state, t_int32 param_cnt, t_double u, t_double a);
+void     _state_free  (t_state* state);
+void     _state_layout (t_state* state, t_arena* arena, t_int32 param_cnt, t_double u, t_double a);
+
+void     _state_calc_absc (t_core* core, t_state * state);
+void     _state_ramp      (t_core* core, t_channel* channel, t_state* state, t_int32 cntd, t_int32 offset);
+void     _state_iterate   (t_core* core, t_channel* channel, t_int32 smp_offset);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
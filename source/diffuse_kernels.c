@@ -0,0 +1,284 @@
+#include "diffuse_kernels.h"
+
+#if defined(KERNELS_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+// ========  KERNEL TABLES  ========
+
+static const t_kernels kernels_scalar = { SIMD_SCALAR, "scalar", kernel_fix_scalar, kernel_var_scalar, kernel_geo_scalar, kernel_mix_scalar,
+  kernel_exp_scalar, kernel_log_scalar, kernel_sin_scalar, kernel_asin_scalar };
+
+#ifdef KERNELS_X86
+static const t_kernels kernels_sse2   = { SIMD_SSE2,   "sse2",   kernel_fix_sse2,   kernel_var_sse2,   kernel_geo_sse2,   kernel_mix_sse2,
+  kernel_exp_sse2, kernel_log_sse2, kernel_sin_sse2, kernel_asin_sse2 };
+static const t_kernels kernels_avx2   = { SIMD_AVX2,   "avx2",   kernel_fix_avx2,   kernel_var_avx2,   kernel_geo_avx2,   kernel_mix_avx2,
+  kernel_exp_avx2, kernel_log_avx2, kernel_sin_avx2, kernel_asin_avx2 };
+#endif
+
+#ifdef KERNELS_AVX512
+static const t_kernels kernels_avx512 = { SIMD_AVX512, "avx512", kernel_fix_avx512, kernel_var_avx512, kernel_geo_avx512, kernel_mix_avx512,
+  kernel_exp_avx512, kernel_log_avx512, kernel_sin_avx512, kernel_asin_avx512 };
+#endif
+
+// ========  POLYNOMIAL COEFFICIENTS  ========
+// Shared by the math kernels of all instruction sets, lowest degree first
+
+const t_double kernels_exp_coef[KERNELS_EXP_CNT] = {
+  1.0, 1.0, 0.5, 0.16666666666666666, 0.041666666666666664, 0.008333333333333333,
+  0.001388888888888889, 0.0001984126984126984, 2.48015873015873e-05, 2.7557319223985893e-06,
+  2.755731922398589e-07, 2.505210838544172e-08, 2.08767569878681e-09, 1.6059043836821613e-10 };
+
+const t_double kernels_log_coef[KERNELS_LOG_CNT] = {
+  2.0, 0.6666666666666666, 0.4, 0.2857142857142857, 0.2222222222222222,
+  0.18181818181818182, 0.15384615384615385, 0.13333333333333333, 0.11764705882352941, 0.10526315789473684 };
+
+const t_double kernels_sin_coef[KERNELS_SIN_CNT] = {
+  1.0, -0.16666666666666666, 0.008333333333333333, -0.0001984126984126984, 2.7557319223985893e-06,
+  -2.505210838544172e-08, 1.6059043836821613e-10, -7.647163731819816e-13, 2.8114572543455206e-15,
+  -8.22063524662433e-18, 1.9572941063391263e-20 };
+
+const t_double kernels_asin_coef[KERNELS_ASIN_CNT] = {
+  1.0, 0.16666666666666666, 0.075, 0.044642857142857144, 0.030381944444444444,
+  0.022372159090909092, 0.017352764423076924, 0.01396484375, 0.011551800896139705, 0.009761609529194078,
+  0.008390335809616815, 0.0073125258735988454, 0.006447210311889649, 0.005740037670841924, 0.005153309682319905,
+  0.004660143486915096, 0.004240907093679363, 0.003880964558837669, 0.0035692053938259347, 0.003297059503473485,
+  0.0030578216492580306 };
+
+// ====  KERNELS_DETECT  ====
+
+//******************************************************************************
+//  Detect the best instruction set supported by the CPU and the OS.
+//
+t_simd_type kernels_detect(void) {
+
+#if defined(KERNELS_X86) && defined(_MSC_VER)
+
+  int info[4];
+  __cpuid(info, 0);
+  int id_max = info[0];
+
+  __cpuid(info, 1);
+  t_bool has_sse2 = (info[3] & (1 << 26)) != 0;
+  t_bool has_fma = (info[2] & (1 << 12)) != 0;
+  t_bool has_osxsave = (info[2] & (1 << 27)) != 0;
+
+  // The OS has to save the YMM and ZMM registers
+  unsigned long long xcr0 = has_osxsave ? _xgetbv(0) : 0;
+  t_bool os_avx = (xcr0 & 0x06) == 0x06;
+  t_bool os_avx512 = (xcr0 & 0xE6) == 0xE6;
+
+  t_bool has_avx2 = false;
+  t_bool has_avx512 = false;
+  if (id_max >= 7) {
+    __cpuidex(info, 7, 0);
+    has_avx2 = (info[1] & (1 << 5)) != 0;
+    has_avx512 = (info[1] & (1 << 16)) != 0;
+  }
+
+  if (has_avx512 && os_avx512) { return SIMD_AVX512; }
+  if (has_avx2 && has_fma && os_avx) { return SIMD_AVX2; }
+  if (has_sse2) { return SIMD_SSE2; }
+  return SIMD_SCALAR;
+
+#elif defined(KERNELS_X86)
+
+  // The GCC and Clang builtins also check that the OS saves the registers
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) { return SIMD_AVX512; }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) { return SIMD_AVX2; }
+  if (__builtin_cpu_supports("sse2")) { return SIMD_SSE2; }
+  return SIMD_SCALAR;
+
+#else
+
+  return SIMD_SCALAR;
+
+#endif
+}
+
+// ====  KERNELS_SELECT  ====
+
+//******************************************************************************
+//  Select the kernels for an instruction set.
+//  Falls back to the best instruction set supported if the one requested is not.
+//  Returns a pointer to a static table of kernels.
+//
+const t_kernels* kernels_select(t_simd_type simd_type) {
+
+  t_simd_type simd_max = kernels_detect();
+  if ((simd_type == SIMD_AUTO) || (simd_type > simd_max)) { simd_type = simd_max; }
+
+#ifndef KERNELS_AVX512
+  if (simd_type == SIMD_AVX512) { simd_type = SIMD_AVX2; }
+#endif
+
+  switch (simd_type) {
+
+#ifdef KERNELS_AVX512
+  case SIMD_AVX512: return &kernels_avx512;
+#endif
+
+#ifdef KERNELS_X86
+  case SIMD_AVX2:   return &kernels_avx2;
+  case SIMD_SSE2:   return &kernels_sse2;
+#endif
+
+  default:          return &kernels_scalar;
+  }
+}
+
+// ========  SCALAR KERNELS  ========
+
+// ====  KERNEL_FIX_SCALAR  ====
+
+void kernel_fix_scalar(t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first) {
+
+  if (is_first) {
+    for (t_int32 smp = 0; smp < len; smp++) { sig_out[smp] = sig_in[smp] * gain; }
+    return;
+  }
+
+  for (t_int32 smp = 0; smp < len; smp++) {
+    sig_out[smp] += sig_in[smp] * gain;
+  }
+}
+
+// ====  KERNEL_VAR_SCALAR  ====
+
+void kernel_var_scalar(t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first) {
+
+  if (is_first) {
+    for (t_int32 smp = 0; smp < len; smp++) { sig_out[smp] = sig_in[smp] * (gain + smp * d_gain); }
+    return;
+  }
+
+  for (t_int32 smp = 0; smp < len; smp++) {
+    sig_out[smp] += sig_in[smp] * (gain + smp * d_gain);
+  }
+}
+
+// ====  KERNEL_GEO_SCALAR  ====
+
+void kernel_geo_scalar(t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset,
+    t_int32 len, t_bool is_first) {
+
+  for (t_int32 smp = 0; smp < len; smp++) {
+    sig_out[smp] = (is_first ? 0 : sig_out[smp]) + sig_in[smp] * gain;
+    gain = gain * ratio + offset;
+  }
+}
+
+// ====  KERNEL_MIX_SCALAR  ====
+
+void kernel_mix_scalar(t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+    t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first) {
+
+  for (t_int32 s = smp; s < smp + len; s++) {
+
+    t_double acc0 = is_first ? 0 : sig_out[0][s];
+    t_double acc1 = is_first ? 0 : sig_out[1][s];
+    t_double acc2 = is_first ? 0 : sig_out[2][s];
+    t_double acc3 = is_first ? 0 : sig_out[3][s];
+
+    for (t_int32 in = 0; in < in_cnt; in++) {
+      const t_double* g = gain_arr[in] + gain_ofs;
+      t_double x = sig_in[in][s];
+      acc0 += x * g[0];
+      acc1 += x * g[1];
+      acc2 += x * g[2];
+      acc3 += x * g[3];
+    }
+
+    sig_out[0][s] = acc0;
+    sig_out[1][s] = acc1;
+    sig_out[2][s] = acc2;
+    sig_out[3][s] = acc3;
+  }
+}
+
+// ====  KERNEL_EXP_SCALAR  ====
+// exp(x) = 2^n * exp(r), with n the nearest integer to x / ln(2) and |r| <= ln(2) / 2
+
+void kernel_exp_scalar(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) {
+
+    t_double x = MIN(MAX(x_arr[i], KERNELS_EXP_MIN), KERNELS_EXP_MAX);
+    t_double n = floor(x * KERNELS_LOG2E + 0.5);
+    t_double r = (x - n * KERNELS_LN2_HI) - n * KERNELS_LN2_LO;
+
+    t_double p = kernels_exp_coef[KERNELS_EXP_CNT - 1];
+    for (t_int32 k = KERNELS_EXP_CNT - 2; k >= 0; k--) { p = p * r + kernels_exp_coef[k]; }
+
+    // Build 2^n from its exponent bits
+    union { t_double d; uint64_t u; } scale;
+    scale.u = (uint64_t)((int64_t)n + 1023) << 52;
+
+    y_arr[i] = (x_arr[i] < KERNELS_EXP_MIN) ? 0 : p * scale.d;
+  }
+}
+
+// ====  KERNEL_LOG_SCALAR  ====
+// log(x) = e * ln(2) + log(m), with m in [sqrt(2) / 2, sqrt(2)],
+// and log(m) = log((1 + s) / (1 - s)) with s = (m - 1) / (m + 1)
+
+void kernel_log_scalar(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) {
+
+    // Split the exponent and the mantissa
+    union { t_double d; uint64_t u; } bits;
+    bits.d = x_arr[i];
+    t_double e = (t_double)((int64_t)(bits.u >> 52) - 1023);
+    bits.u = (bits.u & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL;
+    t_double m = bits.d;
+    if (m > KERNELS_SQRT2) { m *= 0.5; e += 1; }
+
+    t_double s = (m - 1) / (m + 1);
+    t_double z = s * s;
+
+    t_double p = kernels_log_coef[KERNELS_LOG_CNT - 1];
+    for (t_int32 k = KERNELS_LOG_CNT - 2; k >= 0; k--) { p = p * z + kernels_log_coef[k]; }
+
+    y_arr[i] = e * KERNELS_LN2_HI + (s * p + e * KERNELS_LN2_LO);
+  }
+}
+
+// ====  KERNEL_SIN_SCALAR  ====
+
+void kernel_sin_scalar(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) {
+
+    t_double x = x_arr[i];
+    t_double z = x * x;
+
+    t_double p = kernels_sin_coef[KERNELS_SIN_CNT - 1];
+    for (t_int32 k = KERNELS_SIN_CNT - 2; k >= 0; k--) { p = p * z + kernels_sin_coef[k]; }
+
+    y_arr[i] = x * p;
+  }
+}
+
+// ====  KERNEL_ASIN_SCALAR  ====
+// Above 0.5:  asin(x) = PI / 2 - 2 * asin(sqrt((1 - x) / 2))
+
+void kernel_asin_scalar(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) {
+
+    t_double x = fabs(x_arr[i]);
+    t_bool is_big = (x > 0.5);
+    if (is_big) { x = sqrt((1 - x) * 0.5); }
+    t_double z = x * x;
+
+    t_double p = kernels_asin_coef[KERNELS_ASIN_CNT - 1];
+    for (t_int32 k = KERNELS_ASIN_CNT - 2; k >= 0; k--) { p = p * z + kernels_asin_coef[k]; }
+
+    p *= x;
+    if (is_big) { p = PI / 2 - 2 * p; }
+    y_arr[i] = (x_arr[i] < 0) ? -p : p;
+  }
+}
@@ -0,0 +1,188 @@
+#ifndef YC_DIFFUSE_KERNELS_H_
+#define YC_DIFFUSE_KERNELS_H_
+
+// ========  HEADER FILE FOR THE SAMPLE LOOP KERNELS  ========
+// The inner sample loops of the perform routine, with one version per instruction set.
+// The best version supported by the CPU is selected at runtime.
+
+// ========  INCLUDES  ========
+
+#include "core_types.h"
+
+// ========  DEFINES  ========
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KERNELS_X86
+#endif
+
+#define KERNELS_MIX_OUT 4    // Number of outputs processed together by the mix kernels
+
+// Polynomial approximations of the math kernels
+#define KERNELS_EXP_MIN   -708.0                  // Below this exp flushes to 0
+#define KERNELS_EXP_MAX    709.0                  // Above this exp is clipped
+#define KERNELS_LN2_HI     6.93147180369123816490e-01   // ln(2) split in two for the range reduction
+#define KERNELS_LN2_LO     1.90821492927058770002e-10
+#define KERNELS_LOG2E      1.44269504088896340736  // 1 / ln(2)
+#define KERNELS_SQRT2      1.41421356237309504880
+
+#define KERNELS_EXP_CNT   14    // Taylor series of exp(r) for |r| <= ln(2) / 2
+#define KERNELS_LOG_CNT   10    // Series of log((1 + s) / (1 - s)) / s in s^2 for |s| <= 0.172
+#define KERNELS_SIN_CNT   11    // Taylor series of sin(x) / x in x^2 for |x| <= PI / 2
+#define KERNELS_ASIN_CNT  21    // Taylor series of asin(x) / x in x^2 for |x| <= 0.5
+
+// AVX-512 intrinsics are not available before Visual Studio 2017
+#if defined(KERNELS_X86) && !(defined(_MSC_VER) && (_MSC_VER < 1910))
+#define KERNELS_AVX512
+#endif
+
+// ========  TYPEDEF  ========
+
+//******************************************************************************
+//  Kernel to add a signal with a constant gain:  sig_out[i] += sig_in[i] * gain
+//  t_double* sig_out:  The output vector to accumulate into
+//  t_double* sig_in:  The input vector
+//  t_double gain:  The gain, constant over the vector
+//  t_int32 len:  The number of samples
+//  t_bool is_first:  Store into the output instead of accumulating
+//
+typedef void (*t_kernel_fix)(t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first);
+
+//******************************************************************************
+//  Kernel to add a signal with a linear gain ramp:  sig_out[i] += sig_in[i] * (gain + i * d_gain)
+//  The gain of each sample is calculated from its index, there is no dependency between samples.
+//  t_double* sig_out:  The output vector to accumulate into
+//  t_double* sig_in:  The input vector
+//  t_double gain:  The gain for the first sample
+//  t_double d_gain:  The increment of the gain per sample
+//  t_int32 len:  The number of samples
+//  t_bool is_first:  Store into the output instead of accumulating
+//
+typedef void (*t_kernel_var)(t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first);
+
+//******************************************************************************
+//  Kernel to add a signal with a gain following a first order recurrence:  sig_out[i] += sig_in[i] * g[i]
+//  with g[0] = gain and g[i + 1] = ratio * g[i] + offset, one multiply-add per sample.
+//  The vector versions step each lane over the width of the register, with the recurrence raised to that power.
+//  t_double* sig_out:  The output vector to accumulate into
+//  t_double* sig_in:  The input vector
+//  t_double gain:  The gain for the first sample
+//  t_double ratio:  The multiplier of the recurrence
+//  t_double offset:  The offset of the recurrence
+//  t_int32 len:  The number of samples
+//  t_bool is_first:  Store into the output instead of accumulating
+//
+typedef void (*t_kernel_geo)(t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset,
+  t_int32 len, t_bool is_first);
+
+//******************************************************************************
+//  Kernel to mix a block of inputs into a block of KERNELS_MIX_OUT outputs.
+//  The output samples are accumulated in registers over all the inputs of the block.
+//  t_double** sig_out:  KERNELS_MIX_OUT output vectors
+//  t_double** sig_in:  in_cnt input vectors
+//  t_double** gain_arr:  in_cnt rows of gains, one per input, indexed by output
+//  t_int32 gain_ofs:  The index of the first output of the block in the rows
+//  t_int32 in_cnt:  The number of inputs in the block
+//  t_int32 smp:  The index of the first sample to process
+//  t_int32 len:  The number of samples
+//  t_bool is_first:  Store into the outputs instead of accumulating
+//
+typedef void (*t_kernel_mix)(t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+  t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first);
+
+//******************************************************************************
+//  Kernel to evaluate an elementary function over a vector:  y_arr[i] = f(x_arr[i])
+//  Polynomial approximations after range reduction, to within a few ulp over their domain:
+//    exp:   Any x, flushed to 0 below KERNELS_EXP_MIN and clipped at KERNELS_EXP_MAX
+//    log:   x positive and normal
+//    sin:   x in [-PI/2, PI/2]
+//    asin:  x in [-1, 1]
+//  t_double* y_arr:  The output vector, can be the same as x_arr
+//  t_double* x_arr:  The input vector
+//  t_int32 cnt:  The number of values
+//
+typedef void (*t_kernel_math)(t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+
+typedef enum _simd_type {
+
+  SIMD_SCALAR,
+  SIMD_SSE2,
+  SIMD_AVX2,      // AVX2 and FMA
+  SIMD_AVX512,    // AVX-512 F
+  SIMD_AUTO,      // The best type supported by the CPU
+  SIMD_LAST
+
+} t_simd_type;
+
+typedef struct _kernels {
+
+  t_simd_type  simd_type;
+  const char*  name;
+
+  t_kernel_fix fix;
+  t_kernel_var var;
+  t_kernel_geo geo;
+  t_kernel_mix mix;
+
+  t_kernel_math exp;
+  t_kernel_math log;
+  t_kernel_math sin;
+  t_kernel_math asin;
+
+} t_kernels;
+
+// ========  FUNCTION DECLARATIONS  ========
+
+extern const t_double kernels_exp_coef[KERNELS_EXP_CNT];
+extern const t_double kernels_log_coef[KERNELS_LOG_CNT];
+extern const t_double kernels_sin_coef[KERNELS_SIN_CNT];
+extern const t_double kernels_asin_coef[KERNELS_ASIN_CNT];
+
+t_simd_type      kernels_detect (void);
+const t_kernels* kernels_select (t_simd_type simd_type);
+
+void kernel_fix_scalar (t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first);
+void kernel_var_scalar (t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first);
+void kernel_geo_scalar (t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset, t_int32 len, t_bool is_first);
+void kernel_mix_scalar (t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+  t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first);
+void kernel_exp_scalar  (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_log_scalar  (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_sin_scalar  (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_asin_scalar (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+
+#ifdef KERNELS_X86
+void kernel_fix_sse2   (t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first);
+void kernel_fix_avx2   (t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first);
+void kernel_var_sse2   (t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first);
+void kernel_var_avx2   (t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first);
+void kernel_geo_sse2   (t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset, t_int32 len, t_bool is_first);
+void kernel_geo_avx2   (t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset, t_int32 len, t_bool is_first);
+void kernel_mix_sse2   (t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+  t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first);
+void kernel_mix_avx2   (t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+  t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first);
+void kernel_exp_sse2   (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_exp_avx2   (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_log_sse2   (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_log_avx2   (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_sin_sse2   (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_sin_avx2   (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_asin_sse2  (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_asin_avx2  (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+#endif
+
+#ifdef KERNELS_AVX512
+void kernel_fix_avx512 (t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first);
+void kernel_var_avx512 (t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first);
+void kernel_geo_avx512 (t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset, t_int32 len, t_bool is_first);
+void kernel_mix_avx512 (t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+  t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first);
+void kernel_exp_avx512 (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_log_avx512 (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_sin_avx512 (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+void kernel_asin_avx512 (t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+#endif
+
+// ========  END OF HEADER FILE  ========
+
+#endif
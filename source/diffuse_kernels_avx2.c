@@ -0,0 +1,248 @@
+#include "diffuse_kernels.h"
+
+// Kernels using AVX2 and FMA: 4 doubles per register
+// Compile with -mavx2 -mfma on GCC and Clang
+
+#ifdef KERNELS_X86
+
+#include <immintrin.h>
+
+// ====  KERNEL_FIX_AVX2  ====
+
+void kernel_fix_avx2(t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first) {
+
+  __m256d g = _mm256_set1_pd(gain);
+  t_int32 smp = 0;
+
+  // Two registers per iteration to hide the latency of the multiply-adds
+  for (; smp + 8 <= len; smp += 8) {
+    __m256d out0 = is_first ? _mm256_setzero_pd() : _mm256_loadu_pd(sig_out + smp);
+    __m256d out1 = is_first ? _mm256_setzero_pd() : _mm256_loadu_pd(sig_out + smp + 4);
+    out0 = _mm256_fmadd_pd(_mm256_loadu_pd(sig_in + smp), g, out0);
+    out1 = _mm256_fmadd_pd(_mm256_loadu_pd(sig_in + smp + 4), g, out1);
+    _mm256_storeu_pd(sig_out + smp, out0);
+    _mm256_storeu_pd(sig_out + smp + 4, out1);
+  }
+
+  for (; smp + 4 <= len; smp += 4) {
+    __m256d out0 = is_first ? _mm256_setzero_pd() : _mm256_loadu_pd(sig_out + smp);
+    out0 = _mm256_fmadd_pd(_mm256_loadu_pd(sig_in + smp), g, out0);
+    _mm256_storeu_pd(sig_out + smp, out0);
+  }
+
+  for (; smp < len; smp++) { sig_out[smp] = (is_first ? 0 : sig_out[smp]) + sig_in[smp] * gain; }
+}
+
+// ====  KERNEL_VAR_AVX2  ====
+
+void kernel_var_avx2(t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first) {
+
+  __m256d g0 = _mm256_set1_pd(gain);
+  __m256d dg = _mm256_set1_pd(d_gain);
+  __m256d ind0 = _mm256_set_pd(3, 2, 1, 0);   // Sample index of each lane
+  __m256d ind1 = _mm256_set_pd(7, 6, 5, 4);
+  __m256d step = _mm256_set1_pd(8);
+  t_int32 smp = 0;
+
+  for (; smp + 8 <= len; smp += 8) {
+    __m256d out0 = is_first ? _mm256_setzero_pd() : _mm256_loadu_pd(sig_out + smp);
+    __m256d out1 = is_first ? _mm256_setzero_pd() : _mm256_loadu_pd(sig_out + smp + 4);
+    out0 = _mm256_fmadd_pd(_mm256_loadu_pd(sig_in + smp), _mm256_fmadd_pd(ind0, dg, g0), out0);
+    out1 = _mm256_fmadd_pd(_mm256_loadu_pd(sig_in + smp + 4), _mm256_fmadd_pd(ind1, dg, g0), out1);
+    _mm256_storeu_pd(sig_out + smp, out0);
+    _mm256_storeu_pd(sig_out + smp + 4, out1);
+    ind0 = _mm256_add_pd(ind0, step);
+    ind1 = _mm256_add_pd(ind1, step);
+  }
+
+  for (; smp < len; smp++) { sig_out[smp] = (is_first ? 0 : sig_out[smp]) + sig_in[smp] * (gain + smp * d_gain); }
+}
+
+// ====  KERNEL_GEO_AVX2  ====
+
+void kernel_geo_avx2(t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset,
+    t_int32 len, t_bool is_first) {
+
+  // The first 8 gains, and the recurrence over 8 samples: g[i + 8] = r8 * g[i] + o8
+  t_double lane[8];
+  t_double r8 = 1;
+  t_double o8 = 0;
+  for (t_int32 i = 0; i < 8; i++) { lane[i] = gain; gain = gain * ratio + offset; r8 *= ratio; o8 = o8 * ratio + offset; }
+
+  __m256d g0 = _mm256_loadu_pd(lane);
+  __m256d g1 = _mm256_loadu_pd(lane + 4);
+  __m256d r = _mm256_set1_pd(r8);
+  __m256d o = _mm256_set1_pd(o8);
+  t_int32 smp = 0;
+
+  for (; smp + 8 <= len; smp += 8) {
+    __m256d out0 = is_first ? _mm256_setzero_pd() : _mm256_loadu_pd(sig_out + smp);
+    __m256d out1 = is_first ? _mm256_setzero_pd() : _mm256_loadu_pd(sig_out + smp + 4);
+    out0 = _mm256_fmadd_pd(_mm256_loadu_pd(sig_in + smp), g0, out0);
+    out1 = _mm256_fmadd_pd(_mm256_loadu_pd(sig_in + smp + 4), g1, out1);
+    _mm256_storeu_pd(sig_out + smp, out0);
+    _mm256_storeu_pd(sig_out + smp + 4, out1);
+    g0 = _mm256_fmadd_pd(g0, r, o);
+    g1 = _mm256_fmadd_pd(g1, r, o);
+  }
+
+  if (smp < len) {
+    kernel_geo_scalar(sig_out + smp, sig_in + smp, _mm_cvtsd_f64(_mm256_castpd256_pd128(g0)), ratio, offset, len - smp, is_first);
+  }
+}
+
+// ====  KERNEL_MIX_AVX2  ====
+
+void kernel_mix_avx2(t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+    t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first) {
+
+  t_int32 s = smp;
+
+  // 4 outputs x 8 samples in 8 accumulators
+  for (; s + 8 <= smp + len; s += 8) {
+
+    __m256d acc00, acc01, acc10, acc11, acc20, acc21, acc30, acc31;
+
+    if (is_first) {
+      acc00 = acc01 = acc10 = acc11 = acc20 = acc21 = acc30 = acc31 = _mm256_setzero_pd();
+    }
+    else {
+      acc00 = _mm256_loadu_pd(sig_out[0] + s);  acc01 = _mm256_loadu_pd(sig_out[0] + s + 4);
+      acc10 = _mm256_loadu_pd(sig_out[1] + s);  acc11 = _mm256_loadu_pd(sig_out[1] + s + 4);
+      acc20 = _mm256_loadu_pd(sig_out[2] + s);  acc21 = _mm256_loadu_pd(sig_out[2] + s + 4);
+      acc30 = _mm256_loadu_pd(sig_out[3] + s);  acc31 = _mm256_loadu_pd(sig_out[3] + s + 4);
+    }
+
+
+    for (t_int32 in = 0; in < in_cnt; in++) {
+      const t_double* g = gain_arr[in] + gain_ofs;
+      __m256d x0 = _mm256_loadu_pd(sig_in[in] + s);
+      __m256d x1 = _mm256_loadu_pd(sig_in[in] + s + 4);
+      __m256d g0 = _mm256_broadcast_sd(g);
+      __m256d g1 = _mm256_broadcast_sd(g + 1);
+      __m256d g2 = _mm256_broadcast_sd(g + 2);
+      __m256d g3 = _mm256_broadcast_sd(g + 3);
+      acc00 = _mm256_fmadd_pd(x0, g0, acc00);  acc01 = _mm256_fmadd_pd(x1, g0, acc01);
+      acc10 = _mm256_fmadd_pd(x0, g1, acc10);  acc11 = _mm256_fmadd_pd(x1, g1, acc11);
+      acc20 = _mm256_fmadd_pd(x0, g2, acc20);  acc21 = _mm256_fmadd_pd(x1, g2, acc21);
+      acc30 = _mm256_fmadd_pd(x0, g3, acc30);  acc31 = _mm256_fmadd_pd(x1, g3, acc31);
+    }
+
+    _mm256_storeu_pd(sig_out[0] + s, acc00);  _mm256_storeu_pd(sig_out[0] + s + 4, acc01);
+    _mm256_storeu_pd(sig_out[1] + s, acc10);  _mm256_storeu_pd(sig_out[1] + s + 4, acc11);
+    _mm256_storeu_pd(sig_out[2] + s, acc20);  _mm256_storeu_pd(sig_out[2] + s + 4, acc21);
+    _mm256_storeu_pd(sig_out[3] + s, acc30);  _mm256_storeu_pd(sig_out[3] + s + 4, acc31);
+  }
+
+  if (s < smp + len) { kernel_mix_scalar(sig_out, sig_in, gain_arr, gain_ofs, in_cnt, s, smp + len - s, is_first); }
+}
+
+// ========  MATH KERNELS  ========
+
+// ====  HELPERS  ====
+
+static __m256d horner_avx2(__m256d x, const t_double* coef, t_int32 cnt) {
+
+  __m256d p = _mm256_set1_pd(coef[cnt - 1]);
+  for (t_int32 k = cnt - 2; k >= 0; k--) { p = _mm256_fmadd_pd(p, x, _mm256_set1_pd(coef[k])); }
+  return p;
+}
+
+// ====  KERNEL_EXP_AVX2  ====
+
+void kernel_exp_avx2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  t_int32 i = 0;
+
+  for (; i + 4 <= cnt; i += 4) {
+    __m256d x_in = _mm256_loadu_pd(x_arr + i);
+    __m256d x = _mm256_min_pd(_mm256_max_pd(x_in, _mm256_set1_pd(KERNELS_EXP_MIN)), _mm256_set1_pd(KERNELS_EXP_MAX));
+
+    __m256d n = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(KERNELS_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256d r = _mm256_fnmadd_pd(n, _mm256_set1_pd(KERNELS_LN2_HI), x);
+    r = _mm256_fnmadd_pd(n, _mm256_set1_pd(KERNELS_LN2_LO), r);
+    __m256d p = horner_avx2(r, kernels_exp_coef, KERNELS_EXP_CNT);
+
+    // Build 2^n from its exponent bits
+    __m256i e = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    e = _mm256_slli_epi64(_mm256_add_epi64(e, _mm256_set1_epi64x(1023)), 52);
+    p = _mm256_mul_pd(p, _mm256_castsi256_pd(e));
+
+    __m256d is_min = _mm256_cmp_pd(x_in, _mm256_set1_pd(KERNELS_EXP_MIN), _CMP_LT_OQ);
+    _mm256_storeu_pd(y_arr + i, _mm256_andnot_pd(is_min, p));
+  }
+
+  if (i < cnt) { kernel_exp_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+// ====  KERNEL_LOG_AVX2  ====
+
+void kernel_log_avx2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  const __m256d two52 = _mm256_set1_pd(4503599627370496.0);   // 2^52, to convert the exponent bits to a double
+  const __m256d one = _mm256_set1_pd(1.0);
+  t_int32 i = 0;
+
+  for (; i + 4 <= cnt; i += 4) {
+    __m256i bits = _mm256_castpd_si256(_mm256_loadu_pd(x_arr + i));
+
+    // Split the exponent and the mantissa
+    __m256d e = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(bits, 52), _mm256_castpd_si256(two52)));
+    e = _mm256_sub_pd(e, _mm256_add_pd(two52, _mm256_set1_pd(1023)));
+    __m256d m = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+      _mm256_castpd_si256(one)));
+
+    __m256d is_big = _mm256_cmp_pd(m, _mm256_set1_pd(KERNELS_SQRT2), _CMP_GT_OQ);
+    m = _mm256_mul_pd(m, _mm256_blendv_pd(one, _mm256_set1_pd(0.5), is_big));
+    e = _mm256_add_pd(e, _mm256_and_pd(is_big, one));
+
+    __m256d s = _mm256_div_pd(_mm256_sub_pd(m, one), _mm256_add_pd(m, one));
+    __m256d p = _mm256_mul_pd(s, horner_avx2(_mm256_mul_pd(s, s), kernels_log_coef, KERNELS_LOG_CNT));
+    p = _mm256_fmadd_pd(e, _mm256_set1_pd(KERNELS_LN2_LO), p);
+
+    _mm256_storeu_pd(y_arr + i, _mm256_fmadd_pd(e, _mm256_set1_pd(KERNELS_LN2_HI), p));
+  }
+
+  if (i < cnt) { kernel_log_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+// ====  KERNEL_SIN_AVX2  ====
+
+void kernel_sin_avx2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  t_int32 i = 0;
+
+  for (; i + 4 <= cnt; i += 4) {
+    __m256d x = _mm256_loadu_pd(x_arr + i);
+    _mm256_storeu_pd(y_arr + i, _mm256_mul_pd(x, horner_avx2(_mm256_mul_pd(x, x), kernels_sin_coef, KERNELS_SIN_CNT)));
+  }
+
+  if (i < cnt) { kernel_sin_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+// ====  KERNEL_ASIN_AVX2  ====
+
+void kernel_asin_avx2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  const __m256d sign = _mm256_set1_pd(-0.0);
+  const __m256d half = _mm256_set1_pd(0.5);
+  t_int32 i = 0;
+
+  for (; i + 4 <= cnt; i += 4) {
+    __m256d x_in = _mm256_loadu_pd(x_arr + i);
+    __m256d x = _mm256_andnot_pd(sign, x_in);
+
+    // Above 0.5:  asin(x) = PI / 2 - 2 * asin(sqrt((1 - x) / 2))
+    __m256d is_big = _mm256_cmp_pd(x, half, _CMP_GT_OQ);
+    x = _mm256_blendv_pd(x, _mm256_sqrt_pd(_mm256_mul_pd(_mm256_sub_pd(_mm256_set1_pd(1.0), x), half)), is_big);
+
+    __m256d p = _mm256_mul_pd(x, horner_avx2(_mm256_mul_pd(x, x), kernels_asin_coef, KERNELS_ASIN_CNT));
+    p = _mm256_blendv_pd(p, _mm256_fnmadd_pd(_mm256_set1_pd(2.0), p, _mm256_set1_pd(PI / 2)), is_big);
+
+    _mm256_storeu_pd(y_arr + i, _mm256_or_pd(p, _mm256_and_pd(sign, x_in)));
+  }
+
+  if (i < cnt) { kernel_asin_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+#endif
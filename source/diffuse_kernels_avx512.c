@@ -0,0 +1,226 @@
+#include "diffuse_kernels.h"
+
+// Kernels using AVX-512 F: 8 doubles per register
+// Compile with -mavx512f on GCC and Clang
+
+#ifdef KERNELS_AVX512
+
+#include <immintrin.h>
+
+// ====  KERNEL_FIX_AVX512  ====
+
+void kernel_fix_avx512(t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first) {
+
+  __m512d g = _mm512_set1_pd(gain);
+  t_int32 smp = 0;
+
+  for (; smp + 16 <= len; smp += 16) {
+    __m512d out0 = is_first ? _mm512_setzero_pd() : _mm512_loadu_pd(sig_out + smp);
+    __m512d out1 = is_first ? _mm512_setzero_pd() : _mm512_loadu_pd(sig_out + smp + 8);
+    out0 = _mm512_fmadd_pd(_mm512_loadu_pd(sig_in + smp), g, out0);
+    out1 = _mm512_fmadd_pd(_mm512_loadu_pd(sig_in + smp + 8), g, out1);
+    _mm512_storeu_pd(sig_out + smp, out0);
+    _mm512_storeu_pd(sig_out + smp + 8, out1);
+  }
+
+  // The remainder with a mask: lanes beyond len are neither loaded nor stored
+  for (; smp < len; smp += 8) {
+    __mmask8 mask = (__mmask8)((len - smp >= 8) ? 0xFF : ((1u << (len - smp)) - 1));
+    __m512d out0 = is_first ? _mm512_setzero_pd() : _mm512_maskz_loadu_pd(mask, sig_out + smp);
+    out0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, sig_in + smp), g, out0);
+    _mm512_mask_storeu_pd(sig_out + smp, mask, out0);
+  }
+}
+
+// ====  KERNEL_VAR_AVX512  ====
+
+void kernel_var_avx512(t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first) {
+
+  __m512d g0 = _mm512_set1_pd(gain);
+  __m512d dg = _mm512_set1_pd(d_gain);
+  __m512d ind = _mm512_set_pd(7, 6, 5, 4, 3, 2, 1, 0);   // Sample index of each lane
+  __m512d step = _mm512_set1_pd(8);
+  t_int32 smp = 0;
+
+  for (; smp < len; smp += 8) {
+    __mmask8 mask = (__mmask8)((len - smp >= 8) ? 0xFF : ((1u << (len - smp)) - 1));
+    __m512d out0 = is_first ? _mm512_setzero_pd() : _mm512_maskz_loadu_pd(mask, sig_out + smp);
+    out0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, sig_in + smp), _mm512_fmadd_pd(ind, dg, g0), out0);
+    _mm512_mask_storeu_pd(sig_out + smp, mask, out0);
+    ind = _mm512_add_pd(ind, step);
+  }
+}
+
+// ====  KERNEL_GEO_AVX512  ====
+
+void kernel_geo_avx512(t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset,
+    t_int32 len, t_bool is_first) {
+
+  // The first 8 gains, and the recurrence over 8 samples: g[i + 8] = r8 * g[i] + o8
+  t_double lane[8];
+  t_double r8 = 1;
+  t_double o8 = 0;
+  for (t_int32 i = 0; i < 8; i++) { lane[i] = gain; gain = gain * ratio + offset; r8 *= ratio; o8 = o8 * ratio + offset; }
+
+  __m512d g = _mm512_loadu_pd(lane);
+  __m512d r = _mm512_set1_pd(r8);
+  __m512d o = _mm512_set1_pd(o8);
+  t_int32 smp = 0;
+
+  for (; smp < len; smp += 8) {
+    __mmask8 mask = (__mmask8)((len - smp >= 8) ? 0xFF : ((1u << (len - smp)) - 1));
+    __m512d out0 = is_first ? _mm512_setzero_pd() : _mm512_maskz_loadu_pd(mask, sig_out + smp);
+    out0 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, sig_in + smp), g, out0);
+    _mm512_mask_storeu_pd(sig_out + smp, mask, out0);
+    g = _mm512_fmadd_pd(g, r, o);
+  }
+}
+
+// ====  KERNEL_MIX_AVX512  ====
+
+void kernel_mix_avx512(t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+    t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first) {
+
+  t_int32 s = smp;
+
+  // 4 outputs x 16 samples in 8 accumulators
+  for (; s + 16 <= smp + len; s += 16) {
+
+    __m512d acc00, acc01, acc10, acc11, acc20, acc21, acc30, acc31;
+
+    if (is_first) {
+      acc00 = acc01 = acc10 = acc11 = acc20 = acc21 = acc30 = acc31 = _mm512_setzero_pd();
+    }
+    else {
+      acc00 = _mm512_loadu_pd(sig_out[0] + s);  acc01 = _mm512_loadu_pd(sig_out[0] + s + 8);
+      acc10 = _mm512_loadu_pd(sig_out[1] + s);  acc11 = _mm512_loadu_pd(sig_out[1] + s + 8);
+      acc20 = _mm512_loadu_pd(sig_out[2] + s);  acc21 = _mm512_loadu_pd(sig_out[2] + s + 8);
+      acc30 = _mm512_loadu_pd(sig_out[3] + s);  acc31 = _mm512_loadu_pd(sig_out[3] + s + 8);
+    }
+
+
+    for (t_int32 in = 0; in < in_cnt; in++) {
+      const t_double* g = gain_arr[in] + gain_ofs;
+      __m512d x0 = _mm512_loadu_pd(sig_in[in] + s);
+      __m512d x1 = _mm512_loadu_pd(sig_in[in] + s + 8);
+      __m512d g0 = _mm512_set1_pd(g[0]);
+      __m512d g1 = _mm512_set1_pd(g[1]);
+      __m512d g2 = _mm512_set1_pd(g[2]);
+      __m512d g3 = _mm512_set1_pd(g[3]);
+      acc00 = _mm512_fmadd_pd(x0, g0, acc00);  acc01 = _mm512_fmadd_pd(x1, g0, acc01);
+      acc10 = _mm512_fmadd_pd(x0, g1, acc10);  acc11 = _mm512_fmadd_pd(x1, g1, acc11);
+      acc20 = _mm512_fmadd_pd(x0, g2, acc20);  acc21 = _mm512_fmadd_pd(x1, g2, acc21);
+      acc30 = _mm512_fmadd_pd(x0, g3, acc30);  acc31 = _mm512_fmadd_pd(x1, g3, acc31);
+    }
+
+    _mm512_storeu_pd(sig_out[0] + s, acc00);  _mm512_storeu_pd(sig_out[0] + s + 8, acc01);
+    _mm512_storeu_pd(sig_out[1] + s, acc10);  _mm512_storeu_pd(sig_out[1] + s + 8, acc11);
+    _mm512_storeu_pd(sig_out[2] + s, acc20);  _mm512_storeu_pd(sig_out[2] + s + 8, acc21);
+    _mm512_storeu_pd(sig_out[3] + s, acc30);  _mm512_storeu_pd(sig_out[3] + s + 8, acc31);
+  }
+
+  if (s < smp + len) { kernel_mix_scalar(sig_out, sig_in, gain_arr, gain_ofs, in_cnt, s, smp + len - s, is_first); }
+}
+
+// ========  MATH KERNELS  ========
+// The remainders are processed with a mask: lanes beyond cnt are neither loaded nor stored
+
+// ====  HELPERS  ====
+
+static __m512d horner_avx512(__m512d x, const t_double* coef, t_int32 cnt) {
+
+  __m512d p = _mm512_set1_pd(coef[cnt - 1]);
+  for (t_int32 k = cnt - 2; k >= 0; k--) { p = _mm512_fmadd_pd(p, x, _mm512_set1_pd(coef[k])); }
+  return p;
+}
+
+static __mmask8 mask_avx512(t_int32 i, t_int32 cnt) {
+
+  return (__mmask8)((cnt - i >= 8) ? 0xFF : ((1u << (cnt - i)) - 1));
+}
+
+// ====  KERNEL_EXP_AVX512  ====
+
+void kernel_exp_avx512(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i += 8) {
+    __mmask8 mask = mask_avx512(i, cnt);
+    __m512d x_in = _mm512_maskz_loadu_pd(mask, x_arr + i);
+    __m512d x = _mm512_min_pd(_mm512_max_pd(x_in, _mm512_set1_pd(KERNELS_EXP_MIN)), _mm512_set1_pd(KERNELS_EXP_MAX));
+
+    __m512d n = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(KERNELS_LOG2E)), _MM_FROUND_TO_NEAREST_INT);
+    __m512d r = _mm512_fnmadd_pd(n, _mm512_set1_pd(KERNELS_LN2_HI), x);
+    r = _mm512_fnmadd_pd(n, _mm512_set1_pd(KERNELS_LN2_LO), r);
+
+    // Multiply by 2^n directly
+    __m512d p = _mm512_scalef_pd(horner_avx512(r, kernels_exp_coef, KERNELS_EXP_CNT), n);
+
+    __mmask8 is_min = _mm512_cmp_pd_mask(x_in, _mm512_set1_pd(KERNELS_EXP_MIN), _CMP_LT_OQ);
+    _mm512_mask_storeu_pd(y_arr + i, mask, _mm512_mask_mov_pd(p, is_min, _mm512_setzero_pd()));
+  }
+}
+
+// ====  KERNEL_LOG_AVX512  ====
+
+void kernel_log_avx512(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  const __m512d one = _mm512_set1_pd(1.0);
+
+  for (t_int32 i = 0; i < cnt; i += 8) {
+    __mmask8 mask = mask_avx512(i, cnt);
+    __m512d x = _mm512_mask_loadu_pd(one, mask, x_arr + i);
+
+    // Split the exponent and the mantissa in [1, 2)
+    __m512d e = _mm512_getexp_pd(x);
+    __m512d m = _mm512_getmant_pd(x, _MM_MANT_NORM_1_2, _MM_MANT_SIGN_src);
+
+    __mmask8 is_big = _mm512_cmp_pd_mask(m, _mm512_set1_pd(KERNELS_SQRT2), _CMP_GT_OQ);
+    m = _mm512_mask_mul_pd(m, is_big, m, _mm512_set1_pd(0.5));
+    e = _mm512_mask_add_pd(e, is_big, e, one);
+
+    __m512d s = _mm512_div_pd(_mm512_sub_pd(m, one), _mm512_add_pd(m, one));
+    __m512d p = _mm512_mul_pd(s, horner_avx512(_mm512_mul_pd(s, s), kernels_log_coef, KERNELS_LOG_CNT));
+    p = _mm512_fmadd_pd(e, _mm512_set1_pd(KERNELS_LN2_LO), p);
+
+    _mm512_mask_storeu_pd(y_arr + i, mask, _mm512_fmadd_pd(e, _mm512_set1_pd(KERNELS_LN2_HI), p));
+  }
+}
+
+// ====  KERNEL_SIN_AVX512  ====
+
+void kernel_sin_avx512(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i += 8) {
+    __mmask8 mask = mask_avx512(i, cnt);
+    __m512d x = _mm512_maskz_loadu_pd(mask, x_arr + i);
+    _mm512_mask_storeu_pd(y_arr + i, mask, _mm512_mul_pd(x, horner_avx512(_mm512_mul_pd(x, x), kernels_sin_coef, KERNELS_SIN_CNT)));
+  }
+}
+
+// ====  KERNEL_ASIN_AVX512  ====
+
+void kernel_asin_avx512(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  const __m512d half = _mm512_set1_pd(0.5);
+
+  for (t_int32 i = 0; i < cnt; i += 8) {
+    __mmask8 mask = mask_avx512(i, cnt);
+    __m512d x_in = _mm512_maskz_loadu_pd(mask, x_arr + i);
+    __m512d x = _mm512_abs_pd(x_in);
+
+    // Above 0.5:  asin(x) = PI / 2 - 2 * asin(sqrt((1 - x) / 2))
+    __mmask8 is_big = _mm512_cmp_pd_mask(x, half, _CMP_GT_OQ);
+    x = _mm512_mask_sqrt_pd(x, is_big, _mm512_mul_pd(_mm512_sub_pd(_mm512_set1_pd(1.0), x), half));
+
+    __m512d p = _mm512_mul_pd(x, horner_avx512(_mm512_mul_pd(x, x), kernels_asin_coef, KERNELS_ASIN_CNT));
+    p = _mm512_mask_fnmadd_pd(p, is_big, _mm512_set1_pd(2.0), _mm512_set1_pd(PI / 2));
+
+    // Restore the sign
+    __mmask8 is_neg = _mm512_cmp_pd_mask(x_in, _mm512_setzero_pd(), _CMP_LT_OQ);
+    p = _mm512_mask_sub_pd(p, is_neg, _mm512_setzero_pd(), p);
+
+    _mm512_mask_storeu_pd(y_arr + i, mask, p);
+  }
+}
+
+#endif
@@ -0,0 +1,217 @@
+#include "diffuse_kernels.h"
+
+// Kernels using SSE2: 2 doubles per register
+
+#ifdef KERNELS_X86
+
+#include <emmintrin.h>
+
+// ====  KERNEL_FIX_SSE2  ====
+
+void kernel_fix_sse2(t_double* sig_out, const t_double* sig_in, t_double gain, t_int32 len, t_bool is_first) {
+
+  __m128d g = _mm_set1_pd(gain);
+  t_int32 smp = 0;
+
+  // Two registers per iteration to hide the latency of the additions
+  for (; smp + 4 <= len; smp += 4) {
+    __m128d out0 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out + smp);
+    __m128d out1 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out + smp + 2);
+    out0 = _mm_add_pd(out0, _mm_mul_pd(_mm_loadu_pd(sig_in + smp), g));
+    out1 = _mm_add_pd(out1, _mm_mul_pd(_mm_loadu_pd(sig_in + smp + 2), g));
+    _mm_storeu_pd(sig_out + smp, out0);
+    _mm_storeu_pd(sig_out + smp + 2, out1);
+  }
+
+  for (; smp < len; smp++) { sig_out[smp] = (is_first ? 0 : sig_out[smp]) + sig_in[smp] * gain; }
+}
+
+// ====  KERNEL_VAR_SSE2  ====
+
+void kernel_var_sse2(t_double* sig_out, const t_double* sig_in, t_double gain, t_double d_gain, t_int32 len, t_bool is_first) {
+
+  __m128d g0 = _mm_set1_pd(gain);
+  __m128d dg = _mm_set1_pd(d_gain);
+  __m128d ind = _mm_set_pd(1, 0);     // Sample index of each lane
+  __m128d step = _mm_set1_pd(2);
+  t_int32 smp = 0;
+
+  for (; smp + 2 <= len; smp += 2) {
+    __m128d g = _mm_add_pd(g0, _mm_mul_pd(ind, dg));
+    __m128d out0 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out + smp);
+    out0 = _mm_add_pd(out0, _mm_mul_pd(_mm_loadu_pd(sig_in + smp), g));
+    _mm_storeu_pd(sig_out + smp, out0);
+    ind = _mm_add_pd(ind, step);
+  }
+
+  for (; smp < len; smp++) { sig_out[smp] = (is_first ? 0 : sig_out[smp]) + sig_in[smp] * (gain + smp * d_gain); }
+}
+
+// ====  KERNEL_GEO_SSE2  ====
+
+void kernel_geo_sse2(t_double* sig_out, const t_double* sig_in, t_double gain, t_double ratio, t_double offset,
+    t_int32 len, t_bool is_first) {
+
+  // Each lane steps over 2 samples: g[i + 2] = ratio^2 * g[i] + (ratio + 1) * offset
+  __m128d g = _mm_set_pd(gain * ratio + offset, gain);
+  __m128d r2 = _mm_set1_pd(ratio * ratio);
+  __m128d o2 = _mm_set1_pd(offset * ratio + offset);
+  t_int32 smp = 0;
+
+  for (; smp + 2 <= len; smp += 2) {
+    __m128d out0 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out + smp);
+    out0 = _mm_add_pd(out0, _mm_mul_pd(_mm_loadu_pd(sig_in + smp), g));
+    _mm_storeu_pd(sig_out + smp, out0);
+    g = _mm_add_pd(_mm_mul_pd(g, r2), o2);
+  }
+
+  if (smp < len) { kernel_geo_scalar(sig_out + smp, sig_in + smp, _mm_cvtsd_f64(g), ratio, offset, len - smp, is_first); }
+}
+
+// ====  KERNEL_MIX_SSE2  ====
+
+void kernel_mix_sse2(t_double** sig_out, t_double** sig_in, const t_double* const* gain_arr, t_int32 gain_ofs,
+    t_int32 in_cnt, t_int32 smp, t_int32 len, t_bool is_first) {
+
+  t_int32 s = smp;
+
+  for (; s + 2 <= smp + len; s += 2) {
+
+    __m128d acc0 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out[0] + s);
+    __m128d acc1 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out[1] + s);
+    __m128d acc2 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out[2] + s);
+    __m128d acc3 = is_first ? _mm_setzero_pd() : _mm_loadu_pd(sig_out[3] + s);
+
+    for (t_int32 in = 0; in < in_cnt; in++) {
+      const t_double* g = gain_arr[in] + gain_ofs;
+      __m128d x = _mm_loadu_pd(sig_in[in] + s);
+      acc0 = _mm_add_pd(acc0, _mm_mul_pd(x, _mm_set1_pd(g[0])));
+      acc1 = _mm_add_pd(acc1, _mm_mul_pd(x, _mm_set1_pd(g[1])));
+      acc2 = _mm_add_pd(acc2, _mm_mul_pd(x, _mm_set1_pd(g[2])));
+      acc3 = _mm_add_pd(acc3, _mm_mul_pd(x, _mm_set1_pd(g[3])));
+    }
+
+    _mm_storeu_pd(sig_out[0] + s, acc0);
+    _mm_storeu_pd(sig_out[1] + s, acc1);
+    _mm_storeu_pd(sig_out[2] + s, acc2);
+    _mm_storeu_pd(sig_out[3] + s, acc3);
+  }
+
+  if (s < smp + len) { kernel_mix_scalar(sig_out, sig_in, gain_arr, gain_ofs, in_cnt, s, smp + len - s, is_first); }
+}
+
+// ========  MATH KERNELS  ========
+
+// ====  HELPERS  ====
+
+static __m128d horner_sse2(__m128d x, const t_double* coef, t_int32 cnt) {
+
+  __m128d p = _mm_set1_pd(coef[cnt - 1]);
+  for (t_int32 k = cnt - 2; k >= 0; k--) { p = _mm_add_pd(_mm_mul_pd(p, x), _mm_set1_pd(coef[k])); }
+  return p;
+}
+
+// Select a where the mask is set, b elsewhere
+static __m128d select_sse2(__m128d mask, __m128d a, __m128d b) {
+
+  return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+// ====  KERNEL_EXP_SSE2  ====
+
+void kernel_exp_sse2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  t_int32 i = 0;
+
+  for (; i + 2 <= cnt; i += 2) {
+    __m128d x_in = _mm_loadu_pd(x_arr + i);
+    __m128d x = _mm_min_pd(_mm_max_pd(x_in, _mm_set1_pd(KERNELS_EXP_MIN)), _mm_set1_pd(KERNELS_EXP_MAX));
+
+    // Round to the nearest integer with the default rounding mode
+    __m128i n_i = _mm_cvtpd_epi32(_mm_mul_pd(x, _mm_set1_pd(KERNELS_LOG2E)));
+    __m128d n = _mm_cvtepi32_pd(n_i);
+    __m128d r = _mm_sub_pd(_mm_sub_pd(x, _mm_mul_pd(n, _mm_set1_pd(KERNELS_LN2_HI))), _mm_mul_pd(n, _mm_set1_pd(KERNELS_LN2_LO)));
+    __m128d p = horner_sse2(r, kernels_exp_coef, KERNELS_EXP_CNT);
+
+    // Build 2^n from its exponent bits: the two 32 bit integers are moved to the 64 bit lanes
+    __m128i e = _mm_add_epi32(n_i, _mm_set1_epi32(1023));
+    e = _mm_slli_epi64(_mm_unpacklo_epi32(e, _mm_setzero_si128()), 52);
+    p = _mm_mul_pd(p, _mm_castsi128_pd(e));
+
+    _mm_storeu_pd(y_arr + i, _mm_andnot_pd(_mm_cmplt_pd(x_in, _mm_set1_pd(KERNELS_EXP_MIN)), p));
+  }
+
+  if (i < cnt) { kernel_exp_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+// ====  KERNEL_LOG_SSE2  ====
+
+void kernel_log_sse2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  const __m128d two52 = _mm_set1_pd(4503599627370496.0);   // 2^52, to convert the exponent bits to a double
+  const __m128d one = _mm_set1_pd(1.0);
+  t_int32 i = 0;
+
+  for (; i + 2 <= cnt; i += 2) {
+    __m128i bits = _mm_castpd_si128(_mm_loadu_pd(x_arr + i));
+
+    // Split the exponent and the mantissa
+    __m128d e = _mm_castsi128_pd(_mm_or_si128(_mm_srli_epi64(bits, 52), _mm_castpd_si128(two52)));
+    e = _mm_sub_pd(e, _mm_add_pd(two52, _mm_set1_pd(1023)));
+    __m128d m = _mm_castsi128_pd(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+      _mm_castpd_si128(one)));
+
+    __m128d is_big = _mm_cmpgt_pd(m, _mm_set1_pd(KERNELS_SQRT2));
+    m = _mm_mul_pd(m, select_sse2(is_big, _mm_set1_pd(0.5), one));
+    e = _mm_add_pd(e, _mm_and_pd(is_big, one));
+
+    __m128d s = _mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one));
+    __m128d p = _mm_mul_pd(s, horner_sse2(_mm_mul_pd(s, s), kernels_log_coef, KERNELS_LOG_CNT));
+    p = _mm_add_pd(p, _mm_mul_pd(e, _mm_set1_pd(KERNELS_LN2_LO)));
+
+    _mm_storeu_pd(y_arr + i, _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(KERNELS_LN2_HI)), p));
+  }
+
+  if (i < cnt) { kernel_log_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+// ====  KERNEL_SIN_SSE2  ====
+
+void kernel_sin_sse2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  t_int32 i = 0;
+
+  for (; i + 2 <= cnt; i += 2) {
+    __m128d x = _mm_loadu_pd(x_arr + i);
+    _mm_storeu_pd(y_arr + i, _mm_mul_pd(x, horner_sse2(_mm_mul_pd(x, x), kernels_sin_coef, KERNELS_SIN_CNT)));
+  }
+
+  if (i < cnt) { kernel_sin_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+// ====  KERNEL_ASIN_SSE2  ====
+
+void kernel_asin_sse2(t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  const __m128d sign = _mm_set1_pd(-0.0);
+  const __m128d half = _mm_set1_pd(0.5);
+  t_int32 i = 0;
+
+  for (; i + 2 <= cnt; i += 2) {
+    __m128d x_in = _mm_loadu_pd(x_arr + i);
+    __m128d x = _mm_andnot_pd(sign, x_in);
+
+    // Above 0.5:  asin(x) = PI / 2 - 2 * asin(sqrt((1 - x) / 2))
+    __m128d is_big = _mm_cmpgt_pd(x, half);
+    x = select_sse2(is_big, _mm_sqrt_pd(_mm_mul_pd(_mm_sub_pd(_mm_set1_pd(1.0), x), half)), x);
+
+    __m128d p = _mm_mul_pd(x, horner_sse2(_mm_mul_pd(x, x), kernels_asin_coef, KERNELS_ASIN_CNT));
+    p = select_sse2(is_big, _mm_sub_pd(_mm_set1_pd(PI / 2), _mm_add_pd(p, p)), p);
+
+    _mm_storeu_pd(y_arr + i, _mm_or_pd(p, _mm_and_pd(sign, x_in)));
+  }
+
+  if (i < cnt) { kernel_asin_scalar(y_arr + i, x_arr + i, cnt - i); }
+}
+
+#endif
@@ -1,115 +1,10 @@
 #include "diffuse~.h"
 
-// ====  _STATE_INIT  ====
-
-//******************************************************************************
-//  Initialize a state. Call before _state_alloc to set all array pointers to NULL.
-//
-void _state_init(t_state* state) {
-
-  // Initialize the symbols to the empty symbol
-  state->name = gensym("null");
-
-  // Initialize the array pointers to NULL
-  state->A_arr    = NULL;
-  state->U_rm_arr = NULL;
-  state->U_xf_arr = NULL;
-  state->U_cur    = NULL;
-
-  // Initialize the count to -1
-  state->cnt = -1;
-  state->index = -1;
-}
-
-// ====  _STATE_ALLOC  ====
-
-//******************************************************************************
-//  Allocate arrays for a state.
-//  Call only after _state_init to make sure the array pointers were set NULL.
-//  Returns:
-//  ERR_NONE:  Succesful initialization
-//  ERR_COUNT:  Invalid count argument, should be one at least
-//  ERR_ALLOC:  Failed allocation
-//
-t_my_err _state_alloc(t_state* state, t_int32 param_cnt, t_double u, t_double a) {
-
-  // The count should not be negative
-  if (param_cnt < 0) {
-    state->cnt = -1;
-    return ERR_COUNT;
-  }
-
-  // ... if it is equal to 0:
-  else if (param_cnt == 0) {
-    state->cnt = 0;
-    return ERR_NONE;
-  }
-
-  // ... if it is at least 1:
-  else {
-
-    // Allocate the arrays
-    state->A_arr = (t_double*)sysmem_newptr(sizeof(t_double) * param_cnt);
-    state->U_rm_arr = (t_double*)sysmem_newptr(sizeof(t_double) * param_cnt);
-    state->U_xf_arr = (t_double*)sysmem_newptr(sizeof(t_double) * param_cnt);
-    state->U_cur = state->U_xf_arr;
-
-    // Then test the allocation
-    if (state->A_arr && state->U_rm_arr && state->U_xf_arr) {
-
-      // Set the count
-      state->cnt = param_cnt;
-
-      // Initialize the array values
-      for (t_int32 res = 0; res < state->cnt; res++) {
-        state->A_arr[res] = a;
-        state->U_rm_arr[res] = u;
-        state->U_xf_arr[res] = u;
-      }
-
-      return ERR_NONE;
-    }
-
-    // Otherwise there was an allocation error
-    else {
-      state->cnt = -1;
-      if (state->A_arr) { sysmem_freeptr(state->A_arr); state->A_arr = NULL; }
-      if (state->U_rm_arr) { sysmem_freeptr(state->U_rm_arr); state->U_rm_arr = NULL; }
-      if (state->U_xf_arr) { sysmem_freeptr(state->U_xf_arr); state->U_xf_arr = NULL; }
-      return ERR_ALLOC;
-    }
-  }
-}
-
-// ====  _STATE_FREE  ====
-
-//******************************************************************************
-//  Free one state
-//
-void _state_free(t_state* state) {
-
-  state->cnt = 0;
-
-  if (state->A_arr) {
-    sysmem_freeptr(state->A_arr);
-    state->A_arr = NULL;
-  }
-
-  if (state->U_rm_arr) {
-    sysmem_freeptr(state->U_rm_arr);
-    state->U_rm_arr = NULL;
-  }
-
-  if (state->U_xf_arr) {
-    sysmem_freeptr(state->U_xf_arr);
-    state->U_xf_arr = NULL;
-  }
-}
-
 // ====  _STATE_ARR_NEW  ====
 
 //******************************************************************************
-//  Create an array of states
+//  Create an array of states, in a single block with the values of all the states
+//  The array is at the start of the block, followed by the value arrays aligned on a cache line
 //  cnt:  number of states in the array, at least 1
 //  state_cnt:  pointer to the element count of the array
 //  Returns a pointer to an array of states or NULL
@@ -119,17 +14,23 @@ t_state* _state_arr_new(t_int32 _state_cnt, t_int32* state_cnt, t_int32 param_cn
   // Test that the count for the array is at least one
   if (_state_cnt < 1) { return NULL; }
 
-  // Allocate the array of states and test the allocation
-  t_state* state_arr = (t_state*)sysmem_newptr(sizeof(t_state) * _state_cnt);
+  // Add up the size of the value arrays
+  t_state state_tmp;
+  t_arena arena = { NULL, 0 };
+  for (t_int32 st = 0; st < _state_cnt; st++) { _state_layout(&state_tmp, &arena, param_cnt, 0, 0); }
+
+  // Allocate the block and test the allocation
+  size_t arr_size = sizeof(t_state) * _state_cnt;
+  t_state* state_arr = (t_state*)sysmem_newptr(arr_size + CORE_ALIGN - 1 + arena.size);
   if (!state_arr) { return NULL; }
 
-  // Initialize and then allocate each state
+  // Initialize each state and carve its arrays out of the block
+  arena.base = (char*)CORE_ALIGN_PTR((char*)state_arr + arr_size);
+  arena.size = 0;
   for (t_int32 st = 0; st < _state_cnt; st++) {
-    _state_init(state_arr + st);
+    _state_init(state_arr + st, SYM(NULL));
     (state_arr + st)->index = st;
-  }
-  for (t_int32 st = 0; st < _state_cnt; st++) {
-    if (_state_alloc(state_arr + st, param_cnt, 0, 0) != ERR_NONE) { return NULL; }
+    _state_layout(state_arr + st, &arena, param_cnt, 0, 0);
   }
 
   // Set the count and return the allocated pointer
@@ -140,17 +41,14 @@ t_state* _state_arr_new(t_int32 _state_cnt, t_int32* state_cnt, t_int32 param_cn
 // ====  _STATE_ARR_FREE  ====
 
 //******************************************************************************
-//  Free an array of states
+//  Free an array of states, with the values of all the states
 //
 void _state_arr_free(t_state** state_arr, t_int32* state_cnt) {
 
   // Test if the array of storage slots is not yet allocated
   if (!*state_arr) { return; }
 
-  // Otherwise proceed to free each state
-  for (t_int32 st = 0; st < *state_cnt; st++) { _state_free(*state_arr + st); }
-
-  // Free the array of states and set the count to 0
+  // The value arrays are in the same block as the array of states
   sysmem_freeptr(*state_arr);
   *state_arr = NULL;
   *state_cnt = 0;
@@ -175,19 +73,6 @@ t_state* _state_find(t_state* state_arr, t_int32 state_cnt, t_atom* atom) {
   return (state_arr + state_ind);
 }
 
-// ====  _STATE_CALC_ABSC  ====
-
-//******************************************************************************
-//  Calculate the abscissa values for the current ramping and crossfade functions
-//
-void _state_calc_absc(t_diffuse* x, t_state * state) {
-
-for (t_int32 ch = 0; ch < state->cnt; ch++) {
-  state->U_rm_arr[ch] = x->ramp_inv_func(state->A_arr[ch], x->ramp_param);
-  state->U_xf_arr[ch] = x->xfade_inv_func(state->A_arr[ch], x->xfade_param);
-}
-}
-
 // ====  _STATE_STORE  ====
 
 //******************************************************************************
@@ -203,7 +88,7 @@ t_my_err _state_store(t_diffuse* x, t_channel* channel, t_state* state, t_symbol
   for (t_int32 ch = 0; ch < state->cnt; ch++) { state->A_arr[ch] = channel->A_cur[ch]; }
 
   // Calculate the abscissa values
-  _state_calc_absc(x, state);
+  _state_calc_absc(x->core, state);
 
   // Set the name of the state
   state->name = name;
@@ -211,63 +96,24 @@ t_my_err _state_store(t_diffuse* x, t_channel* channel, t_state* state, t_symbol
   return ERR_NONE;
 }
 
-// ====  _STATE_ITERATE  ====
-
-//******************************************************************************
-//  Iterate the channel when the countdown reaches 0
-//
-void _state_iterate(t_diffuse* x, t_channel* channel) {
-
-  // Output in case it is not muted
-  if (!channel->is_mute_ramp) {
-
-    // Output a message with information about the state
-    //   end_ramp (int: channel index) (int: mode type)
-    t_atom mess_arr[2];
-    atom_setlong(mess_arr, channel - x->channel_arr);
-    atom_setlong(mess_arr + 1, channel->state_ind);
-    outlet_anything(x->outl_mess, gensym("end_ramp"), 2, mess_arr);
-  }
-
-  // Update
-  switch (channel->mode_type) {
-  case MODE_TYPE_VAR:
-
-    channel->cntd = INDEFINITE;
-    channel->mode_type = MODE_TYPE_FIX;
-    //POST("Channel %i:  End or ramp:  ", channel - x->channel_arr);
-
-    for (t_int32 ch = 0; ch < channel->out_cnt; ch++) {
-      //POST("%i: U_cur = %f - U_targ = %f - A_cur = %f - A_targ = %f",
-      //  ch, channel->U_cur[ch], channel->U_targ[ch], channel->A_cur[ch], channel->A_targ[ch]);
-      channel->U_cur[ch] = channel->U_targ[ch];
-      channel->A_cur[ch] = channel->A_targ[ch];
-    }
-
-    break;
-  }
-}
-
 // ====  _STATE_DICT_SAVE  ====
 
 //******************************************************************************
 //  To save a state into a dictionary. Passed as a function pointer argument to dict_save
-//  Returns ERR_NONE or ERR_ALLOC
+//  The ordinates are written to the scratch atoms of save, which the dictionary copies.
+//  Returns ERR_NONE
 //
-t_my_err _state_dict_save(t_state* state, t_dictionary* dict_arr_states, t_symbol* state_sym, t_symbol* is_prot) {
+t_my_err _state_dict_save(t_state_save* save, t_dictionary* dict_arr_states, t_symbol* state_sym, t_symbol* is_prot) {
+
+  t_state* state = save->state;
 
   t_dictionary* dict_state = dictionary_sprintf("@name %s @count %i", state_sym->s_name, state->cnt);
   dictionary_appenddictionary(dict_arr_states, state_sym, (t_object*)dict_state);
 
-  // Create an array of atoms for temporary storage
-  t_atom* atom_arr = (t_atom*)sysmem_newptr(sizeof(t_atom)* state->cnt);
-  if (!atom_arr) { return ERR_ALLOC; }
-
   // Create subdictionaries for the abscissa and ordinate arrays, and append them to the state dictionary
-  atom_setdouble_array(state->cnt, atom_arr, state->cnt, state->A_arr);
-  dictionary_appendatoms(dict_state, gensym("ordinate"), state->cnt, atom_arr);
+  atom_setdouble_array(state->cnt, save->atom_arr, state->cnt, state->A_arr);
+  dictionary_appendatoms(dict_state, SYM(ORDINATE), state->cnt, save->atom_arr);
 
-  sysmem_freeptr(atom_arr);
   return ERR_NONE;
 }
 
@@ -284,17 +130,17 @@ t_my_err _state_dict_load(t_dictionary* dict_state, t_state* state) {
 
   // Get the number of state values from the dictionary
   t_atom_long a_count = 0;
-  dictionary_getlong(dict_state, gensym("count"), &a_count);
+  dictionary_getlong(dict_state, SYM(COUNT), &a_count);
   if ((a_count < 1) || (a_count != state->cnt)) { return ERR_COUNT; }
 
   // Get "name" and "from" from the dictionary
-  dictionary_getsym(dict_state, gensym("name"), &(state->name));
+  dictionary_getsym(dict_state, SYM(NAME), &(state->name));
 
   // Get the "abscissa" and "ordinate" arrays from the dictionary
   t_atom* atom_arr = NULL;
   long a_long;
 
-  dictionary_getatoms(dict_state, gensym("ordinate"), &a_long, &atom_arr);
+  dictionary_getatoms(dict_state, SYM(ORDINATE), &a_long, &atom_arr);
   if (a_long != state->cnt) { return ERR_COUNT; }
   for (t_int32 param = 0; param < state->cnt; param++) { state->A_arr[param] = atom_getfloat(atom_arr + param); }
 
@@ -317,13 +163,15 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
   t_symbol* cmd = atom_getsym(argv);
 
   // Test that the array of states exists
-  MY_ASSERT((cmd != gensym("new")) && (cmd != gensym("rename")) && (cmd != gensym("delete"))
+  MY_ASSERT((cmd != SYM(NEW)) && (cmd != SYM(RENAME)) && (cmd != SYM(DELETE))
     && (!x->state_arr), "state:  No array of states available.");
 
+  switch (sym_id(cmd)) {
+
   // ====  NEW:  Allocate a new array of states  ====
   // state new (int: state count)
 
-  if (cmd == gensym("new")) {
+  case SYM_NEW: {
 
     MY_ASSERT(x->state_arr, "state new:  An array of states already exists.");
     MY_ASSERT(argc != 2, "state new:  2 args expected:  state new (int: array size)");
@@ -332,36 +180,40 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
     t_int32 state_cnt = (t_int32)atom_getlong(argv + 1);
     MY_ASSERT(state_cnt < 1, "state new:  Arg 1:  Value of at least 1 expected for the number of states.");
 
-    x->state_arr = _state_arr_new(state_cnt, &(x->state_cnt), x->out_cnt);
+    x->state_arr = _state_arr_new(state_cnt, &(x->state_cnt), x->core->out_cnt);
     MY_ASSERT(!x->state_arr, "state new:  Failed to allocate an array of states.");
 
     POST("state new:  Array of %i states created.", x->state_cnt);
+    break;
   }
 
   // ====  FREE:  Free the array of states  ====
   // state free
 
-  else if (cmd == gensym("free")) {
+  case SYM_FREE: {
 
     MY_ASSERT(argc != 1, "state free:  1 args expected:  state free");
 
     _state_arr_free(&(x->state_arr), &(x->state_cnt));
 
     POST("state free:  Array of states freed.");
+    break;
   }
 
   // ====  RESIZE:  Resize the array of storage slots  ====
 
-  else if ((cmd == gensym("resize")) && (argc == 3) && (atom_gettype(argv + 2) == A_LONG)) {
-    ;
+  case SYM_RESIZE: {
+    MY_ASSERT((argc != 3) || (atom_gettype(argv + 2) != A_LONG),
+      "state:  Arg 0:  Command expected: new / free / resize / get / post / store / save / load / rename / delete.");
+    break;
   }
 
   // ====  SET:  Set the state values  ====
   // state set (int: state index) (float: [0-1] gain) {x N}
 
-  else if (cmd == gensym("set")) {
+  case SYM_SET: {
 
-    MY_ASSERT(argc != x->out_cnt + 2, "state set:  %i args expected:  state set (int: state index) (float: gain) {x %i}", x->out_cnt + 2, x->out_cnt);
+    MY_ASSERT(argc != x->core->out_cnt + 2, "state set:  %i args expected:  state set (int: state index) (float: gain) {x %i}", x->core->out_cnt + 2, x->core->out_cnt);
 
     // Argument 1 should reference a non empty state
     t_state* state = _state_find(x->state_arr, x->state_cnt, argv + 1);
@@ -376,13 +228,14 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
     // Set the ordinate values and calculate the abscissa values
     for (t_int32 ch = 0; ch < state->cnt; ch++) { state->A_arr[ch] = atom_getfloat(argv + ch + 2); }
-    _state_calc_absc(x, state);
+    _state_calc_absc(x->core, state);
+    break;
   }
 
   // ====  NAME:  Set the state name  ====
   // state name (int: state index) (sym: state name)
 
-  else if (cmd == gensym("name")) {
+  case SYM_NAME: {
 
     MY_ASSERT(argc != 3, "state name:  3 args expected:  state name (int: state index) (sym: state name)");
 
@@ -394,12 +247,13 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
     MY_ASSERT(atom_gettype(argv + 2) != A_SYM, "state name:  Arg 2:  Symbol expected for the name of the state.");
 
     state->name = atom_getsym(argv + 2);
+    break;
   }
 
   // ====  GET:  get information on a state as a message  ====
   // state get (int: state index)
 
-  else if (cmd == gensym("get")) {
+  case SYM_GET: {
 
     MY_ASSERT(argc != 2, "state get:  2 args expected:  state get (int: state index)");
 
@@ -409,28 +263,29 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
     // Output a message with information about the state
     //   state (int: index) (sym: name) (int: count) (float: gain) {x N}
-    t_atom* mess_arr = (t_atom*)sysmem_newptr(sizeof(t_atom)* (x->out_cnt + 3));
-    MY_ASSERT(!mess_arr, "state get:  Allocation failed for the output message array.");
+    t_atom* mess_arr = _diffuse_reply_begin(x);
+    MY_ASSERT(!mess_arr, "state get:  Allocation failed for the reply.");
     t_atom* atom = mess_arr;
 
     atom_setlong(atom++, state - x->state_arr);
     atom_setsym(atom++, state->name);
     atom_setlong(atom++, state->cnt);
-    for (t_int32 ch = 0; ch < x->out_cnt; ch++) { atom_setfloat(atom++, state->A_arr[ch]);  }
+    for (t_int32 ch = 0; ch < x->core->out_cnt; ch++) { atom_setfloat(atom++, state->A_arr[ch]);  }
 
-    outlet_anything(x->outl_mess, gensym("state"), x->out_cnt + 3, mess_arr);
-    sysmem_freeptr(mess_arr);
+    outlet_anything(x->outl_mess, SYM(STATE), x->core->out_cnt + 3, mess_arr);
+    _diffuse_reply_end(x, mess_arr);
+    break;
   }
 
   // ====  POST:  Post information on the array of states  ====
   // state post (int: state index / sym: all)
 
-  else if (cmd == gensym("post")) {
+  case SYM_POST: {
 
     MY_ASSERT(argc != 2, "state post:  2 args expected:  state post (int: state index / sym: all)");
 
     // If Arg 1 is a symbol and equal to "all"
-    if ((atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == gensym("all"))) {
+    if ((atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == SYM(ALL))) {
 
       // Post information on all the states
       POST("The array of states has %i elements.", x->state_cnt);
@@ -460,12 +315,13 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
     // ... Otherwise the arguments are invalid
     else { MY_ASSERT(argc != 2, "state post:  Invalid args:  state post (int: state index / sym: all)"); }
+    break;
   }
 
   // ====  STORE:  Store the values from a channel into a state  ====
   // state store (int: channel index) (int: state index) (sym: state name)
 
-  else if (cmd == gensym("store")) {
+  case SYM_STORE: {
 
     MY_ASSERT(argc != 4, "state store:  4 args expected:  state store (int: channel index) (int: state index) (sym: state name)");
 
@@ -479,18 +335,19 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
     // Argument 3 should hold the name of the state as a symbol
     t_symbol* name = atom_getsym(argv + 3);
-    MY_ASSERT(name == gensym(""), "state store:  Arg 3:  Symbol expected for the name of the state.")
+    MY_ASSERT(name == SYM(EMPTY), "state store:  Arg 3:  Symbol expected for the name of the state.")
 
     t_my_err err = _state_store(x, channel, state, name);
     MY_ASSERT(err != ERR_NONE, "Failed to allocate an array of states.");
 
-    POST("state store:  Channel %i state stored in state %i as \"%s\"", channel - x->channel_arr, state - x->state_arr, state->name->s_name);
+    POST("state store:  Channel %i state stored in state %i as \"%s\"", channel - x->core->channel_arr, state - x->state_arr, state->name->s_name);
+    break;
   }
 
   // ====  SAVE:  Save a state under a new name  ====
   // state save (int: state index) (sym: state name)
 
-  else if (cmd == gensym("save")) {
+  case SYM_SAVE: {
 
     MY_ASSERT(argc != 3, "state save:  3 args expected:  state save (int: state index) (sym: state name)");
 
@@ -499,15 +356,19 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
     MY_ASSERT(!state, "state save:  Arg 1:  State not found.");
     MY_ASSERT(!state->cnt, "state save:  Arg 1:  The state is empty.");
 
-    if (dict_save(x, x->dict_sym, gensym("states"), gensym("state save"), 1, state, argv + 2, _state_dict_save) == ERR_NONE) {
+    t_state_save save = { state, _diffuse_reply_begin(x) };
+    MY_ASSERT(!save.atom_arr, "state save:  Allocation failed for the ordinate values.");
+    if (dict_save(x, x->dict_sym, SYM(STATES), SYM(STATE_SAVE), 1, &save, argv + 2, _state_dict_save) == ERR_NONE) {
       POST("state save:  State %i saved as \"%s\" - Count: %i.", state - x->state_arr, atom_getsym(argv + 2)->s_name, state->cnt);
     }
+    _diffuse_reply_end(x, save.atom_arr);
+    break;
   }
 
   // ====  LOAD:  Load a state  ====
   // state load (sym: state name) (int: state index)
 
-  else if (cmd == gensym("load")) {
+  case SYM_LOAD: {
 
     MY_ASSERT(argc != 3, "state load:  3 args expected:  state load (sym: state name) (int: state index)");
 
@@ -515,118 +376,112 @@ void state_state(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
     t_state* state = _state_find(x->state_arr, x->state_cnt, argv + 2);
     MY_ASSERT(!state, "state load:  Arg 2:  State not found.");
 
-    if (dict_load(x, x->dict_sym, gensym("states"), gensym("state load"), 1, state, argv + 1, _state_dict_load) == ERR_NONE) {
+    if (dict_load(x, x->dict_sym, SYM(STATES), SYM(STATE_LOAD), 1, state, argv + 1, _state_dict_load) == ERR_NONE) {
 
       // Calculate the abscissa values
-      _state_calc_absc(x, state);
+      _state_calc_absc(x->core, state);
       POST("state load:  State \"%s\" loaded into %i - Count: %i.", atom_getsym(argv + 1)->s_name, state - x->state_arr, state->cnt);
     }
+    break;
   }
 
   // ====  DELETE:  Delete a state  ====
   // state delete (sym: state name)
 
-  else if (cmd == gensym("delete")) {
+  case SYM_DELETE: {
 
     MY_ASSERT(argc != 2, "state delete:  2 args expected:  state delete (sym: state name)");
 
-    if (dict_delete(x, x->dict_sym, gensym("states"), gensym("state delete"), 1, argv + 1) == ERR_NONE) {
+    if (dict_delete(x, x->dict_sym, SYM(STATES), SYM(STATE_DELETE), 1, argv + 1) == ERR_NONE) {
       POST("state delete:  State \"%s\" deleted from the dictionary.", atom_getsym(argv + 1)->s_name);
     }
+    break;
   }
 
   // ====  RENAME:  Rename a state  ====
   // state rename (sym: state1 name) (sym: state2 name)
 
-  else if (cmd == gensym("rename")) {
+  case SYM_RENAME: {
 
     MY_ASSERT(argc != 3,
       "state rename:  3 args expected:  state rename (sym: state1 name) (sym: state2 name)");
 
-    if (dict_rename(x, x->dict_sym, gensym("states"), gensym("state rename"), 1, argv + 1, argv + 2) == ERR_NONE) {
+    if (dict_rename(x, x->dict_sym, SYM(STATES), SYM(STATE_RENAME), 1, argv + 1, argv + 2) == ERR_NONE) {
       POST("state rename:  State \"%s\" renamed to \"%s\".", atom_getsym(argv + 1)->s_name, atom_getsym(argv + 2)->s_name);
     }
+    break;
   }
 
   // ====  Otherwise the command is invalid  ====
 
-  else {
+  default:
     MY_ERR("state:  Arg 0:  Command expected: new / free / resize / get / post / store / save / load / rename / delete.");
-  }
-}
-
-// ====  _STATE_RAMP  ====
-
-//******************************************************************************
-//  Ramp a channel to a state
-//  Used by the interface ramping methods
-//
-void _state_ramp(t_diffuse* x, t_channel* channel, t_state* state, t_int32 cntd, t_int32 offset) {
-
-  // Set the countdown
-  channel->cntd = cntd;
-  channel->mode_type = MODE_TYPE_VAR;
-  channel->state_ind = state->index;
-
-  // Set all the target values to the state values
-  t_int32 ch2;
-
-  for (t_int32 ch1 = 0; ch1 < state->cnt; ch1++) {
-    ch2 = (ch1 + offset) % x->out_cnt;
-    channel->U_targ[ch2] = state->U_cur[ch1];
-    channel->A_targ[ch2] = state->A_arr[ch1];
+    break;
   }
 }
 
 // ====  STATE_RAMP_TO  ====
 
 //******************************************************************************
-//  Ramp a channel to a state
-//  ramp_to (int: channel index) (int: state index) (float: time in ms) (sym: ramp or xfade)
+//  Ramp a channel, or several channels with the same time and function, to a state
+//  ramp_to (int: channel index / channels) (int: state index) (float: time in ms) (sym: ramp or xfade)
+//  The channels are selected with:  all / range (int: first) (int: count) / list (int: count) (int: index) {x count}
 //
 void state_ramp_to(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   TRACE("state_ramp_to");
 
-  // The method expects three arguments
-  MY_ASSERT(argc != 4, "ramp_to:  4 args expected:  ramp_to (int: channel index) (int: state index) (float: time in ms) (sym: ramp or xfade)");
+  // The first arguments should select the channels
+  t_int32 sel_len = _channel_select(x, argc, argv);
+  MY_ASSERT(!sel_len, "ramp_to:  Arg 0:  Channel not found, or invalid selection: all / range (int: first) (int: count) / list (int: count) (int: index) {x count}.");
 
-  // Argument 0 should reference a channel
-  t_channel* channel = _channel_find(x, argv);
-  MY_ASSERT(!channel, "ramp_to:  Arg 0:  Channel not found.");
+  // The method expects three more arguments
+  MY_ASSERT(argc != sel_len + 3, "ramp_to:  Expects:  ramp_to (int: channel index / channels) (int: state index) (float: time in ms) (sym: ramp or xfade)");
+  argv += sel_len;
 
   // Argument 1 should reference a state
-  t_state* state = _state_find(x->state_arr, x->state_cnt, argv + 1);
-  MY_ASSERT(!state, "ramp_to:  Arg 1:  State not found.");
+  t_state* state = _state_find(x->state_arr, x->state_cnt, argv);
+  MY_ASSERT(!state, "ramp_to:  Arg %i:  State not found.", sel_len);
 
   // Argument 2 should be a positive float: the time in ms
-  MY_ASSERT((atom_gettype(argv + 2) != A_FLOAT) && (atom_gettype(argv + 2) != A_LONG),
-    "ramp_to:  Arg 2:  Positive float expected: time in ms.");
+  MY_ASSERT((atom_gettype(argv + 1) != A_FLOAT) && (atom_gettype(argv + 1) != A_LONG),
+    "ramp_to:  Arg %i:  Positive float expected: time in ms.", sel_len + 1);
 
-  t_double time = atom_getfloat(argv + 2);
-  MY_ASSERT(time <= 0, "ramp_to:  Arg 2:  Positive float expected: time in ms.");
+  t_double time = atom_getfloat(argv + 1);
+  MY_ASSERT(time <= 0, "ramp_to:  Arg %i:  Positive float expected: time in ms.", sel_len + 1);
 
   // Argument 3 should be "ramp" or "xfade"
-  t_symbol* interp_type = atom_getsym(argv + 3);
+  t_symbol* interp_type = atom_getsym(argv + 2);
 
-  if (interp_type == gensym("ramp")) {
+  t_interp_type type = INTERP_TYPE_RAMP;
+
+  if (interp_type == SYM(RAMP)) {
     state->U_cur = state->U_rm_arr;
-    channel->interp_func = x->ramp_func;
-    channel->interp_inv_func = x->ramp_inv_func;
-    channel->interp_param = x->ramp_param;
+    type = INTERP_TYPE_RAMP;
   }
 
-  else if (interp_type == gensym("xfade")) {
+  else if (interp_type == SYM(XFADE)) {
     state->U_cur = state->U_xf_arr;
-    channel->interp_func = x->xfade_func;
-    channel->interp_inv_func = x->xfade_inv_func;
-    channel->interp_param = x->xfade_param;
+    type = INTERP_TYPE_XFADE;
   }
 
-  else { MY_ASSERT(1, "ramp_to:  Arg 3:  \"ramp\" or \"xfade\" expected."); }
+  else { MY_ASSERT(1, "ramp_to:  Arg %i:  \"ramp\" or \"xfade\" expected.", sel_len + 2); }
+
+  // Post the channel ramping values, in one batch applied at the start of the same vector
+  t_my_err err = ERR_NONE;
+
+  _diffuse_post_lock(x);
+  core_post_begin(x->core);
+
+  for (t_int32 ind = 0; (ind < x->sel_cnt) && (err == ERR_NONE); ind++) {
+    err = core_post_ramp(x->core, x->sel_arr[ind], type, state, (t_int32)(time * x->core->msr), 0);
+  }
 
-  // Set the channel ramping values
-  _state_ramp(x, channel, state, (t_int32)(time * x->msr), 0);
+  if (err == ERR_NONE) { core_post_end(x->core); }
+  else { core_post_cancel(x->core); }
+  _diffuse_post_unlock(x);
+
+  MY_ASSERT(err != ERR_NONE, "ramp_to:  The command queue is full, the message is dropped.");
 }
 
 // ====  STATE_RAMP_BETWEEN  ====
@@ -672,31 +527,33 @@ void state_ramp_between(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv)
   // Argument 5 should be "ramp" or "xfade"
   t_symbol* interp_type = atom_getsym(argv + 5);
 
-  if (interp_type == gensym("ramp")) {
+  t_interp_type type = INTERP_TYPE_RAMP;
+
+  if (interp_type == SYM(RAMP)) {
     state1->U_cur = state1->U_rm_arr;
     state2->U_cur = state2->U_rm_arr;
-    channel->interp_func = x->ramp_func;
-    channel->interp_inv_func = x->ramp_inv_func;
-    channel->interp_param = x->ramp_param;
+    type = INTERP_TYPE_RAMP;
   }
 
-  else if (interp_type == gensym("xfade")) {
+  else if (interp_type == SYM(XFADE)) {
     state1->U_cur = state1->U_xf_arr;
     state2->U_cur = state2->U_xf_arr;
-    channel->interp_func = x->xfade_func;
-    channel->interp_inv_func = x->xfade_inv_func;
-    channel->interp_param = x->xfade_param;
+    type = INTERP_TYPE_XFADE;
   }
 
   else { MY_ASSERT(1, "ramp_between:  Arg 5:  \"ramp\" or \"xfade\" expected."); }
 
-  // Calculate the interpolated values from the abscissa
-  for (t_int32 ch = 0; ch < channel->out_cnt; ch++) {
+  // Calculate the interpolated values from the abscissa, with the function the channel will use
+  _diffuse_post_lock(x);
+  for (t_int32 ch = 0; ch < x->core->out_cnt; ch++) {
     x->state_tmp->U_cur[ch] = state1->U_cur[ch] + interp * (state2->U_cur[ch] - state1->U_cur[ch]);
-    x->state_tmp->A_arr[ch] = channel->interp_func(x->state_tmp->U_cur[ch], channel->interp_param);
   }
+  _core_interp_arr(x->core, type, x->state_tmp->A_arr, x->state_tmp->U_cur, x->core->out_cnt);
 
-  _state_ramp(x, channel, x->state_tmp, (t_int32)(time * x->msr), 0);
+  t_my_err err = core_post_ramp(x->core, (t_int32)(channel - x->core->channel_arr), type, x->state_tmp,
+    (t_int32)(time * x->core->msr), 0);
+  _diffuse_post_unlock(x);
+  MY_ASSERT(err != ERR_NONE, "ramp_between:  The command queue is full, the message is dropped.");
 }
 
 // ====  STATE_RAMP_MAX  ====
@@ -727,18 +584,10 @@ void state_ramp_max(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
   // The last argument should be "ramp" or "xfade"
   t_symbol* interp_type = atom_getsym(argv + argc - 1);
 
-  if (interp_type == gensym("ramp")) {
-    channel->interp_func = x->ramp_func;
-    channel->interp_inv_func = x->ramp_inv_func;
-    channel->interp_param = x->ramp_param;
-  }
-
-  else if (interp_type == gensym("xfade")) {
-    channel->interp_func = x->xfade_func;
-    channel->interp_inv_func = x->xfade_inv_func;
-    channel->interp_param = x->xfade_param;
-  }
+  t_interp_type type = INTERP_TYPE_RAMP;
 
+  if (interp_type == SYM(RAMP)) { type = INTERP_TYPE_RAMP; }
+  else if (interp_type == SYM(XFADE)) { type = INTERP_TYPE_XFADE; }
   else { MY_ASSERT(1, "ramp_max:  Arg %i:  \"ramp\" or \"xfade\" expected.", argc - 1); }
 
   // The arguments from the second one should be [int, float] pairs
@@ -747,7 +596,7 @@ void state_ramp_max(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
   t_state* state = NULL;
   t_double interp;
 
-  for (t_int32 res = 0; res < channel->out_cnt; res++) { x->state_tmp->U_cur[res] = 0; }
+  for (t_int32 res = 0; res < x->core->out_cnt; res++) { x->state_tmp->U_cur[res] = 0; }
 
   while (state_cnt--) {
 
@@ -764,20 +613,22 @@ void state_ramp_max(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
       "ramp_max:  Arg:  Float [0-1] expected: interpolation between 0 and state");
 
     // Set which array to use: ramping or crossfading
-    state->U_cur = (interp_type == gensym("ramp")) ? state->U_rm_arr : state->U_xf_arr;
+    state->U_cur = (interp_type == SYM(RAMP)) ? state->U_rm_arr : state->U_xf_arr;
 
     // Calculate the interpolated values and take the maximum
-    for (t_int32 ch = 0; ch < channel->out_cnt; ch++) {
+    for (t_int32 ch = 0; ch < x->core->out_cnt; ch++) {
       x->state_tmp->U_cur[ch] = MAX(interp * state->U_cur[ch], x->state_tmp->U_cur[ch]);
     }
   }
 
-  // Calculate the ordinate values
-  for (t_int32 ch = 0; ch < channel->out_cnt; ch++) {
-    x->state_tmp->A_arr[ch] = channel->interp_func(x->state_tmp->U_cur[ch], x->ramp_param);
-  }
+  // Calculate the ordinate values, with the function the channel will use
+  _diffuse_post_lock(x);
+  _core_interp_arr(x->core, type, x->state_tmp->A_arr, x->state_tmp->U_cur, x->core->out_cnt);
 
-  _state_ramp(x, channel, x->state_tmp, (t_int32)(time * x->msr), 0);
+  t_my_err err = core_post_ramp(x->core, (t_int32)(channel - x->core->channel_arr), type, x->state_tmp,
+    (t_int32)(time * x->core->msr), 0);
+  _diffuse_post_unlock(x);
+  MY_ASSERT(err != ERR_NONE, "ramp_max:  The command queue is full, the message is dropped.");
 }
 
 // ====  STATE_CIRCULAR  ====
@@ -801,7 +652,7 @@ void state_circular(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
   // Argument 1 should reference the number of input channels to permutate
   MY_ASSERT(atom_gettype(argv + 1) != A_LONG, "circular:  Arg 1:  Int expected: number of input channels to permutate.");
   t_int32 ch_cnt = (t_int32)atom_getlong(argv + 1);
-  MY_ASSERT(((ch_cnt < 1) || ((t_int32)(channel - x->channel_arr) + ch_cnt > x->channel_cnt)),
+  MY_ASSERT(((ch_cnt < 1) || ((t_int32)(channel - x->core->channel_arr) + ch_cnt > x->core->channel_cnt)),
     "circular:  Arg 1:  Invalid value: number of input channels to permutate.");
 
   // Argument 2 should reference a state
@@ -823,52 +674,62 @@ void state_circular(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
   // Calculate the integer and fractional parts for the circular interpolation
   t_int32 offset = (t_int32)floor(interp);
   interp -= offset;
-  offset = (offset < 0) ? (offset % x->out_cnt) + 8 : (offset % x->out_cnt);
+  offset = (offset < 0) ? (offset % x->core->out_cnt) + 8 : (offset % x->core->out_cnt);
   POST("CIRC %i %f", offset, interp);
 
   state->U_cur = state->U_xf_arr;
 
   // Loop over the state values
-  for (t_int32 ch = 0; ch < x->out_cnt; ch++) {
-    x->state_tmp->U_cur[ch] = state->U_cur[ch] + interp * (state->U_cur[(ch + x->out_cnt - 1) % x->out_cnt] - state->U_cur[ch]);
-    x->state_tmp->A_arr[ch] = x->xfade_func(x->state_tmp->U_cur[ch], x->xfade_param);
+  _diffuse_post_lock(x);
+  for (t_int32 ch = 0; ch < x->core->out_cnt; ch++) {
+    x->state_tmp->U_cur[ch] = state->U_cur[ch] + interp * (state->U_cur[(ch + x->core->out_cnt - 1) % x->core->out_cnt] - state->U_cur[ch]);
   }
+  _core_interp_arr(x->core, INTERP_TYPE_XFADE, x->state_tmp->A_arr, x->state_tmp->U_cur, x->core->out_cnt);
+
+  // Loop over the imput channels, in one batch applied at the start of the same vector
+  t_my_err err = ERR_NONE;
+  core_post_begin(x->core);
 
-  // Loop over the imput channels
-  for (t_int32 inp = 0; inp < ch_cnt; inp++) {
-    (channel + inp)->interp_func = x->xfade_func;
-    (channel + inp)->interp_inv_func = x->xfade_inv_func;
-    (channel + inp)->interp_param = x->xfade_param;
-    _state_ramp(x, channel + inp, x->state_tmp, (t_int32)(time * x->msr), offset + inp);
+  for (t_int32 inp = 0; (inp < ch_cnt) && (err == ERR_NONE); inp++) {
+    err = core_post_ramp(x->core, (t_int32)(channel - x->core->channel_arr) + inp, INTERP_TYPE_XFADE,
+      x->state_tmp, (t_int32)(time * x->core->msr), offset + inp);
   }
+
+  if (err == ERR_NONE) { core_post_end(x->core); }
+  else { core_post_cancel(x->core); }
+  _diffuse_post_unlock(x);
+
+  MY_ASSERT(err != ERR_NONE, "circular:  The command queue is full, the message is dropped.");
 }
 
 // ====  STATE_VELOCITY  ====
 
 //******************************************************************************
-//  Set the ramping velocity for a channel:
-//  velocity (int: channel index) (float: velocity)
+//  Set the ramping velocity for a channel, or several channels:
+//  velocity (int: channel index / channels) (float: velocity)
+//  The channels are selected with:  all / range (int: first) (int: count) / list (int: count) (int: index) {x count}
 //
 void state_velocity(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   TRACE("state_velocity");
 
-  // The method expects two arguments
-  MY_ASSERT(argc != 2, "velocity:  2 args expected:  velocity (int: channel index) (float: velocity)");
+  // The first arguments should select the channels
+  t_int32 sel_len = _channel_select(x, argc, argv);
+  MY_ASSERT(!sel_len, "velocity:  Arg 0:  Channel not found, or invalid selection: all / range (int: first) (int: count) / list (int: count) (int: index) {x count}.");
 
-  // Argument 0 should reference a channel
-  t_channel* channel = _channel_find(x, argv);
-  MY_ASSERT(!channel, "velocity:  Arg 0:  Channel not found.");
+  // The method expects one more argument
+  MY_ASSERT(argc != sel_len + 1, "velocity:  Expects:  velocity (int: channel index / channels) (float: velocity)");
 
-  // Argument 1 should be a float or int, for the velocity
-  MY_ASSERT((atom_gettype(argv + 1) != A_FLOAT) && (atom_gettype(argv + 1) != A_LONG),
-    "velocity:  Arg 1:  Positive float expected.");
+  // The last argument should be a float or int, for the velocity
+  MY_ASSERT((atom_gettype(argv + sel_len) != A_FLOAT) && (atom_gettype(argv + sel_len) != A_LONG),
+    "velocity:  Arg %i:  Positive float expected.", sel_len);
 
   // The velocity should be positive
-  t_double velocity = atom_getfloat(argv + 1);
-  MY_ASSERT(velocity < 0, "velocity:  Arg 1:  Positive float expected.");
+  t_double velocity = atom_getfloat(argv + sel_len);
+  MY_ASSERT(velocity < 0, "velocity:  Arg %i:  Positive float expected.", sel_len);
 
-  channel->velocity = velocity;
+  MY_ASSERT(_channel_post_sel(x, CMD_VELOCITY, 0, velocity) != ERR_NONE,
+    "velocity:  The command queue is full, the message is dropped.");
 }
 
 // ====  STATE_VELOCITY_ALL  ====
@@ -885,33 +746,37 @@ void state_velocity_all(t_diffuse* x, double velocity) {
   MY_ASSERT(velocity < 0, "velocity_all:  Arg 0:  Positive float expected.");
 
   // Set the velocity for all channels
-  t_channel* channel = x->channel_arr + x->channel_cnt;
-  do { channel--; channel->velocity = velocity; } while (channel != x->channel_arr);
+  _diffuse_post_lock(x);
+  t_my_err err = core_post(x->core, CMD_VELOCITY, -1, 0, velocity, 0);
+  _diffuse_post_unlock(x);
+  MY_ASSERT(err != ERR_NONE, "velocity_all:  The command queue is full, the message is dropped.");
 }
 
 // ====  STATE_FREEZE  ====
 
 //******************************************************************************
-//  Freeze or unfreeze a channel:
-//  freeze (int: channel index) (int: 0 or 1)
+//  Freeze or unfreeze a channel, or several channels:
+//  freeze (int: channel index / channels) (int: 0 or 1)
+//  The channels are selected with:  all / range (int: first) (int: count) / list (int: count) (int: index) {x count}
 //
 void state_freeze(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   TRACE("state_freeze");
 
-  // The method expects two arguments
-  MY_ASSERT(argc != 2, "freeze:  2 args expected:  freeze (int: channel index) (int: 0 or 1)");
+  // The first arguments should select the channels
+  t_int32 sel_len = _channel_select(x, argc, argv);
+  MY_ASSERT(!sel_len, "freeze:  Arg 0:  Channel not found, or invalid selection: all / range (int: first) (int: count) / list (int: count) (int: index) {x count}.");
 
-  // Argument 0 should reference a channel
-  t_channel* channel = _channel_find(x, argv);
-  MY_ASSERT(!channel, "freeze:  Arg 0:  Channel not found.");
+  // The method expects one more argument
+  MY_ASSERT(argc != sel_len + 1, "freeze:  Expects:  freeze (int: channel index / channels) (int: 0 or 1)");
 
-  // Argument 1 should be 0 or 1
-  MY_ASSERT(atom_gettype(argv + 1) != A_LONG, "freeze:  Arg 1:  0 or 1 expected to freeze or unfreeze the state.");
-  t_int32 is_frozen = (t_int32)(atom_getlong(argv + 1));
-  MY_ASSERT((is_frozen != 0) && (is_frozen != 1), "freeze:  Arg 1:  0 or 1 expected to freeze or unfreeze the state.");
+  // The last argument should be 0 or 1
+  MY_ASSERT(atom_gettype(argv + sel_len) != A_LONG, "freeze:  Arg %i:  0 or 1 expected to freeze or unfreeze the state.", sel_len);
+  t_int32 is_frozen = (t_int32)(atom_getlong(argv + sel_len));
+  MY_ASSERT((is_frozen != 0) && (is_frozen != 1), "freeze:  Arg %i:  0 or 1 expected to freeze or unfreeze the state.", sel_len);
 
-  channel->is_frozen = (is_frozen == 1) ? true : false;
+  MY_ASSERT(_channel_post_sel(x, CMD_FREEZE, is_frozen, 0) != ERR_NONE,
+    "freeze:  The command queue is full, the message is dropped.");
 }
 
 // ====  STATE_FREEZE_ALL  ====
@@ -928,7 +793,8 @@ void state_freeze_all(t_diffuse* x, long is_frozen) {
   MY_ASSERT((is_frozen != 0) && (is_frozen != 1), "freeze_all:  Arg 0:  0 or 1 expected to freeze or unfreeze the state.");
 
   // Freeze or unfreeze all the channels
-  t_bool b = (is_frozen == 1) ? true : false;
-  t_channel* channel = x->channel_arr + x->channel_cnt;
-  do { channel--; channel->is_frozen = b; } while (channel != x->channel_arr);
+  _diffuse_post_lock(x);
+  t_my_err err = core_post(x->core, CMD_FREEZE, -1, (t_int32)is_frozen, 0, 0);
+  _diffuse_post_unlock(x);
+  MY_ASSERT(err != ERR_NONE, "freeze_all:  The command queue is full, the message is dropped.");
 }
@@ -0,0 +1,371 @@
+#include "diffuse_workers.h"
+#include "core_atomic.h"
+
+// The helpers spin for a bounded time after a job, then sleep until the next one:
+// on a futex on Linux, on WaitOnAddress on Windows, and in short sleeps elsewhere.
+// The audio thread only wakes them with a system call when at least one is asleep.
+// While it waits for the tasks in progress, it spins for a bounded time too, then yields
+// so that a helper that was preempted can complete on a machine with fewer cores than threads.
+//
+// The audio thread waits on the helpers, so they run at its priority, or lower priority threads
+// could preempt them in the middle of a task and make it late:
+// on Windows they join the "Pro Audio" MMCSS task, or are time critical if that fails.
+// Elsewhere the pool is created from the main thread, so the first job run from a thread
+// copies its scheduling to the helpers: the policy and priority, and on macOS its time constraints.
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <avrt.h>
+#pragma comment(lib, "Synchronization.lib")
+#pragma comment(lib, "Avrt.lib")
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#if defined(__APPLE__)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <emmintrin.h>
+#define WORKERS_PAUSE()  _mm_pause()
+#else
+#define WORKERS_PAUSE()  ((void)0)
+#endif
+
+// ========  STRUCTURES  ========
+
+typedef struct _helper {
+
+  t_workers* workers;
+  t_int32    index;     // Index of the thread, from 1
+
+#if defined(_WIN32)
+  HANDLE     handle;
+#else
+  pthread_t  handle;
+#endif
+  t_bool     is_started;
+
+} t_helper;
+
+struct _workers {
+
+  t_int32   thread_cnt;       // Number of threads, including the calling thread
+  t_helper  helper_arr[WORKERS_THREAD_MAX];
+
+  // The job: written by the calling thread before the generation is published
+  t_worker_task func;
+  void*     arg;
+
+  // The state shared with the helpers
+  volatile int32_t gen;       // Generation of the current job, incremented to start a job
+  volatile int64_t next;      // Next task to claim:  gen << 32 | task_cnt << 16 | task
+  volatile int32_t done_cnt;  // Number of tasks of the current job completed
+  volatile int32_t sleep_cnt; // Number of helpers asleep on gen
+  volatile int32_t is_quit;   // Set to stop the helpers
+
+  // The thread whose scheduling the helpers have, only used by the calling thread
+#if !defined(_WIN32)
+  pthread_t caller;
+  t_bool    is_caller;
+#endif
+};
+
+#define WORKERS_NEXT(gen, cnt, task)  (((int64_t)(uint32_t)(gen) << 32) | ((int64_t)(cnt) << 16) | (int64_t)(task))
+
+// ========  FUNCTIONS  ========
+
+// ====  _WORKERS_SLEEP, _WORKERS_WAKE and _WORKERS_YIELD  ====
+
+//******************************************************************************
+//  Sleep while the generation is still gen, or return early.
+//
+static void _workers_sleep(t_workers* workers, int32_t gen) {
+
+#if defined(_WIN32)
+  WaitOnAddress((volatile VOID*)&workers->gen, &gen, sizeof(gen), INFINITE);
+#elif defined(__linux__)
+  syscall(SYS_futex, &workers->gen, FUTEX_WAIT_PRIVATE, gen, NULL, NULL, 0);
+#else
+  struct timespec ts = { 0, 50000 };
+  nanosleep(&ts, NULL);
+#endif
+}
+
+static void _workers_wake(t_workers* workers) {
+
+#if defined(_WIN32)
+  WakeByAddressAll((PVOID)&workers->gen);
+#elif defined(__linux__)
+  syscall(SYS_futex, &workers->gen, FUTEX_WAKE_PRIVATE, WORKERS_THREAD_MAX, NULL, NULL, 0);
+#else
+  (void)workers;
+#endif
+}
+
+static void _workers_yield(void) {
+
+#if defined(_WIN32)
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+// ====  _WORKERS_PRIORITY and _WORKERS_MATCH  ====
+
+//******************************************************************************
+//  Raise the priority of the calling helper to that of audio threads, on Windows.
+//  Returns the MMCSS handle to revert when the helper stops, or NULL.
+//
+#if defined(_WIN32)
+static HANDLE _workers_priority(void) {
+
+  DWORD task_index = 0;
+  HANDLE mmcss = AvSetMmThreadCharacteristicsW(L"Pro Audio", &task_index);
+  if (mmcss) { AvSetMmThreadPriority(mmcss, AVRT_PRIORITY_HIGH); }
+  else { SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL); }
+  return mmcss;
+}
+#endif
+
+//******************************************************************************
+//  Give the helpers the scheduling of the calling thread, if it is not the one they already have.
+//  A few system calls the first time a thread runs a job, then only a comparison of thread ids.
+//  The helpers keep their scheduling if the system refuses it, for instance without the permission
+//  to use a real time policy.
+//
+static void _workers_match(t_workers* workers) {
+
+#if defined(_WIN32)
+  (void)workers;
+#else
+  pthread_t self = pthread_self();
+  if (workers->is_caller && pthread_equal(workers->caller, self)) { return; }
+  workers->caller = self;
+  workers->is_caller = true;
+
+  int policy;
+  struct sched_param param;
+  if (pthread_getschedparam(self, &policy, &param) != 0) { return; }
+
+#if defined(__APPLE__)
+  thread_time_constraint_policy_data_t constraint;
+  mach_msg_type_number_t count = THREAD_TIME_CONSTRAINT_POLICY_COUNT;
+  boolean_t is_default = true;
+  t_bool is_constraint = (thread_policy_get(pthread_mach_thread_np(self), THREAD_TIME_CONSTRAINT_POLICY,
+    (thread_policy_t)&constraint, &count, &is_default) == KERN_SUCCESS) && !is_default;
+#endif
+
+  for (t_int32 th = 1; th < workers->thread_cnt; th++) {
+
+    t_helper* helper = workers->helper_arr + th;
+    pthread_setschedparam(helper->handle, policy, &param);
+
+#if defined(__APPLE__)
+    if (is_constraint) {
+      thread_policy_set(pthread_mach_thread_np(helper->handle), THREAD_TIME_CONSTRAINT_POLICY,
+        (thread_policy_t)&constraint, THREAD_TIME_CONSTRAINT_POLICY_COUNT);
+    }
+#endif
+  }
+#endif
+}
+
+// ====  _WORKERS_CLAIM  ====
+
+//******************************************************************************
+//  Claim and run the tasks of the job of generation gen, until there are none left.
+//  The generation and the number of tasks are packed with the counter, so that a helper
+//  waking up late cannot claim a task of a later job with the function of an earlier one.
+//
+static void _workers_claim(t_workers* workers, int32_t gen, t_int32 thread) {
+
+  for (;;) {
+
+    int64_t next = core_atomic_load64(&workers->next);
+    t_int32 task = (t_int32)(next & 0xFFFF);
+    t_int32 task_cnt = (t_int32)((next >> 16) & 0xFFFF);
+
+    if (((int32_t)(next >> 32) != gen) || (task >= task_cnt)) { return; }
+    if (!core_atomic_cas64(&workers->next, next, next + 1)) { continue; }
+
+    workers->func(workers->arg, task, thread);
+    core_atomic_add(&workers->done_cnt, 1);
+  }
+}
+
+// ====  _WORKERS_LOOP  ====
+
+#if defined(_WIN32)
+static DWORD WINAPI _workers_loop(LPVOID param) {
+#else
+static void* _workers_loop(void* param) {
+#endif
+
+  t_helper* helper = (t_helper*)param;
+  t_workers* workers = helper->workers;
+
+#if defined(_WIN32)
+  HANDLE mmcss = _workers_priority();
+#endif
+
+  // The generation when the pool was started, not when the thread starts running:
+  // a job or the quit signal may already have been published
+  int32_t gen = 0;
+
+  for (;;) {
+
+    // Spin for a while, then sleep until the generation changes
+    t_int32 spin = 0;
+    while ((core_atomic_load(&workers->gen) == gen) && (spin < WORKERS_SPIN_CNT)) { WORKERS_PAUSE(); spin++; }
+
+    while (core_atomic_load(&workers->gen) == gen) {
+      core_atomic_add(&workers->sleep_cnt, 1);
+      if (core_atomic_load(&workers->gen) == gen) { _workers_sleep(workers, gen); }
+      core_atomic_add(&workers->sleep_cnt, -1);
+    }
+
+    if (core_atomic_load(&workers->is_quit)) { break; }
+
+    gen = core_atomic_load(&workers->gen);
+    _workers_claim(workers, gen, helper->index);
+  }
+
+#if defined(_WIN32)
+  if (mmcss) { AvRevertMmThreadCharacteristics(mmcss); }
+  return 0;
+#else
+  return NULL;
+#endif
+}
+
+// ====  WORKERS_NEW  ====
+
+//******************************************************************************
+//  Start a pool of thread_cnt - 1 helper threads.
+//  t_int32 thread_cnt:  The number of threads including the calling thread, clipped to WORKERS_THREAD_MAX
+//  Returns the pool, or NULL if it could not be started.
+//
+t_workers* workers_new(t_int32 thread_cnt) {
+
+  t_workers* workers = (t_workers*)CORE_NEWPTR(sizeof(t_workers));
+  if (!workers) { return NULL; }
+
+  workers->thread_cnt = MAX(1, MIN(thread_cnt, WORKERS_THREAD_MAX));
+  workers->func = NULL;
+  workers->arg = NULL;
+  workers->gen = 0;
+  workers->next = WORKERS_NEXT(0, 0, 0);
+  workers->done_cnt = 0;
+  workers->sleep_cnt = 0;
+  workers->is_quit = 0;
+#if !defined(_WIN32)
+  workers->is_caller = false;
+#endif
+
+  for (t_int32 th = 1; th < workers->thread_cnt; th++) {
+
+    t_helper* helper = workers->helper_arr + th;
+    helper->workers = workers;
+    helper->index = th;
+
+#if defined(_WIN32)
+    helper->handle = CreateThread(NULL, 0, _workers_loop, helper, 0, NULL);
+    helper->is_started = (helper->handle != NULL);
+#else
+    helper->is_started = (pthread_create(&helper->handle, NULL, _workers_loop, helper) == 0);
+#endif
+
+    if (!helper->is_started) { workers->thread_cnt = th; break; }
+  }
+
+  return workers;
+}
+
+// ====  WORKERS_FREE  ====
+
+//******************************************************************************
+//  Stop and join the helper threads, and free the pool.
+//
+void workers_free(t_workers* workers) {
+
+  if (!workers) { return; }
+
+  core_atomic_store(&workers->is_quit, 1);
+  core_atomic_add(&workers->gen, 1);
+  _workers_wake(workers);
+
+  for (t_int32 th = 1; th < workers->thread_cnt; th++) {
+
+    t_helper* helper = workers->helper_arr + th;
+    if (!helper->is_started) { continue; }
+
+#if defined(_WIN32)
+    WaitForSingleObject(helper->handle, INFINITE);
+    CloseHandle(helper->handle);
+#else
+    pthread_join(helper->handle, NULL);
+#endif
+  }
+
+  CORE_FREEPTR(workers);
+}
+
+// ====  WORKERS_RUN  ====
+
+//******************************************************************************
+//  Run a job on the pool and return when all its tasks are completed.
+//  The calling thread runs tasks too, with the thread index 0.
+//  Only one thread can call workers_run at a time.
+//  Once no task is left to claim, the calling thread waits for the tasks in progress on the helpers,
+//  with no time limit: a task is never abandoned, since the job reads its results.
+//  It spins for WORKERS_SPIN_CNT polls, then yields its time slice on each poll,
+//  so that a helper preempted on the same core can complete its task.
+//  The wait is as long as the longest task as long as no helper is preempted. The helpers run
+//  at the priority of the calling thread, so only threads of the same or a higher priority preempt them,
+//  or too few cores: then the vector is late and the audio may drop out, but the wait still ends.
+//  t_worker_task func:  The function running one task
+//  void* arg:  Passed to func
+//  t_int32 task_cnt:  The number of tasks, at most WORKERS_TASK_MAX
+//
+void workers_run(t_workers* workers, t_worker_task func, void* arg, t_int32 task_cnt) {
+
+  task_cnt = MIN(task_cnt, WORKERS_TASK_MAX);
+
+  // Without helpers run all the tasks directly
+  if (workers->thread_cnt == 1) {
+    for (t_int32 task = 0; task < task_cnt; task++) { func(arg, task, 0); }
+    return;
+  }
+
+  _workers_match(workers);
+
+  // Publish the job: the previous one is completed, so no helper is reading it
+  int32_t gen = workers->gen + 1;
+  workers->func = func;
+  workers->arg = arg;
+  core_atomic_store(&workers->done_cnt, 0);
+  core_atomic_store64(&workers->next, WORKERS_NEXT(gen, task_cnt, 0));
+  core_atomic_store(&workers->gen, gen);
+
+  if (core_atomic_load(&workers->sleep_cnt) > 0) { _workers_wake(workers); }
+
+  // Claim tasks alongside the helpers, then wait for the ones in progress
+  _workers_claim(workers, gen, 0);
+
+  // No upper bound: see above
+  t_int32 spin = 0;
+  while (core_atomic_load(&workers->done_cnt) < task_cnt) {
+    if (spin < WORKERS_SPIN_CNT) { WORKERS_PAUSE(); spin++; }
+    else { _workers_yield(); }
+  }
+}
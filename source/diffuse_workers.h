@@ -0,0 +1,39 @@
+#ifndef YC_DIFFUSE_WORKERS_H_
+#define YC_DIFFUSE_WORKERS_H_
+
+// ========  HEADER FILE FOR THE WORKER POOL  ========
+// Helper threads that run the tasks of a job together with the calling thread.
+// The tasks are claimed one at a time from a shared counter. The calling thread claims tasks too,
+// so it never waits for a helper that has not woken up: it only waits for the tasks already in progress.
+
+// ========  INCLUDES  ========
+
+#include "core_types.h"
+
+// ========  DEFINES  ========
+
+#define WORKERS_THREAD_MAX  16      // Maximum number of threads, including the calling thread
+#define WORKERS_TASK_MAX    65535   // Maximum number of tasks in a job
+#define WORKERS_SPIN_CNT    4096    // Number of polls a helper spins for before sleeping until the next job
+
+// ========  TYPEDEF  ========
+
+//******************************************************************************
+//  Function running one task of a job.
+//  void* arg:  The argument of the job
+//  t_int32 task:  The index of the task, from 0 to task_cnt - 1
+//  t_int32 thread:  The index of the thread running it, 0 for the calling thread
+//
+typedef void (*t_worker_task)(void* arg, t_int32 task, t_int32 thread);
+
+typedef struct _workers t_workers;
+
+// ========  FUNCTION DECLARATIONS  ========
+
+t_workers* workers_new  (t_int32 thread_cnt);
+void       workers_free (t_workers* workers);
+void       workers_run  (t_workers* workers, t_worker_task func, void* arg, t_int32 task_cnt);
+
+// ========  END OF HEADER FILE  ========
+
+#endif
@@ -6,11 +6,6 @@
 //  @ingroup myExternals
 //
 
-// TO DO:
-// Detect empty signal vectors and skip processing.
-// Create safe and safe ramping functions (type checking... vs speed)
-
-
 // ========  HEADER FILES  ========
 
 #include "diffuse~.h"
@@ -19,17 +14,85 @@
 
 static t_class* diffuse_class = NULL;
 
+t_symbol* sym_arr[SYM_CNT];
+
+static const char* sym_name_arr[SYM_CNT] = {
+  [SYM_EMPTY]        = "",
+  [SYM_NULL]         = "null",
+  [SYM_DSP_ADD64]    = "dsp_add64",
+  [SYM_DIFFUSE]      = "diffuse",
+  [SYM_STATS]        = "stats",
+  [SYM_OUTPUT]       = "output",
+  [SYM_CHANNEL]      = "channel",
+  [SYM_STATE]        = "state",
+  [SYM_END_RAMP]     = "end_ramp",
+  [SYM_END_RAMPS]    = "end_ramps",
+  [SYM_ON]           = "on",
+  [SYM_OFF]          = "off",
+  [SYM_FROZEN]       = "frozen",
+  [SYM_ACTIVE]       = "active",
+  [SYM_ALL]          = "all",
+  [SYM_DB]           = "db",
+  [SYM_AMPL]         = "ampl",
+  [SYM_RAMP]         = "ramp",
+  [SYM_XFADE]        = "xfade",
+  [SYM_TABLE]        = "table",
+  [SYM_LINEAR]       = "linear",
+  [SYM_SPLINE]       = "spline",
+  [SYM_POLY]         = "poly",
+  [SYM_EXP]          = "exp",
+  [SYM_SIGMOID]      = "sigmoid",
+  [SYM_SQRT]         = "sqrt",
+  [SYM_SINUS]        = "sinus",
+  [SYM_LUT]          = "lut",
+  [SYM_SILENCE]      = "silence",
+  [SYM_SMOOTH]       = "smooth",
+  [SYM_CONTROL_RATE] = "control_rate",
+  [SYM_EXACT]        = "exact",
+  [SYM_THREADS]      = "threads",
+  [SYM_END_MERGE]    = "end_merge",
+  [SYM_SET]          = "set",
+  [SYM_GET]          = "get",
+  [SYM_POST]         = "post",
+  [SYM_CURRENT]      = "current",
+  [SYM_MATRIX]       = "matrix",
+  [SYM_RANGE]        = "range",
+  [SYM_LIST]         = "list",
+  [SYM_NEW]          = "new",
+  [SYM_FREE]         = "free",
+  [SYM_RESIZE]       = "resize",
+  [SYM_NAME]         = "name",
+  [SYM_STORE]        = "store",
+  [SYM_SAVE]         = "save",
+  [SYM_LOAD]         = "load",
+  [SYM_DELETE]       = "delete",
+  [SYM_RENAME]       = "rename",
+  [SYM_STATES]       = "states",
+  [SYM_STATE_SAVE]   = "state save",
+  [SYM_STATE_LOAD]   = "state load",
+  [SYM_STATE_DELETE] = "state delete",
+  [SYM_STATE_RENAME] = "state rename",
+  [SYM_ORDINATE]     = "ordinate",
+  [SYM_COUNT]        = "count",
+};
+
+static t_symbol* sym_key_arr[SYM_HASH_SIZE];  // Open addressing on the address of the symbol, NULL if free
+static t_sym_id  sym_id_arr[SYM_HASH_SIZE];
+
 // ========  INITIALIZATION ROUTINE  ========
 
 // ========  MAIN  ========
 
 int C74_EXPORT main(void) {
 
+  sym_init();
+
   t_class* c = class_new("y.diffuse~", (method)diffuse_new, (method)diffuse_free, (long)sizeof(t_diffuse), 0L, A_GIMME, 0);
 
   // ====  MAX MSP METHODS  ====
 
   class_addmethod(c, (method)diffuse_dsp64,   "dsp64",  A_CANT, 0);
+  class_addmethod(c, (method)diffuse_dspstate, "dspstate", A_CANT, 0);
   class_addmethod(c, (method)diffuse_assist,  "assist", A_CANT, 0);
 
   // ==== DIFFUSE METHODS ====
@@ -37,9 +100,10 @@ int C74_EXPORT main(void) {
   class_addmethod(c, (method)diffuse_bang,       "bang",                0);
   class_addmethod(c, (method)diffuse_dictionary, "dictionary", A_SYM,   0);
   class_addmethod(c, (method)diffuse_get,        "get",                 0);
+  class_addmethod(c, (method)diffuse_stats,      "stats",               0);
   class_addmethod(c, (method)diffuse_master,     "master",     A_FLOAT, 0);
   class_addmethod(c, (method)diffuse_gain_out,   "gain_out",   A_GIMME, 0);
-  class_addmethod(c, (method)diffuse_output,     "output",     A_SYM,   0);
+  class_addmethod(c, (method)diffuse_output,     "output",     A_GIMME, 0);
   class_addmethod(c, (method)diffuse_set,        "set",        A_GIMME, 0);
 
   // ====  CHANNEL METHODS  ====
@@ -67,6 +131,56 @@ int C74_EXPORT main(void) {
   return 0;
 }
 
+// ========  SYMBOLS  ========
+
+// ====  _SYM_HASH  ====
+
+static t_int32 _sym_hash(t_symbol* sym) {
+
+  uintptr_t key = (uintptr_t)sym;
+  return (t_int32)((key >> 4) ^ (key >> 12)) & (SYM_HASH_SIZE - 1);
+}
+
+// ====  SYM_INIT  ====
+
+//******************************************************************************
+//  Intern the symbols and fill the table used by sym_id. Called once by main.
+//
+void sym_init(void) {
+
+  for (t_int32 ind = 0; ind < SYM_HASH_SIZE; ind++) {
+    sym_key_arr[ind] = NULL;
+    sym_id_arr[ind] = SYM_NONE;
+  }
+
+  for (t_int32 id = 0; id < SYM_CNT; id++) {
+
+    sym_arr[id] = gensym(sym_name_arr[id]);
+
+    t_int32 ind = _sym_hash(sym_arr[id]);
+    while (sym_key_arr[ind]) { ind = (ind + 1) & (SYM_HASH_SIZE - 1); }
+    sym_key_arr[ind] = sym_arr[id];
+    sym_id_arr[ind] = (t_sym_id)id;
+  }
+}
+
+// ====  SYM_ID  ====
+
+//******************************************************************************
+//  Returns the index of a symbol in the table, or SYM_NONE if it is not in it.
+//
+t_sym_id sym_id(t_symbol* sym) {
+
+  t_int32 ind = _sym_hash(sym);
+
+  while (sym_key_arr[ind]) {
+    if (sym_key_arr[ind] == sym) { return sym_id_arr[ind]; }
+    ind = (ind + 1) & (SYM_HASH_SIZE - 1);
+  }
+
+  return SYM_NONE;
+}
+
 // ========  NEW INSTANCE ROUTINE: DIFFUSE_NEW  ========
 //******************************************************************************
 //  Called when the object is created.
@@ -90,13 +204,16 @@ void* diffuse_new(t_symbol* sym, t_int32 argc, t_atom* argv) {
   // ==== Arguments
   // (int: input channels) (int: output channels) [int: storage slots]
 
+  t_int32 channel_cnt = CHANNEL_CNT_DEF;
+  t_int32 out_cnt     = OUT_CNT_DEF;
+
   // If two arguments are provided
   if ((argc == 2)
       && (atom_gettype(argv) == A_LONG) && (atom_getlong(argv) >= 1)
       && (atom_gettype(argv + 1) == A_LONG) && (atom_getlong(argv + 1) >= 1)) {
 
-    x->channel_cnt = (t_int32)atom_getlong(argv);
-    x->out_cnt     = (t_int32)atom_getlong(argv + 1);
+    channel_cnt = (t_int32)atom_getlong(argv);
+    out_cnt     = (t_int32)atom_getlong(argv + 1);
     x->state_cnt   = STATE_CNT_DEF;
   }
 
@@ -106,15 +223,15 @@ void* diffuse_new(t_symbol* sym, t_int32 argc, t_atom* argv) {
       && (atom_gettype(argv + 1) == A_LONG) && (atom_getlong(argv + 1) >= 1)
       && (atom_gettype(argv + 2) == A_LONG) && (atom_getlong(argv + 2) >= 1)) {
 
-    x->channel_cnt = (t_int32)atom_getlong(argv);
-    x->out_cnt     = (t_int32)atom_getlong(argv + 1);
+    channel_cnt = (t_int32)atom_getlong(argv);
+    out_cnt     = (t_int32)atom_getlong(argv + 1);
     x->state_cnt   = (t_int32)atom_getlong(argv + 2);
   }
 
   // Otherwise the arguments are invalid and the default values are used
   else {
-    x->channel_cnt = CHANNEL_CNT_DEF;
-    x->out_cnt     = OUT_CNT_DEF;
+    channel_cnt = CHANNEL_CNT_DEF;
+    out_cnt     = OUT_CNT_DEF;
     x->state_cnt   = STATE_CNT_DEF;
 
     MY_ERR("diffuse_new:  Invalid arguments. The object expects:");
@@ -127,13 +244,13 @@ void* diffuse_new(t_symbol* sym, t_int32 argc, t_atom* argv) {
   // ==== Inlets and oulets
 
   // Create the MSP inlets
-  dsp_setup((t_pxobject*)x, x->channel_cnt);
+  dsp_setup((t_pxobject*)x, channel_cnt);
 
   // The last outlet is for messages
   x->outl_mess = outlet_new((t_object*)x, NULL);
 
   // Create the signal outlets
-  for (t_int32 ch = 0; ch < x->out_cnt; ch++) {
+  for (t_int32 ch = 0; ch < out_cnt; ch++) {
     outlet_new((t_object*)x, "signal");
   }
 
@@ -142,91 +259,111 @@ void* diffuse_new(t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   // ==== Initialization
 
-  // Ramping parameter, function, and inverse function
-  x->ramp_param = 4;
-  x->ramp_func = ramp_exp;
-  x->ramp_inv_func = ramp_exp_inv;
-
-  // Crossfade parameter, function, and inverse function
-  x->xfade_param = -3;
-  x->xfade_func = xfade_sinus;
-  x->xfade_inv_func = xfade_sinus_inv;
-
   // Set the array pointers to NULL
-  x->channel_arr = NULL;
+  core_init(x->core, channel_cnt, out_cnt, sys_getsr());
+  x->is_perform_off = 1;
+  x->post_lock = NULL;
+  x->is_core_busy = 0;
+  x->perform_cnt = 0;
+  x->sync_clock = NULL;
+  x->is_sync_armed = false;
+  x->sync_cnt = 0;
+  x->sync_interval = SYNC_CHECK_MS;
   x->state_arr = NULL;
-  x->out_gain = NULL;
+  x->block = NULL;
   x->outp_mess_arr = NULL;
-
-  // Allocate the array of input channels and test
-  x->channel_arr = (t_channel*)sysmem_newptr(sizeof(t_channel) * x->channel_cnt);
-  if (!x->channel_arr) {
+  x->outp_buf_arr = NULL;
+  x->outp_clock = NULL;
+  x->end_clock = NULL;
+  x->end_mess_arr = NULL;
+  x->reply_arr = NULL;
+  x->reply_len = 0;
+  x->reply_depth[0] = 0;
+  x->reply_depth[1] = 0;
+  x->sel_arr = NULL;
+  x->sel_cnt = 0;
+  _state_init(x->state_tmp, SYM(NULL));
+
+  // The lock taken by the control threads to post commands
+  critical_new(&x->post_lock);
+
+  // Ramp completions are queued by the core and sent by the object
+  x->core->end_is_on = true;
+  x->end_is_merged = false;
+
+  // Allocate the input channels and the output gains, and test
+  if (core_alloc(x->core) != ERR_NONE) {
     MY_ERR("diffuse_new:  Allocation failed for the input channels.");
     diffuse_free(x);
     return NULL;
   }
 
-  // Initialize and allocate each channel
-  for (int ch = 0; ch < x->channel_cnt; ch++) { _channel_init(x, x->channel_arr + ch); }
-  for (int ch = 0; ch < x->channel_cnt; ch++) {
-    if (_channel_alloc(x, x->channel_arr + ch, 0, 0) != ERR_NONE) {
-      MY_ERR("diffuse_new:  Allocation failed for the input channels.");
-      diffuse_free(x);
-      return NULL;
-    }
-  }
-
   // Allocate the array of states and test
-  x->state_arr = _state_arr_new(x->state_cnt, &(x->state_cnt), x->out_cnt);
+  x->state_arr = _state_arr_new(x->state_cnt, &(x->state_cnt), x->core->out_cnt);
   if (!x->state_arr) {
     MY_ERR("diffuse_new:  Allocation failed for the array of states.");
     diffuse_free(x);
     return NULL;
   }
 
-  // Initialize and allocate the temporary state used for calculations
-  _state_init(x->state_tmp);
-  if (_state_alloc(x->state_tmp, x->out_cnt, 0, 0) != ERR_NONE) {
-    MY_ERR("diffuse_new:  Allocation failed for state_tmp.");
-    diffuse_free(x);
-    return NULL;
-  }
+  // Allocate the message arrays and the temporary state in one block, and test
+  // The replies are at most as long as channel get and get
+  x->reply_len = x->core->out_cnt + 5;
 
-  // Allocate the vector of gains and test
-  x->out_gain = (t_double*)sysmem_newptr(sizeof(t_double)* x->out_cnt);
-  if (!x->out_gain) {
-    MY_ERR("diffuse_new:  Allocation failed for the output gains.");
+  t_arena arena = { NULL, 0 };
+  _diffuse_layout(x, &arena);
+
+  x->block = sysmem_newptrclear(arena.size + CORE_ALIGN - 1);
+  if (!x->block) {
+    MY_ERR("diffuse_new:  Allocation failed for the message arrays.");
     diffuse_free(x);
     return NULL;
   }
 
-  // Amplitude variables
-  x->master = 1.0;
-  for (t_int32 ch = 0; ch < x->out_cnt; ch++) { x->out_gain[ch] = 1.0; }
-
-  // Samplerates
-  x->samplerate = sys_getsr();
-  x->msr        = x->samplerate / 1000;
+  arena.base = (char*)CORE_ALIGN_PTR(x->block);
+  arena.size = 0;
+  _diffuse_layout(x, &arena);
 
   // Variables for message output
-  x->outp_channel = x->channel_arr;
+  x->outp_channel = x->core->channel_arr;
   x->outp_type = OUTP_TYPE_DB;
+  x->outp_interval = 1000.0 / OUTP_RATE_DEF;
+  x->outp_seq = 0;
+  x->outp_start = 0;
+  x->outp_sent = -1;    // Send the first snapshot
+
+  // The clock that sends the output message
+  x->outp_clock = clock_new(x, (method)diffuse_outp_tick);
+  if (!x->outp_clock) {
+    MY_ERR("diffuse_new:  Allocation failed for the output message.");
+    diffuse_free(x);
+    return NULL;
+  }
+  clock_fdelay(x->outp_clock, 0);
 
-  // Allocate the ouput message array
-  x->outp_mess_arr = (t_atom*)sysmem_newptr(sizeof(t_atom) * x->out_cnt);
-  if (!x->outp_mess_arr) {
-    MY_ERR("diffuse_new:  Allocation failed for the output message array.");
+  // The clock that sends the ramp completions
+  x->end_clock = clock_new(x, (method)diffuse_end_ramp);
+  if (!x->end_clock) {
+    MY_ERR("diffuse_new:  Allocation failed for the end_ramp message.");
+    diffuse_free(x);
+    return NULL;
+  }
+
+  // The clock that applies the commands when the perform routine is not called
+  x->sync_clock = clock_new(x, (method)diffuse_sync_tick);
+  if (!x->sync_clock) {
+    MY_ERR("diffuse_new:  Allocation failed for the command queue.");
     diffuse_free(x);
     return NULL;
   }
 
   // The name of the dictionary is empty for now
-  x->dict_sym = gensym("");
+  x->dict_sym = SYM(EMPTY);
 
   // Post a creation message
   POST("diffuse_new:  diffuse~ object created:");
   POST("  %i input channels, %i output channels, %i storage slots for states",
-    x->channel_cnt, x->out_cnt, x->state_cnt);
+    x->core->channel_cnt, x->core->out_cnt, x->state_cnt);
 
   return (x);
 }
@@ -238,19 +375,21 @@ void diffuse_free(t_diffuse* x) {
 
   TRACE("diffuse_free");
 
-  if (x->channel_arr) {
-    for (t_int32 ch = 0; ch < x->channel_cnt; ch++) { _channel_free(x, x->channel_arr + ch); }
-    sysmem_freeptr(x->channel_arr);
-  }
+  // Remove the perform routine and the clock that drains the queue before freeing what they read
+  dsp_free((t_pxobject*)x);
+  if (x->sync_clock) { clock_unset(x->sync_clock); object_free(x->sync_clock); }
+
+  core_free(x->core);
 
   if (x->state_arr) { _state_arr_free(&(x->state_arr), &(x->state_cnt)); }
 
-  _state_free(x->state_tmp);
+  if (x->outp_clock) { clock_unset(x->outp_clock); object_free(x->outp_clock); }
+  if (x->end_clock) { clock_unset(x->end_clock); object_free(x->end_clock); }
 
-  if (x->out_gain) { sysmem_freeptr(x->out_gain); }
-  if (x->outp_mess_arr) { sysmem_freeptr(x->outp_mess_arr); }
+  if (x->post_lock) { critical_free(x->post_lock); x->post_lock = NULL; }
 
-  dsp_free((t_pxobject*)x);
+  // The message arrays and the temporary state all live in the block
+  if (x->block) { sysmem_freeptr(x->block); x->block = NULL; }
 }
 
 // ========  METHOD: DIFFUSE_DSP64  ========
@@ -261,172 +400,105 @@ void diffuse_dsp64(t_diffuse* x, t_object* dsp64, t_int32* count, t_double sampl
   TRACE("diffuse_dsp64");
   POST("Samplerate = %.0f - Maxvectorsize = %i", samplerate, maxvectorsize);
 
-  object_method(dsp64, gensym("dsp_add64"), x, diffuse_perform64, 0, NULL);
-
-  // Recalculate everything that depends on the samplerate
-  x->samplerate = samplerate;
-  x->msr        = x->samplerate / 1000;
-}
-
-// ========  METHOD: DIFFUSE_PERFORM64  ========
+  // From now on the perform routine drains the command queue, see _diffuse_sync
+  core_atomic_store(&x->is_perform_off, 0);
+  x->sync_interval = MAX(SYNC_CHECK_MS, SYNC_VEC_CNT * 1000.0 * maxvectorsize / samplerate);
 
-void diffuse_perform64(t_diffuse* x, t_object* dsp64, t_double** in_arr, long numins, t_double** out_arr, long numouts, long sampleframes, long flags, void* userparam) {
+  object_method(dsp64, SYM(DSP_ADD64), x, diffuse_perform64, 0, NULL);
 
-  // Set all the output vectors to zero
-  for (t_int32 out = 0; out < x->out_cnt; out++) {
-    for (t_int32 smp = 0; smp < sampleframes; smp++) {
-      out_arr[out][smp] = 0;
-    }
+  // Recalculate everything that depends on the samplerate and vector size
+  if (core_dsp(x->core, samplerate, (t_int32)maxvectorsize) != ERR_NONE) {
+    MY_ERR("diffuse_dsp64:  Allocation failed, the blocked engine or the helper threads are disabled.");
   }
+}
 
-  //  ####  LOOP THROUGH THE INPUT CHANNELS  ####
-
-  for (t_int32 in = 0; in < x->channel_cnt; in++) {
-
-    t_channel* channel = x->channel_arr + in;
-
-    // If the channel is off don't do anything in this loop
-    if (!channel->is_on) { continue; }
-
-    // Local variables
-    t_int32 chunk_len = -1;
-    t_int32 smp_left = 0;
-    t_int32 smp_proc = 0;
-    t_int32 smp_left_x_vel = 0;
-    t_int32 cntd_d_vel = 0;
-    t_double gain = 0.0;
-    t_double d_ampl = 0.0;
-    t_double dA = 0.0;
-    t_double A_U_dU = 0.0;
-
-    t_double* sig_in = NULL;
-    t_double* sig_out = NULL;
-
-    // We are tracking where we are using:
-    //   smp_left:      the number of samples left to process in this perform cycle
-    //   chunk_len:     the number of samples to process in a chunk,
-    //                  until end of perform cycle or end of countdown, whichever comes first, cannot be 0
-    //   channel->cntd: the total number of sampleframes left to process (unscaled by the velocity)
-
-    // ####  LOOP THROUGH THE CHUNKS  ####
-
-    smp_left = sampleframes;
-    while (smp_left) {
-
-      // == Temporary variables - scaling by the velocity
-      smp_left_x_vel = (t_int32)(smp_left * channel->velocity);
-      cntd_d_vel = (t_int32)(channel->cntd / channel->velocity);          // cannot be 0, unless cntd is 0
-      if ((cntd_d_vel == 0) && (channel->cntd != 0)) { cntd_d_vel = 1; }  // correct for rounding down to 0 when cntd is not 0
-
-      // Keep track of the number of samples processed so far
-      smp_proc = sampleframes - smp_left;
-
-      // == Determine the chunk length and update the countdown and smp_left accordingly
-      // == Five cases depending on the countdown
-
-      // == If the bank is set to freeze
-      // == process the whole audio vector with no ramping or countdown
-      if (channel->is_frozen) { chunk_len = sampleframes; smp_left = 0; }
-
-      // == Zero countdown:  Iterate the mode and skip this chunk loop
-      else if (channel->cntd == 0) {
-        _state_iterate(x, channel);
-        continue;
-      }
-
-      // == Indefinite countdown:  The chunk is the whole length of the perform cycle
-      else if (channel->cntd == INDEFINITE) { chunk_len = smp_left; smp_left = 0; }
-
-      // == Countdown extends beyond perform cycle:  The chunk is the whole length of the perform cycle
-      else if (channel->cntd > smp_left_x_vel) { chunk_len = smp_left; smp_left = 0; channel->cntd -= smp_left_x_vel; }
-      // No velocity version:
-      // else if (reson->cntd > smp_left) { chunk_len = smp_left; smp_left = 0; reson->cntd -= chunk_len; }
-
-      // == Countdown shorter than perform cycle:  Keep processing chunks and mode changes
-      else { chunk_len = cntd_d_vel; smp_left -= chunk_len; channel->cntd = 0; }    // smp_left never gets to -1 in spite of rounding
-      // No velocity version:
-      // else { chunk_len = reson->cntd; smp_left -= chunk_len; reson->cntd = 0; }
-
-      // POST("smp_left: %i - smp_proc: %i - chunk_len: %i - cntd: %i", smp_left, smp_proc, chunk_len, channel->cntd);
-
-      // ####  LOOP THROUGH THE OUTPUT CHANNELS  ####
+// ========  METHOD: DIFFUSE_DSPSTATE  ========
+// Called when the audio is started or stopped
 
-      for (t_int32 out = 0; out < x->out_cnt; out++) {
+void diffuse_dspstate(t_diffuse* x, long is_on) {
 
-        // Initialize the input and output pointers to the current position in the vectors
-        sig_in = in_arr[in] + smp_proc;
-        sig_out = out_arr[out] + smp_proc;
+  TRACE("diffuse_dspstate");
 
-        // Calculate the non ramping gain: master, input channel and output channel
-        gain = x->master * channel->gain * x->out_gain[out];
+  if (is_on) { return; }
 
-        // >>>>  IF THE CHANNEL IS FIXED, FROZEN OR INDEFINITE
+  // The perform routine has stopped: apply the commands it left in the queue
+  _diffuse_post_lock(x);
+  core_atomic_store(&x->is_perform_off, 1);
+  _diffuse_post_unlock(x);
+}
 
-        // == Add values without ramping
-        if ((channel->mode_type == MODE_TYPE_FIX) || (channel->is_frozen) || (channel->cntd == INDEFINITE)) {
+// ========  METHOD: DIFFUSE_PERFORM64  ========
 
-          // If one of the gains is 0 skip the sample loop
-          // Could be from: master, gain input, output gain, or input-output multiplier
-          if ((gain == 0) || (channel->A_cur[out] == 0)) { continue; }
+void diffuse_perform64(t_diffuse* x, t_object* dsp64, t_double** in_arr, long numins, t_double** out_arr, long numouts, long sampleframes, long flags, void* userparam) {
 
-          // ####  LOOP THROUGH THE SAMPLES  ####
+  // A control thread is applying the commands, as the perform routine was not called for a while:
+  // output silence for this vector rather than wait
+  if (!core_atomic_cas(&x->is_core_busy, 0, 1)) {
+    for (long out = 0; out < numouts; out++) {
+      for (long smp = 0; smp < sampleframes; smp++) { out_arr[out][smp] = 0; }
+    }
+    return;
+  }
 
-          for (t_int32 smp = 0; smp < chunk_len; smp++) {
+  // Mix the input channels into the output channels
+  int32_t end_write = x->core->end_write;
+  core_perform(x->core, in_arr, out_arr, (t_int32)sampleframes);
 
-            *sig_out += *sig_in * channel->A_cur[out] * gain;
-            sig_in++;  sig_out++;
-          }
-        }
+  core_atomic_store(&x->is_core_busy, 0);
+  core_atomic_store(&x->perform_cnt, x->perform_cnt + 1);
 
-        // >>>>  IF THE CHANNEL IS RAMPING
+  // Ramps ended in this vector: the clock sends them from the scheduler
+  if (x->core->end_write != end_write) { clock_delay(x->end_clock, 0); }
 
-        // == Add values with ramping
-        else if (channel->mode_type == MODE_TYPE_VAR) {
+  // Snapshot the values for the output message, which is sent by the clock
+  if (x->outp_type != OUTP_TYPE_OFF) { _diffuse_outp_snap(x); }
+}
 
-          // Calculate dA: linear ramping of amplitude over the chunk length
+// ========  METHOD: _DIFFUSE_OUTP_SNAP  ========
 
-          // Increment the normalized ordinate value U by dU for the chunk length:
-          // recalculate each chunk to avoid cumulative errors
-          // alternative would be to calculate dU once when the ramp is created
-          channel->U_cur[out] += chunk_len * (channel->U_targ[out] - channel->U_cur[out]) / cntd_d_vel;   // cntd_d_vel cannot be 0
+//******************************************************************************
+//  Called by the audio thread: copy the values of the current channel into the buffer
+//  that the clock is not reading, then publish it. Nothing is copied if the values did not change.
+//
+void _diffuse_outp_snap(t_diffuse* x) {
 
-          // Calculate A(U + dU): the target amplitude value at the end of the chunk length
-          A_U_dU = channel->interp_func(channel->U_cur[out], channel->interp_param);
+  t_int32 out_cnt = x->core->out_cnt;
+  uint32_t seq = (uint32_t)x->outp_seq;
+  const t_double* a_arr = x->outp_channel->A_cur;
+  const t_double* last_arr = x->outp_buf_arr + (seq & 1) * out_cnt;
 
-          // If one of the gains is 0 update A_cur, and skip the sample loop
-          // Could be from: master, gain input, output gain, or input to output multiplier
-          if ((gain == 0) || ((channel->A_cur[out] == 0) && ((channel->A_targ[out] == 0)))) {
-            channel->A_cur[out] = A_U_dU; continue;
-          }
+  if (!memcmp(last_arr, a_arr, sizeof(t_double) * out_cnt)) { return; }
 
-          // Calculate dA
-          dA = (A_U_dU - channel->A_cur[out]) / chunk_len;    // chunk_len cannot be 0
+  t_double* buf_arr = x->outp_buf_arr + ((seq + 1) & 1) * out_cnt;
+  core_atomic_store(&x->outp_start, (int32_t)(seq + 1));
+  core_atomic_fence();
+  memcpy(buf_arr, a_arr, sizeof(t_double) * out_cnt);
+  core_atomic_store(&x->outp_seq, (int32_t)(seq + 1));
+}
 
-          // ####  LOOP THROUGH THE SAMPLES  ####
+// ========  METHOD: DIFFUSE_OUTP_TICK  ========
 
-          for (t_int32 smp = 0; smp < chunk_len; smp++) {
+//******************************************************************************
+//  Called by the clock: send the last snapshot if it was not sent yet, and reschedule.
+//  output (float: gain) {x N}
+//
+void diffuse_outp_tick(t_diffuse* x) {
 
-            *sig_out += *sig_in * channel->A_cur[out] * gain;
-            sig_in++;  sig_out++;
+  if (x->outp_type == OUTP_TYPE_OFF) { return; }
+  clock_fdelay(x->outp_clock, x->outp_interval);
 
-            // Increment to ramp the amplitude gain
-            channel->A_cur[out] += dA;
-          }
-        }
+  t_int32 out_cnt = x->core->out_cnt;
+  uint32_t seq = (uint32_t)core_atomic_load(&x->outp_seq);
+  if (seq == (uint32_t)x->outp_sent) { return; }
 
-        // == OTHERWISE
-        // == Post a message error
-        else { MY_ERR("diffuse_perform64:  Invalid mode type."); }
+  atom_setdouble_array(out_cnt, x->outp_mess_arr, out_cnt, x->outp_buf_arr + (seq & 1) * out_cnt);
 
-      }  // End the loop through the output channels
-    }  // End the loop through the chunks
-  }  // End the loop through the input channels
+  // The audio thread started overwriting the buffer while it was copied: send it at the next tick
+  core_atomic_fence();
+  if ((uint32_t)core_atomic_load(&x->outp_start) - seq >= 2) { return; }
 
-  // Send the output message
-  if (x->outp_type != OUTP_TYPE_OFF) {
-    atom_setdouble_array(x->out_cnt, x->outp_mess_arr, x->out_cnt, x->outp_channel->A_cur);
-    outlet_anything(x->outl_mess, gensym("output"), x->out_cnt, x->outp_mess_arr);
-  }
+  x->outp_sent = (int32_t)seq;
+  outlet_anything(x->outl_mess, SYM(OUTPUT), out_cnt, x->outp_mess_arr);
 }
 
 // ========  METHOD: DIFFUSE_ASSIST  ========
@@ -438,13 +510,13 @@ void diffuse_assist(t_diffuse* x, void* b, long msg, t_int32 arg, char* str) {
   if (msg == ASSIST_INLET) {
 
     if (arg == 0) { sprintf(str, "Inlet %i: All purpose and Input Channel 0 (list / signal)", arg); }
-    else if ((arg >= 1) && (arg < x->channel_cnt)) { sprintf(str, "Inlet %i: Input Channel %i (signal)", arg, arg); }
+    else if ((arg >= 1) && (arg < x->core->channel_cnt)) { sprintf(str, "Inlet %i: Input Channel %i (signal)", arg, arg); }
   }
 
   else if (msg == ASSIST_OUTLET) {
 
-    if ((arg >= 0) && (arg < x->channel_cnt)) { sprintf(str, "Outlet %i: Output Channel %i (signal)", arg, arg); }
-    else if (arg == x->channel_cnt) { sprintf(str, "Outlet %i: All purpose messages (list)", arg); }
+    if ((arg >= 0) && (arg < x->core->channel_cnt)) { sprintf(str, "Outlet %i: Output Channel %i (signal)", arg, arg); }
+    else if (arg == x->core->channel_cnt) { sprintf(str, "Outlet %i: All purpose messages (list)", arg); }
   }
 }
 
@@ -477,19 +549,34 @@ void diffuse_get(t_diffuse* x) {
 
   // Output a message with information about the object
   //   diffuse (int: index) (float: gain) {x N} (float: velocity) (float: gain) (sym: on/off) (sym: frozen/active)
-  t_atom* mess_arr = (t_atom*)sysmem_newptr(sizeof(t_atom)* (x->out_cnt + 5));
-  MY_ASSERT(!mess_arr, "get:  Allocation failed for the output message array.");
+  t_atom* mess_arr = _diffuse_reply_begin(x);
+  MY_ASSERT(!mess_arr, "get:  Allocation failed for the reply.");
   t_atom* atom = mess_arr;
 
-  atom_setlong(atom++, x->channel_cnt);
-  atom_setlong(atom++, x->out_cnt);
+  atom_setlong(atom++, x->core->channel_cnt);
+  atom_setlong(atom++, x->core->out_cnt);
   atom_setlong(atom++, x->state_cnt);
-  atom_setfloat(atom++, x->master);
-  for (t_int32 ch = 0; ch < x->out_cnt; ch++){ atom_setfloat(atom++, x->out_gain[ch]); }
+  atom_setfloat(atom++, x->core->master_targ);
+  for (t_int32 ch = 0; ch < x->core->out_cnt; ch++){ atom_setfloat(atom++, x->core->out_gain_targ[ch]); }
   atom_setsym(atom++, x->dict_sym);
 
-  outlet_anything(x->outl_mess, gensym("diffuse"), 5 + x->out_cnt, mess_arr);
-  sysmem_freeptr(mess_arr);
+  outlet_anything(x->outl_mess, SYM(DIFFUSE), 5 + x->core->out_cnt, mess_arr);
+  _diffuse_reply_end(x, mess_arr);
+}
+
+// ====  DIFFUSE_STATS  ====
+//******************************************************************************
+//  stats (int: idle outputs)
+//  The number of outputs that received no contribution in the last vector.
+//
+void diffuse_stats(t_diffuse* x) {
+
+  TRACE("stats");
+
+  t_atom mess_arr[1];
+  atom_setlong(mess_arr, x->core->out_idle_cnt);
+
+  outlet_anything(x->outl_mess, SYM(STATS), 1, mess_arr);
 }
 
 // ====  DIFFUSE_MASTER  ====
@@ -501,7 +588,10 @@ void diffuse_master(t_diffuse* x, double master) {
 
   TRACE("master");
 
-  x->master = (t_double)master;
+  _diffuse_post_lock(x);
+  t_my_err err = core_post(x->core, CMD_MASTER, -1, 0, (t_double)master, 0);
+  _diffuse_post_unlock(x);
+  MY_ASSERT(err != ERR_NONE, "master:  The command queue is full, the message is dropped.");
 }
 
 // ====  DIFFUSE_GAIN_OUT  ====
@@ -516,9 +606,9 @@ void diffuse_gain_out(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
   MY_ASSERT(argc != 2, "gain_out:  2 args expected:  gain_out (int: output channel index) (float: channel gain)");
 
   // Argument 0 should reference an ouput channel
-  MY_ASSERT(atom_gettype(argv) != A_LONG, "gain_out:  Arg 0:  Int [0-%i] expected: the index of the output channel.", x->out_cnt - 1);
+  MY_ASSERT(atom_gettype(argv) != A_LONG, "gain_out:  Arg 0:  Int [0-%i] expected: the index of the output channel.", x->core->out_cnt - 1);
   t_int32 index = (t_int32)atom_getlong(argv);
-  MY_ASSERT((index < 0) || (index >= x->out_cnt), "gain_out:  Arg 0 : Int [0-%i] expected : the index of the output channel.", x->out_cnt - 1);
+  MY_ASSERT((index < 0) || (index >= x->core->out_cnt), "gain_out:  Arg 0 : Int [0-%i] expected : the index of the output channel.", x->core->out_cnt - 1);
 
   // Argument 1 should be a float between 0 and 1
   MY_ASSERT((atom_gettype(argv + 1) != A_FLOAT) && (atom_gettype(argv + 1) != A_LONG),
@@ -526,40 +616,99 @@ void diffuse_gain_out(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
   t_double gain = (t_double)atom_getfloat(argv + 1);
   MY_ASSERT(gain < 0, "gain_out:  Arg 1 : Positive float expected : the gain of the output channel.");
 
-  x->out_gain[index] = gain;
+  _diffuse_post_lock(x);
+  t_my_err err = core_post(x->core, CMD_GAIN_OUT, index, 0, gain, 0);
+  _diffuse_post_unlock(x);
+  MY_ASSERT(err != ERR_NONE, "gain_out:  The command queue is full, the message is dropped.");
 }
 
 // ====  DIFFUSE_OUTPUT  ====
 
-void diffuse_output(t_diffuse* x, t_symbol* outp_type) {
+//******************************************************************************
+//  output (sym: off / db / ampl) [float: rate in Hz]
+//  The values of the current channel are sent from the scheduler at the rate, only when they change.
+//
+void diffuse_output(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   TRACE("output");
 
-  if (outp_type == gensym("off")) { x->outp_type = OUTP_TYPE_OFF; }
-  else if (outp_type == gensym("db")) { x->outp_type = OUTP_TYPE_DB; }
-  else if (outp_type == gensym("ampl")) { x->outp_type = OUTP_TYPE_AMPL; }
-  else { MY_ERR("output:  Arg 0:   \"off\", \"db\" or \"ampl\" expected"); }
+  MY_ASSERT((argc < 1) || (argc > 2) || (atom_gettype(argv) != A_SYM),
+    "output:  Expects:  output (sym: off / db / ampl) [float: rate in Hz]");
+
+  // Argument 1, if present, should be the rate
+  if (argc == 2) {
+    MY_ASSERT(((atom_gettype(argv + 1) != A_FLOAT) && (atom_gettype(argv + 1) != A_LONG))
+      || (atom_getfloat(argv + 1) <= 0) || (atom_getfloat(argv + 1) > OUTP_RATE_MAX),
+      "output:  Arg 1:  Float ]0-%i] expected: the rate in Hz.", OUTP_RATE_MAX);
+    x->outp_interval = 1000 / atom_getfloat(argv + 1);
+  }
+
+  t_symbol* outp_type = atom_getsym(argv);
+  t_output_type prev_type = x->outp_type;
+
+  if (outp_type == SYM(OFF)) { x->outp_type = OUTP_TYPE_OFF; }
+  else if (outp_type == SYM(DB)) { x->outp_type = OUTP_TYPE_DB; }
+  else if (outp_type == SYM(AMPL)) { x->outp_type = OUTP_TYPE_AMPL; }
+  else { MY_ERR("output:  Arg 0:   \"off\", \"db\" or \"ampl\" expected"); return; }
+
+  // Start or stop the clock, and send the last snapshot again when starting
+  if (x->outp_type == OUTP_TYPE_OFF) { clock_unset(x->outp_clock); }
+  else if (prev_type == OUTP_TYPE_OFF) {
+    x->outp_sent = (int32_t)((uint32_t)core_atomic_load(&x->outp_seq) - 1);
+    clock_fdelay(x->outp_clock, 0);
+  }
 }
 
 // ====  DIFFUSE_SET  ====
 
+//******************************************************************************
+//  set (sym: command) {args}
+//  All the commands post to the core or change the curves: the whole message is handled with the lock held.
+//
 void diffuse_set(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   TRACE("set");
 
+  _diffuse_post_lock(x);
+  _diffuse_set(x, argc, argv);
+  _diffuse_post_unlock(x);
+}
+
+void _diffuse_set(t_diffuse* x, t_int32 argc, t_atom* argv) {
+
   // Argument 0 should be a command
   MY_ASSERT((argc < 1) || (atom_gettype(argv) != A_SYM),
-    "set:  Arg 0:  Command expected: ramp / xfade.");
+    "set:  Arg 0:  Command expected: ramp / xfade / lut / exact / threads / silence / smooth / control_rate / end_merge.");
   t_symbol* cmd = atom_getsym(argv);
 
+  // Breakpoint curves, for set ramp table and set xfade table
+  t_double x_arr[CURVE_BREAK_CNT_MAX];
+  t_double y_arr[CURVE_BREAK_CNT_MAX];
+  t_int32 break_cnt = 0;
+  t_bool is_spline = false;
+  t_my_err err = ERR_NONE;
+
+  switch (sym_id(cmd)) {
+
   // ====  RAMP:  Set the ramping function for all channels  ====
   // set ramp [sym: linear / poly / exp / sigmoid] [float: ramping parameter]
+  // set ramp table [sym: linear / spline] (float: x) (float: y) {x N}
+
+  case SYM_RAMP: {
 
-  if (cmd == gensym("ramp")) {
+    // To set a breakpoint curve
+    if ((argc >= 2) && (atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == SYM(TABLE))) {
+      MY_ASSERT(_diffuse_parse_breaks(argc - 2, argv + 2, x_arr, y_arr, &break_cnt, &is_spline) != ERR_NONE,
+        "set ramp table:  Expects:  set ramp table [sym: linear / spline] (float: x) (float: y) {x 2 to %i}", CURVE_BREAK_CNT_MAX);
+      err = core_set_ramp_table(x->core, x_arr, y_arr, break_cnt, is_spline);
+      MY_ASSERT(err == ERR_ARG_VALUE, "set ramp table:  Invalid breakpoints: increasing x and y expected, with distinct end points.");
+    }
 
     // To set just the ramping parameter
-    if ((argc == 2) && ((atom_gettype(argv + 1) == A_LONG) || (atom_gettype(argv + 1) == A_FLOAT))) {
-      x->ramp_param = atom_getfloat(argv + 1);
+    else if ((argc == 2) && ((atom_gettype(argv + 1) == A_LONG) || (atom_gettype(argv + 1) == A_FLOAT))) {
+      err = core_set_ramp(x->core, x->core->curves_edit->ramp_type, atom_getfloat(argv + 1));
+      MY_ASSERT(err == ERR_ARG_VALUE,
+        "set ramp:  Arg 1:  Invalid parameter: poly expects > 0, exp expects non zero within +-%.0f.", RAMP_EXP_PARAM_MAX);
     }
 
     else if (((argc == 2) && (atom_gettype(argv + 1) == A_SYM)) ||
@@ -567,49 +716,46 @@ void diffuse_set(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
         (atom_gettype(argv + 1) == A_SYM) &&
         ((atom_gettype(argv + 2) == A_LONG) || (atom_gettype(argv + 2) == A_FLOAT)))) {
 
-      t_symbol* ramp_type = atom_getsym(argv + 1);
-
-      if (ramp_type == gensym("linear")) {
-        x->ramp_func = ramp_linear;
-        x->ramp_inv_func = ramp_linear_inv;
-      }
-
-      else if (ramp_type == gensym("poly")) {
-        x->ramp_func = ramp_poly;
-        x->ramp_inv_func = ramp_poly_inv;
-      }
-
-      else if (ramp_type == gensym("exp")) {
-        x->ramp_func = ramp_exp;
-        x->ramp_inv_func = ramp_exp_inv;
-      }
-
-      else if (ramp_type == gensym("sigmoid")) {
-        x->ramp_func = ramp_sigmoid;
-        x->ramp_inv_func = ramp_sigmoid_inv;
-      }
+      t_symbol* ramp_sym = atom_getsym(argv + 1);
+      t_ramp_type ramp_type = RAMP_UNDEF;
 
+      if (ramp_sym == SYM(LINEAR))       { ramp_type = RAMP_LINEAR; }
+      else if (ramp_sym == SYM(POLY))    { ramp_type = RAMP_POLY; }
+      else if (ramp_sym == SYM(EXP))     { ramp_type = RAMP_EXP; }
+      else if (ramp_sym == SYM(SIGMOID)) { ramp_type = RAMP_SIGMOID; }
       else {
-        MY_ASSERT(1, "set ramp:  Arg 1:  Ramp type expected: linear / poly / exp / sigmoid");
+        MY_ASSERT(1, "set ramp:  Arg 1:  Ramp type expected: linear / poly / exp / sigmoid / table");
       }
 
-      if (argc == 3) {
-        x->ramp_param = atom_getfloat(argv + 2);
-      }
+      // The parameter is validated for the type before anything is changed
+      t_double param = (argc == 3) ? atom_getfloat(argv + 2) : x->core->curves_edit->ramp_param;
+      err = core_set_ramp(x->core, ramp_type, param);
+      MY_ASSERT(err == ERR_ARG_VALUE,
+        "set ramp:  Invalid parameter: poly expects > 0, exp expects non zero within +-%.0f.", RAMP_EXP_PARAM_MAX);
     }
 
     else {
       MY_ASSERT(1, "set ramp:  Expects:  set ramp [sym: linear / poly / exp / sigmoid] [float: ramping parameter]");
     }
+
+    break;
   }
 
   // ====  XFADE:  Set the crossfading function for all channels  ====
   // set xfade [sym: linear / sqrt / sinus] [float: crossfade parameter]
+  // set xfade table [sym: linear / spline] (float: x) (float: y) {x N}
+
+  case SYM_XFADE: {
 
-  else if (cmd == gensym("xfade")) {
+    if ((argc >= 2) && (atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == SYM(TABLE))) {
+      MY_ASSERT(_diffuse_parse_breaks(argc - 2, argv + 2, x_arr, y_arr, &break_cnt, &is_spline) != ERR_NONE,
+        "set xfade table:  Expects:  set xfade table [sym: linear / spline] (float: x) (float: y) {x 2 to %i}", CURVE_BREAK_CNT_MAX);
+      err = core_set_xfade_table(x->core, x_arr, y_arr, break_cnt, is_spline);
+      MY_ASSERT(err == ERR_ARG_VALUE, "set xfade table:  Invalid breakpoints: increasing x and y expected, with distinct end points.");
+    }
 
-    if ((argc == 2) && ((atom_gettype(argv + 1) == A_LONG) || (atom_gettype(argv + 1) == A_FLOAT))) {
-      x->xfade_param = atom_getfloat(argv + 1);
+    else if ((argc == 2) && ((atom_gettype(argv + 1) == A_LONG) || (atom_gettype(argv + 1) == A_FLOAT))) {
+      core_set_xfade(x->core, x->core->curves_edit->xfade_type, atom_getfloat(argv + 1));
     }
 
     else if (((argc == 2) && (atom_gettype(argv + 1) == A_SYM)) ||
@@ -617,49 +763,368 @@ void diffuse_set(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
         (atom_gettype(argv + 1) == A_SYM) &&
         ((atom_gettype(argv + 2) == A_LONG) || (atom_gettype(argv + 2) == A_FLOAT)))) {
 
-      t_symbol* xfade_type = atom_getsym(argv + 1);
+      t_symbol* xfade_sym = atom_getsym(argv + 1);
+      t_xfade_type xfade_type = XFADE_UNDEF;
 
-      if (xfade_type == gensym("linear")) {
-        x->xfade_func = xfade_linear;
-        x->xfade_inv_func = xfade_linear_inv;
+      if (xfade_sym == SYM(LINEAR))     { xfade_type = XFADE_LINEAR; }
+      else if (xfade_sym == SYM(SQRT))  { xfade_type = XFADE_SQRT; }
+      else if (xfade_sym == SYM(SINUS)) { xfade_type = XFADE_SINUSOIDAL; }
+      else {
+        MY_ASSERT(1, "set xfade:  Arg 1:  Crossfade type expected: linear / sqrt / sinus / table");
       }
 
-      else if (xfade_type == gensym("sqrt")) {
-        x->xfade_func = xfade_sqrt;
-        x->xfade_inv_func = xfade_sqrt_inv;
-      }
+      core_set_xfade(x->core, xfade_type, (argc == 3) ? atom_getfloat(argv + 2) : x->core->curves_edit->xfade_param);
+    }
 
-      else if (xfade_type == gensym("sinus")) {
-        x->xfade_func = xfade_sinus;
-        x->xfade_inv_func = xfade_sinus_inv;
-      }
+    else {
+      MY_ASSERT(1, "set xfade:  Expects:  set xfade [sym: linear / sqrt / sinus] [float: crossfade parameter]");
+    }
 
-      else {
-        MY_ASSERT(1, "set xfade:  Arg 1:  Crossfade type expected: linear / sqrt / sinus");
-      }
+    break;
+  }
 
-      if (argc == 3) {
-        x->xfade_param = atom_getfloat(argv + 2);
-      }
+  // ====  LUT:  Use lookup tables for the ramp and crossfade functions  ====
+  // set lut off
+  // set lut [float: error bound]
+
+  case SYM_LUT: {
+
+    t_double lut_err = 0;
+
+    if ((argc == 2) && (atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == SYM(OFF))) {
+      lut_err = 0;
+    }
+
+    else if ((argc == 1) || ((argc == 2)
+      && ((atom_gettype(argv + 1) == A_LONG) || (atom_gettype(argv + 1) == A_FLOAT)) && (atom_getfloat(argv + 1) > 0))) {
+      lut_err = (argc == 2) ? atom_getfloat(argv + 1) : CURVE_LUT_ERR_DEF;
     }
 
     else {
-      MY_ASSERT(1, "set xfade:  Expects:  set xfade [sym: linear / sqrt / sinus] [float: crossfade parameter]");
+      MY_ASSERT(1, "set lut:  Expects:  set lut off / set lut [float: positive error bound]");
     }
+
+    core_set_curves(x->core, lut_err);
+    break;
   }
 
-  else {
-    MY_ASSERT(1, "set:  Arg 0:  Command expected: ramp / xfade.");
+  // ====  SILENCE:  Set the detection of silent inputs  ====
+  // set silence off
+  // set silence (float: [0-1] threshold) [float: hold time in ms]
+
+  case SYM_SILENCE: {
+
+    if ((argc == 2) && (atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == SYM(OFF))) {
+      MY_ASSERT(core_post(x->core, CMD_SILENCE, -1, false, x->core->silence_thresh, x->core->silence_hold) != ERR_NONE,
+        "set silence:  The command queue is full, the message is dropped.");
+    }
+
+    else if (((argc == 2) || (argc == 3))
+      && ((atom_gettype(argv + 1) == A_LONG) || (atom_gettype(argv + 1) == A_FLOAT))
+      && ((argc == 2) || (atom_gettype(argv + 2) == A_LONG) || (atom_gettype(argv + 2) == A_FLOAT))) {
+
+      t_double thresh = atom_getfloat(argv + 1);
+      t_double hold = (argc == 3) ? atom_getfloat(argv + 2) : x->core->silence_hold;
+      MY_ASSERT((thresh < 0) || (thresh > 1), "set silence:  Arg 1:  Float [0-1] expected for the threshold.");
+      MY_ASSERT(hold < 0, "set silence:  Arg 2:  Positive float expected for the hold time.");
+
+      MY_ASSERT(core_post(x->core, CMD_SILENCE, -1, true, thresh, hold) != ERR_NONE, "set silence:  The command queue is full, the message is dropped.");
+    }
+
+    else {
+      MY_ASSERT(1, "set silence:  Expects:  set silence off / set silence (float: [0-1] threshold) [float: hold time in ms]");
+    }
+    break;
   }
 
-  // Update the states
-  for (t_int32 st = 0; st < x->state_cnt; st++) {
-    _state_calc_absc(x, x->state_arr + st);
+  // ====  SMOOTH:  Set the smoothing time of master, gain_in and gain_out  ====
+  // set smooth (float: time in ms)
+
+  case SYM_SMOOTH: {
+
+    MY_ASSERT((argc != 2) || ((atom_gettype(argv + 1) != A_LONG) && (atom_gettype(argv + 1) != A_FLOAT))
+      || (atom_getfloat(argv + 1) < 0),
+      "set smooth:  Expects:  set smooth (float: positive time in ms)");
+
+    MY_ASSERT(core_post(x->core, CMD_SMOOTH, -1, 0, atom_getfloat(argv + 1), 0) != ERR_NONE, "set smooth:  The command queue is full, the message is dropped.");
+    break;
+  }
+
+  // ====  CONTROL_RATE:  Set the length of the sub-blocks that ramps are split into  ====
+  // set control_rate (int: samples, 0 for the vector size)
+
+  case SYM_CONTROL_RATE: {
+
+    MY_ASSERT((argc != 2) || (atom_gettype(argv + 1) != A_LONG) || (atom_getlong(argv + 1) < 0),
+      "set control_rate:  Expects:  set control_rate (int: samples, 0 for the vector size)");
+
+    MY_ASSERT(core_post(x->core, CMD_CONTROL_RATE, -1, (t_int32)atom_getlong(argv + 1), 0, 0) != ERR_NONE,
+      "set control_rate:  The command queue is full, the message is dropped.");
+    break;
+  }
+
+  // ====  EXACT:  Calculate the exponential ramps at sample resolution  ====
+  // set exact (int: 0 / 1), applies to the ramps started afterwards
+
+  case SYM_EXACT: {
+
+    MY_ASSERT((argc != 2) || (atom_gettype(argv + 1) != A_LONG),
+      "set exact:  Expects:  set exact (int: 0 / 1)");
+
+    MY_ASSERT(core_post(x->core, CMD_EXACT, -1, (atom_getlong(argv + 1) != 0), 0, 0) != ERR_NONE, "set exact:  The command queue is full, the message is dropped.");
+    break;
+  }
+
+  // ====  THREADS:  Split the perform routine of large matrices across threads  ====
+  // set threads (int: threads including the audio thread), applies when the audio is restarted
+
+  case SYM_THREADS: {
+
+    MY_ASSERT((argc != 2) || (atom_gettype(argv + 1) != A_LONG)
+      || (atom_getlong(argv + 1) < 1) || (atom_getlong(argv + 1) > WORKERS_THREAD_MAX),
+      "set threads:  Expects:  set threads (int: [1-%i] threads including the audio thread)", WORKERS_THREAD_MAX);
+
+    core_set_threads(x->core, (t_int32)atom_getlong(argv + 1));
+    break;
+  }
+
+  // ====  END_MERGE:  Merge the ramps ending on the same sample into one message  ====
+  // set end_merge (int: 0 / 1)
+
+  case SYM_END_MERGE: {
+
+    MY_ASSERT((argc != 2) || (atom_gettype(argv + 1) != A_LONG),
+      "set end_merge:  Expects:  set end_merge (int: 0 / 1)");
+
+    x->end_is_merged = (atom_getlong(argv + 1) != 0);
+    break;
+  }
+
+  default:
+    MY_ASSERT(1, "set:  Arg 0:  Command expected: ramp / xfade / lut / exact / threads / silence / smooth / control_rate / end_merge.");
+    break;
   }
 
   // Update the channels
-  // XXX for (t_int32 ch = 0; ch < x->channel_cnt; ch++)
-  //  _channel_calc_absc(x, x->channel_arr);
+  // XXX for (t_int32 ch = 0; ch < x->core->channel_cnt; ch++)
+  //  _channel_calc_absc(x->core, x->core->channel_arr);
+}
+
+// ====  _DIFFUSE_PARSE_BREAKS  ====
+
+//******************************************************************************
+//  Parse the breakpoints of a curve:  [sym: linear / spline] (float: x) (float: y) {x N}
+//  The values are checked by curve_break_build.
+//  Returns:
+//  ERR_NONE:  cnt breakpoints in x_arr and y_arr
+//  ERR_SYNTAX:  Unknown interpolation, odd number of values, or not numbers
+//  ERR_COUNT:  Fewer than 2 or more than CURVE_BREAK_CNT_MAX breakpoints
+//
+t_my_err _diffuse_parse_breaks(t_int32 argc, t_atom* argv, t_double* x_arr, t_double* y_arr, t_int32* cnt, t_bool* is_spline) {
+
+  *is_spline = false;
+
+  if ((argc >= 1) && (atom_gettype(argv) == A_SYM)) {
+    if (atom_getsym(argv) == SYM(SPLINE)) { *is_spline = true; }
+    else if (atom_getsym(argv) != SYM(LINEAR)) { return ERR_SYNTAX; }
+    argc--; argv++;
+  }
+
+  if (argc % 2) { return ERR_SYNTAX; }
+  if ((argc < 4) || (argc > 2 * CURVE_BREAK_CNT_MAX)) { return ERR_COUNT; }
+
+  for (t_int32 ind = 0; ind < argc; ind++) {
+    if ((atom_gettype(argv + ind) != A_LONG) && (atom_gettype(argv + ind) != A_FLOAT)) { return ERR_SYNTAX; }
+  }
+
+  *cnt = argc / 2;
+  for (t_int32 k = 0; k < *cnt; k++) {
+    x_arr[k] = atom_getfloat(argv + 2 * k);
+    y_arr[k] = atom_getfloat(argv + 2 * k + 1);
+  }
+
+  return ERR_NONE;
+}
+
+// ====  DIFFUSE_END_RAMP  ====
+
+//******************************************************************************
+//  Called by the clock: send the ramp completions queued by the core since the last call.
+//  The time is in ms from the start of the audio, at the sample the countdown reached 0.
+//  end_ramp (int: channel index) (int: state index) (float: time)
+//  Or when merged, one message for all the ramps ending on the same sample:
+//  end_ramps (float: time) (int: channel index) (int: state index) {x N}
+//
+void diffuse_end_ramp(t_diffuse* x) {
+
+  t_int32 lost = core_end_lost(x->core);
+  if (lost) { MY_ERR("end_ramp:  %i ramp completions dropped, the queue was full.", lost); }
+
+  t_end_event* event = core_end_front(x->core);
+
+  while (event) {
+
+    int64_t time = event->time;
+    t_atom* atom = x->end_mess_arr;
+
+    if (!x->end_is_merged) {
+      atom_setlong(atom++, event->channel);
+      atom_setlong(atom++, event->state);
+      atom_setfloat(atom++, time / x->core->msr);
+      core_end_pop(x->core);
+      outlet_anything(x->outl_mess, SYM(END_RAMP), 3, x->end_mess_arr);
+    }
+
+    else {
+      atom_setfloat(atom++, time / x->core->msr);
+      for (t_int32 cnt = 0; event && (event->time == time) && (cnt < x->core->channel_cnt); cnt++) {
+        atom_setlong(atom++, event->channel);
+        atom_setlong(atom++, event->state);
+        core_end_pop(x->core);
+        event = core_end_front(x->core);
+      }
+      outlet_anything(x->outl_mess, SYM(END_RAMPS), (t_int32)(atom - x->end_mess_arr), x->end_mess_arr);
+    }
+
+    event = core_end_front(x->core);
+  }
+}
+
+// ====  _DIFFUSE_LAYOUT  ====
+
+//******************************************************************************
+//  Carve the message arrays and the arrays of the temporary state out of an arena.
+//  With a NULL base it only adds up the size of the block, and sets all the pointers to NULL.
+//
+void _diffuse_layout(t_diffuse* x, t_arena* arena) {
+
+  _state_layout(x->state_tmp, arena, x->core->out_cnt, 0, 0);
+
+  x->outp_mess_arr = (t_atom*)arena_carve(arena, sizeof(t_atom) * x->core->out_cnt);
+  x->outp_buf_arr = (t_double*)arena_carve(arena, sizeof(t_double) * 2 * x->core->out_cnt);
+  x->end_mess_arr = (t_atom*)arena_carve(arena, sizeof(t_atom) * (1 + 2 * x->core->channel_cnt));
+  x->reply_arr = (t_atom*)arena_carve(arena, sizeof(t_atom) * 2 * x->reply_len);
+  x->sel_arr = (t_int32*)arena_carve(arena, sizeof(t_int32) * x->core->channel_cnt);
+}
+
+// ====  _DIFFUSE_REPLY_BEGIN and _DIFFUSE_REPLY_END  ====
+
+//******************************************************************************
+//  Returns the atoms for a reply, x->reply_len of them, or NULL if the allocation failed.
+//  Call _diffuse_reply_end once the reply is sent.
+//  The queries can arrive on the main thread and on the scheduler thread at the same time:
+//  each thread uses its own half of the scratch, so the replies are built without allocating.
+//  A query sent again from the outlet of a reply, before the reply returns, cannot reuse
+//  the scratch that the objects downstream are still reading: it gets atoms of its own.
+//
+t_atom* _diffuse_reply_begin(t_diffuse* x) {
+
+  t_int32 half = isr() ? 1 : 0;
+
+  if (x->reply_depth[half]++ == 0) { return x->reply_arr + half * x->reply_len; }
+
+  t_atom* mess_arr = (t_atom*)sysmem_newptr(sizeof(t_atom) * x->reply_len);
+  if (!mess_arr) { x->reply_depth[half]--; }
+  return mess_arr;
+}
+
+void _diffuse_reply_end(t_diffuse* x, t_atom* mess_arr) {
+
+  t_int32 half = isr() ? 1 : 0;
+
+  x->reply_depth[half]--;
+  if (mess_arr != x->reply_arr + half * x->reply_len) { sysmem_freeptr(mess_arr); }
+}
+
+// ====  _DIFFUSE_POST_LOCK and _DIFFUSE_POST_UNLOCK  ====
+
+//******************************************************************************
+//  Take the lock before posting commands to the core, and release it once they are posted.
+//  The queue has a single producer, but with Overdrive the messages arrive on the main thread
+//  and on the scheduler thread: they take turns. Only the control threads take the lock,
+//  the perform routine reads the queue without it.
+//  Unlocking applies the commands first if the audio is not running, see _diffuse_sync.
+//
+void _diffuse_post_lock(t_diffuse* x) {
+
+  critical_enter(x->post_lock);
+}
+
+void _diffuse_post_unlock(t_diffuse* x) {
+
+  _diffuse_sync(x, false);
+  critical_exit(x->post_lock);
+}
+
+// ====  _DIFFUSE_SYNC  ====
+
+//******************************************************************************
+//  Called after posting commands to the core, with the lock held.
+//  While the audio is running the perform routine applies them at the start of the next vector.
+//  Otherwise they are applied right away from the control thread: before the first dsp64 and
+//  after the audio stops, or if is_stalled is set because the perform routine was not called
+//  since the clock was set, in a muted poly~ voice or subpatcher.
+//  A curve change waits for the audio thread to switch to the previous one, and is published here.
+//  While commands or a curve change are waiting, the clock calls again after sync_interval:
+//  the control threads never wait for the audio thread.
+//
+void _diffuse_sync(t_diffuse* x, t_bool is_stalled) {
+
+  t_bool is_drain = is_stalled || core_atomic_load(&x->is_perform_off);
+
+  if (is_drain) { _diffuse_drain(x); }
+  if (_diffuse_curves_publish(x) && is_drain) { _diffuse_drain(x); }
+
+  if ((x->core->curves_is_dirty || !core_cmd_is_empty(x->core)) && !x->is_sync_armed) {
+    x->is_sync_armed = true;
+    x->sync_cnt = core_atomic_load(&x->perform_cnt);
+    clock_fdelay(x->sync_clock, x->sync_interval);
+  }
+}
+
+// ====  DIFFUSE_SYNC_TICK  ====
+
+//******************************************************************************
+//  Called by the clock: the perform routine is not running if it was not called since the clock was set.
+//
+void diffuse_sync_tick(t_diffuse* x) {
+
+  critical_enter(x->post_lock);
+  x->is_sync_armed = false;
+  _diffuse_sync(x, core_atomic_load(&x->perform_cnt) == x->sync_cnt);
+  critical_exit(x->post_lock);
+}
+
+// ====  _DIFFUSE_DRAIN  ====
+
+//******************************************************************************
+//  Apply the commands from the control thread, with the lock held.
+//  The queue has a single consumer: nothing is applied while the perform routine runs,
+//  and the perform routine skips a vector rather than run while the commands are applied.
+//
+void _diffuse_drain(t_diffuse* x) {
+
+  if (!core_atomic_cas(&x->is_core_busy, 0, 1)) { return; }
+  core_cmd_drain(x->core);
+  core_atomic_store(&x->is_core_busy, 0);
+}
+
+// ====  _DIFFUSE_CURVES_PUBLISH  ====
+
+//******************************************************************************
+//  Publish the curve change not published yet, if any, with the lock held,
+//  and update the states with the new curves, for the ramps posted from now on.
+//  Returns true if a change was published, false if there is none or it has to wait.
+//
+t_bool _diffuse_curves_publish(t_diffuse* x) {
+
+  if (!x->core->curves_is_dirty || (core_curves_publish(x->core) != ERR_NONE)) { return false; }
+
+  for (t_int32 st = 0; st < x->state_cnt; st++) {
+    _state_calc_absc(x->core, x->state_arr + st);
+  }
+
+  return true;
 }
 
 // ========  CHANNEL METHODS  ========
@@ -679,111 +1144,100 @@ t_channel* _channel_find(t_diffuse* x, t_atom* argv) {
   // Test that the atom contains a valid int
   if ((atom_gettype(argv) == A_LONG)
       && ((index = (t_int32)atom_getlong(argv)) >= 0)
-      && (index < x->channel_cnt)) {
-    return (x->channel_arr + index);
+      && (index < x->core->channel_cnt)) {
+    return (x->core->channel_arr + index);
   }
 
   // Otherwise return NULL
   else { return NULL; }
 }
 
-// ====  _CHANNEL_INIT  ====
+// ====  _CHANNEL_SELECT  ====
 
 //******************************************************************************
-//  Initialize a channel. Call before _channel_alloc to set all array pointers to NULL.
+//  Parse a selection of channels, one of:
+//    (int: channel index)
+//    all
+//    range (int: first channel index) (int: channel count)
+//    list (int: channel count) (int: channel index) {x count}
+//  The indices are written to x->sel_arr and their number to x->sel_cnt.
+//  Returns the number of atoms of the selection, or 0 if it is invalid.
 //
-void _channel_init(t_diffuse* x, t_channel* channel) {
-
-  // Initialize the channel parameters
-  channel->cntd = INDEFINITE;
-  channel->velocity = 1.0;
-  channel->gain = 1.0;
-
-  channel->interp_func = x->xfade_func;
-  channel->interp_inv_func = x->xfade_inv_func;
-  channel->interp_param = x->xfade_param;
-
-  channel->is_on = false;
-  channel->is_frozen = false;
-  channel->is_mute_ramp = false;
+t_int32 _channel_select(t_diffuse* x, t_int32 argc, t_atom* argv) {
 
-  channel->out_cnt = x->out_cnt;
-  channel->state_ind = -1;
+  x->sel_cnt = 0;
+  if (argc < 1) { return 0; }
 
-  channel->mode_type = MODE_TYPE_FIX;
-
-  // Set the array pointers to NULL
-  channel->U_cur = NULL;
-  channel->A_cur = NULL;
-  channel->U_targ = NULL;
-  channel->A_targ = NULL;
-}
+  // A single channel
+  if (atom_gettype(argv) == A_LONG) {
+    t_channel* channel = _channel_find(x, argv);
+    if (!channel) { return 0; }
+    x->sel_arr[x->sel_cnt++] = (t_int32)(channel - x->core->channel_arr);
+    return 1;
+  }
 
-// ====  _CHANNEL_ALLOC  ====
+  if (atom_gettype(argv) != A_SYM) { return 0; }
 
-//******************************************************************************
-//  Allocate arrays for a channel.
-//  Call only after _channel_init to make sure the array pointers were set NULL.
-//  Returns:
-//  ERR_NONE:  Succesful initialization
-//  ERR_ALLOC:  Failed allocation
-//
-t_my_err _channel_alloc(t_diffuse* x, t_channel* channel, t_double u, t_double a) {
+  switch (sym_id(atom_getsym(argv))) {
 
-  // Allocate the arrays
-  channel->U_cur = (t_double*)sysmem_newptr(sizeof(t_double) * channel->out_cnt);
-  channel->A_cur = (t_double*)sysmem_newptr(sizeof(t_double) * channel->out_cnt);
-  channel->U_targ = (t_double*)sysmem_newptr(sizeof(t_double) * channel->out_cnt);
-  channel->A_targ = (t_double*)sysmem_newptr(sizeof(t_double) * channel->out_cnt);
+  case SYM_ALL:
+    for (t_int32 in = 0; in < x->core->channel_cnt; in++) { x->sel_arr[x->sel_cnt++] = in; }
+    return 1;
 
-  // Test the allocations and free if one failed
-  if (!channel->U_cur || !channel->A_cur || !channel->U_targ || !channel->A_targ) {
-    _channel_free(x, channel);
-    return ERR_ALLOC;
+  case SYM_RANGE: {
+    if ((argc < 3) || (atom_gettype(argv + 1) != A_LONG) || (atom_gettype(argv + 2) != A_LONG)) { return 0; }
+    t_int32 first = (t_int32)atom_getlong(argv + 1);
+    t_int32 cnt = (t_int32)atom_getlong(argv + 2);
+    if ((first < 0) || (cnt < 1) || (first + cnt > x->core->channel_cnt)) { return 0; }
+    for (t_int32 in = first; in < first + cnt; in++) { x->sel_arr[x->sel_cnt++] = in; }
+    return 3;
   }
 
-  // Initialize the values in the arrays
-  for (t_int32 param = 0; param < channel->out_cnt; param++) {
-    channel->U_cur[param] = u;
-    channel->A_cur[param] = a;
-    channel->U_targ[param] = u;
-    channel->A_targ[param] = a;
+  case SYM_LIST: {
+    if ((argc < 2) || (atom_gettype(argv + 1) != A_LONG)) { return 0; }
+    t_int32 cnt = (t_int32)atom_getlong(argv + 1);
+    if ((cnt < 1) || (cnt > x->core->channel_cnt) || (argc < cnt + 2)) { return 0; }
+    for (t_int32 ind = 0; ind < cnt; ind++) {
+      t_channel* channel = _channel_find(x, argv + 2 + ind);
+      if (!channel) { x->sel_cnt = 0; return 0; }
+      x->sel_arr[x->sel_cnt++] = (t_int32)(channel - x->core->channel_arr);
+    }
+    return cnt + 2;
   }
 
-  return ERR_NONE;
+  default:
+    return 0;
+  }
 }
 
-// ====  _CHANNEL_FREE  ====
+// ====  _CHANNEL_POST_SEL  ====
 
 //******************************************************************************
-//  Free a channel.
+//  Post the same command to all the selected channels, in one batch, with the lock held.
+//  Returns ERR_NONE, or ERR_ARR_FULL if the queue is full and nothing is posted.
 //
-void _channel_free(t_diffuse* x, t_channel* channel) {
+t_my_err _channel_post_sel(t_diffuse* x, t_cmd_type type, t_int32 val_i, t_double val_d) {
 
-  // Free the arrays and set to NULL
-  if (channel->U_cur)  { sysmem_freeptr(channel->U_cur); channel->U_cur = NULL; }
-  if (channel->A_cur)  { sysmem_freeptr(channel->A_cur); channel->A_cur = NULL; }
-  if (channel->U_targ) { sysmem_freeptr(channel->U_targ); channel->U_targ = NULL; }
-  if (channel->A_targ) { sysmem_freeptr(channel->A_targ); channel->A_targ = NULL; }
-}
+  t_my_err err = ERR_NONE;
 
-// ====  _CHANNEL_CALC_ABSC  ====
+  _diffuse_post_lock(x);
+  core_post_begin(x->core);
 
-//******************************************************************************
-//  Recalculate the abscissa values for a channel.
-//
-void _channel_calc_absc(t_diffuse* x, t_channel* channel) {
-
-  for (t_int32 ch = 0; ch < channel->out_cnt; ch++) {
-    channel->U_cur[ch] = channel->interp_inv_func(channel->A_cur[ch], channel->interp_param);
-    channel->U_targ[ch] = channel->interp_inv_func(channel->A_targ[ch], channel->interp_param);
+  for (t_int32 ind = 0; (ind < x->sel_cnt) && (err == ERR_NONE); ind++) {
+    err = core_post(x->core, type, x->sel_arr[ind], val_i, val_d, 0);
   }
+
+  if (err == ERR_NONE) { core_post_end(x->core); }
+  else { core_post_cancel(x->core); }
+  _diffuse_post_unlock(x);
+
+  return (err == ERR_NONE) ? ERR_NONE : ERR_ARR_FULL;
 }
 
 // ====  CHANNEL_CHANNEL  ====
 
 //******************************************************************************
-//  Interface method to call:  set / get / post / on / off / current
+//  Interface method to call:  set / matrix / get / post / on / off / current
 //
 void channel_channel(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
@@ -791,40 +1245,83 @@ void channel_channel(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   // Argument 0 should be a command
   MY_ASSERT((argc < 1) || (atom_gettype(argv) != A_SYM),
-    "channel:  Arg 0:  Command expected: set / get / post / on / off / current.");
+    "channel:  Arg 0:  Command expected: set / matrix / get / post / on / off / current.");
   t_symbol* cmd = atom_getsym(argv);
 
   // Test that the array of channels exists
-  MY_ASSERT(!x->channel_arr, "channel:  No array of channels available.");
+  MY_ASSERT(!x->core->channel_arr, "channel:  No array of channels available.");
+
+  switch (sym_id(cmd)) {
 
   // ====  SET:  Set the channel values  ====
   // channel set (int: channel index) (float: [0-1] gain) {x N}
 
-  if (cmd == gensym("set")) {
+  case SYM_SET: {
 
-    MY_ASSERT(argc != x->out_cnt + 2, "channel set:  %i args expected:  channel set (int: index) (float: [0-1] gain) {x %i}", x->out_cnt + 2, x->out_cnt);
+    MY_ASSERT(argc != x->core->out_cnt + 2, "channel set:  %i args expected:  channel set (int: index) (float: [0-1] gain) {x %i}", x->core->out_cnt + 2, x->core->out_cnt);
 
     // Argument 1 should reference a channel
     t_channel* channel = _channel_find(x, argv + 1);
     MY_ASSERT(!channel, "channel set:  Arg 1:  Channel not found.");
 
     // Test that the following arguments are float and between 0 and 1
-    for (t_int32 ch = 2; ch < x->out_cnt + 2; ch++) {
+    for (t_int32 ch = 2; ch < x->core->out_cnt + 2; ch++) {
       MY_ASSERT((((atom_gettype(argv + ch) != A_FLOAT) && (atom_gettype(argv + ch) != A_LONG))
         || (atom_getfloat(argv + ch) < 0) || (atom_getfloat(argv + ch) > 1)),
         "channel set:  Arg %i:  Float [0-1] expected for the gain.", ch);
       }
 
-    // Set the channel values
-    for (t_int32 ch = 0; ch < x->out_cnt; ch++) {
-      channel->A_cur[ch] = atom_getfloat(argv + ch + 2);
+    // Post the channel values, the temporary state is used as scratch
+    _diffuse_post_lock(x);
+    for (t_int32 ch = 0; ch < x->core->out_cnt; ch++) {
+      x->state_tmp->A_arr[ch] = atom_getfloat(argv + ch + 2);
     }
+    t_my_err err = core_post_gains(x->core, (t_int32)(channel - x->core->channel_arr), x->state_tmp->A_arr);
+    _diffuse_post_unlock(x);
+    MY_ASSERT(err != ERR_NONE, "channel set:  The command queue is full, the message is dropped.");
+    break;
+  }
+
+  // ====  MATRIX:  Set the values of all the channels at once  ====
+  // channel matrix (float: [0-1] gain) {x N x M}, channel after channel
+
+  case SYM_MATRIX: {
+
+    t_int32 val_cnt = x->core->channel_cnt * x->core->out_cnt;
+    MY_ASSERT(argc != val_cnt + 1, "channel matrix:  %i args expected:  channel matrix (float: [0-1] gain) {x %i x %i}",
+      val_cnt + 1, x->core->channel_cnt, x->core->out_cnt);
+
+    // Test all the values before posting any
+    for (t_int32 ind = 1; ind < val_cnt + 1; ind++) {
+      MY_ASSERT((((atom_gettype(argv + ind) != A_FLOAT) && (atom_gettype(argv + ind) != A_LONG))
+        || (atom_getfloat(argv + ind) < 0) || (atom_getfloat(argv + ind) > 1)),
+        "channel matrix:  Arg %i:  Float [0-1] expected for the gain.", ind);
+    }
+
+    // Post the rows in one batch, applied at the start of the same vector
+    t_atom* atom = argv + 1;
+    t_my_err err = ERR_NONE;
+
+    _diffuse_post_lock(x);
+    core_post_begin(x->core);
+
+    for (t_int32 in = 0; (in < x->core->channel_cnt) && (err == ERR_NONE); in++) {
+      for (t_int32 ch = 0; ch < x->core->out_cnt; ch++) { x->state_tmp->A_arr[ch] = atom_getfloat(atom++); }
+      err = core_post_gains(x->core, in, x->state_tmp->A_arr);
+    }
+
+    if (err == ERR_NONE) { core_post_end(x->core); }
+    else { core_post_cancel(x->core); }
+    _diffuse_post_unlock(x);
+
+    MY_ASSERT(err != ERR_NONE, "channel matrix:  The command queue is full, the message is dropped.");
+    break;
   }
 
   // ====  GET:  Get information on a channel as a message  ====
   // channel get (int: channel index)
 
-  else if (cmd == gensym("get")) {
+  case SYM_GET: {
 
     MY_ASSERT(argc != 2, "channel get:  2 args expected:  channel get (int: channel index)");
 
@@ -834,44 +1331,45 @@ void channel_channel(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
     // Output a message with information about the channel
     //   channel (int: index) (float: gain) {x N} (float: velocity) (float: gain) (sym: on/off) (sym: frozen/active)
-    t_atom* mess_arr = (t_atom*)sysmem_newptr(sizeof(t_atom) * (channel->out_cnt + 5));
-    MY_ASSERT(!mess_arr, "channel get:  Allocation failed for the output message array.");
+    t_atom* mess_arr = _diffuse_reply_begin(x);
+    MY_ASSERT(!mess_arr, "channel get:  Allocation failed for the reply.");
     t_atom* atom = mess_arr;
 
-    atom_setlong(atom++, channel - x->channel_arr);
+    atom_setlong(atom++, channel - x->core->channel_arr);
     for (t_int32 ch = 0; ch < channel->out_cnt; ch++){ atom_setfloat(atom++, channel->A_cur[ch]); }
     atom_setfloat(atom++, channel->velocity);
-    atom_setfloat(atom++, channel->gain);
-    atom_setsym(atom++, channel->is_on ? gensym("on") : gensym ("off"));
-    atom_setsym(atom++, channel->is_frozen ? gensym("frozen") : gensym("active"));
+    atom_setfloat(atom++, channel->gain_targ);
+    atom_setsym(atom++, channel->is_on ? SYM(ON) : SYM(OFF));
+    atom_setsym(atom++, channel->is_frozen ? SYM(FROZEN) : SYM(ACTIVE));
 
-    outlet_anything(x->outl_mess, gensym("channel"), 5 + channel->out_cnt, mess_arr);
-    sysmem_freeptr(mess_arr);
+    outlet_anything(x->outl_mess, SYM(CHANNEL), 5 + channel->out_cnt, mess_arr);
+    _diffuse_reply_end(x, mess_arr);
+    break;
   }
 
   // ====  POST:  Post information on the array of channels  ====
   // channel post (int: channel index / sym: all)
 
-  else if (cmd == gensym("post")) {
+  case SYM_POST: {
 
     MY_ASSERT(argc != 2, "channel post:  2 args expected:  channel post (int: channel index / sym: all)");
 
     // If Arg 1 is a symbol and equal to "all"
-    if ((atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == gensym ("all"))) {
+    if ((atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == SYM(ALL))) {
 
       // Post information on all the channels
-      POST("There are %i input channels and %i output channels.  Master: %f", x->channel_cnt, x->out_cnt, x->master);
+      POST("There are %i input channels and %i output channels.  Master: %f", x->core->channel_cnt, x->core->out_cnt, x->core->master);
       t_channel* channel = NULL;
 
-      for (t_int32 ch = 0; ch < x->channel_cnt; ch++) {
-        channel = x->channel_arr + ch;
+      for (t_int32 ch = 0; ch < x->core->channel_cnt; ch++) {
+        channel = x->core->channel_arr + ch;
         POST("  Input %i:  Vel: %f - Gain: %f - Cntd: %i - %s - %s",
-          ch, channel->velocity, channel->gain, channel->cntd, (channel->is_on ? gensym("on") : gensym("off"))->s_name,
-          (channel->is_frozen ? gensym("frozen") : gensym("active"))->s_name);
+          ch, channel->velocity, channel->gain, channel->cntd, (channel->is_on ? SYM(ON) : SYM(OFF))->s_name,
+          (channel->is_frozen ? SYM(FROZEN) : SYM(ACTIVE))->s_name);
         }
 
-      for (t_int32 ch = 0; ch < x->channel_cnt; ch++) {
-        POST("  Output %i:  Gain: %f", ch, x->out_gain[ch]);
+      for (t_int32 ch = 0; ch < x->core->channel_cnt; ch++) {
+        POST("  Output %i:  Gain: %f", ch, x->core->out_gain[ch]);
       }
     }
 
@@ -884,9 +1382,9 @@ void channel_channel(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
       // Post detailed information on one channel
       POST("Input %i:  Velocity: %f - Gain: %f - %s - %s",
-        channel - x->channel_arr, channel->velocity, channel->gain,
-        (channel->is_on ? gensym("on") : gensym("off"))->s_name,
-        (channel->is_frozen ? gensym("frozen") : gensym("active"))->s_name);
+        channel - x->core->channel_arr, channel->velocity, channel->gain,
+        (channel->is_on ? SYM(ON) : SYM(OFF))->s_name,
+        (channel->is_frozen ? SYM(FROZEN) : SYM(ACTIVE))->s_name);
 
       for (t_int32 param = 0; param < channel->out_cnt; param++) {
         POST("  Value %i:  Current: U = %f - A = %f - Target: U = %f - A = %f",
@@ -896,23 +1394,27 @@ void channel_channel(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
     // ... Otherwise the arguments are invalid
     else { MY_ASSERT(argc != 2, "channel post:  Invalid args:  channel post (int: channel index / sym: all)"); }
+    break;
   }
 
   // ====  ON / OFF:  Set one or all of the arrays on or off  ====
   // channel (on / off) (int: channel index / sym: all)
 
-  else if ((cmd == gensym("on")) || (cmd == gensym("off"))) {
+  case SYM_ON:
+  case SYM_OFF: {
 
-    t_bool on_off = (cmd == gensym("on")) ? true : false;
+    t_bool on_off = (cmd == SYM(ON)) ? true : false;
 
     MY_ASSERT(argc != 2, "channel %s:  2 args expected:  channel (on / off) (int: channel index / sym: all)", cmd->s_name);
 
     // If Arg 1 is a symbol and equal to "all"
-    if ((atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == gensym("all"))) {
+    if ((atom_gettype(argv + 1) == A_SYM) && (atom_getsym(argv + 1) == SYM(ALL))) {
 
       // Set all the channels to on or off
-      t_channel* channel = x->channel_arr + x->channel_cnt;
-      do { channel--; channel->is_on = on_off; } while (channel != x->channel_arr);
+      _diffuse_post_lock(x);
+      t_my_err err = core_post(x->core, CMD_ON, -1, on_off, 0, 0);
+      _diffuse_post_unlock(x);
+      MY_ASSERT(err != ERR_NONE, "channel %s:  The command queue is full, the message is dropped.", cmd->s_name);
     }
 
     // ... If Arg 1 is an int
@@ -923,14 +1425,18 @@ void channel_channel(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
       MY_ASSERT(!channel, "channel %s:  Arg 1:  Channel not found.", cmd->s_name);
 
       // Set the channel to on or off
-      channel->is_on = on_off;
+      _diffuse_post_lock(x);
+      t_my_err err = core_post(x->core, CMD_ON, (t_int32)(channel - x->core->channel_arr), on_off, 0, 0);
+      _diffuse_post_unlock(x);
+      MY_ASSERT(err != ERR_NONE, "channel %s:  The command queue is full, the message is dropped.", cmd->s_name);
     }
+    break;
   }
 
   // ====  CURRENT:  Set the current channel for output  ====
   // channel current (int: channel index)
 
-  else if (cmd == gensym("current")) {
+  case SYM_CURRENT: {
 
     MY_ASSERT(argc != 2, "channel current (int: channel index)");
 
@@ -940,36 +1446,40 @@ void channel_channel(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
     // Set the current channel for output
     x->outp_channel = channel;
+    break;
   }
 
   // ====  Otherwise the command is invalid  ====
 
-  else {
-    MY_ERR("channel:  Arg 0:  Command expected: get / post / on / off / current.");
+  default:
+    MY_ERR("channel:  Arg 0:  Command expected: set / matrix / get / post / on / off / current.");
+    break;
   }
 }
 
 // ====  CHANNEL_GAIN_IN  ====
 
 //******************************************************************************
-//  gain_in (int: input channel index) (float: channel gain)
+//  gain_in (int: input channel index / channels) (float: channel gain)
+//  The channels are selected with:  all / range (int: first) (int: count) / list (int: count) (int: index) {x count}
 //
 void channel_gain_in(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv) {
 
   TRACE("gain_in");
 
-  MY_ASSERT(argc != 2, "gain_in:  2 args expected:  gain_in (int: input channel index) (float: channel gain)");
+  // The first arguments should select the channels
+  t_int32 sel_len = _channel_select(x, argc, argv);
+  MY_ASSERT(!sel_len, "gain_in:  Arg 0:  Channel not found, or invalid selection: all / range (int: first) (int: count) / list (int: count) (int: index) {x count}.");
 
-  // Argument 0 should reference a channel
-  t_channel* channel = _channel_find(x, argv);
-  MY_ASSERT(!channel, "gain_in:  Arg 0:  Channel not found.");
+  MY_ASSERT(argc != sel_len + 1, "gain_in:  Expects:  gain_in (int: input channel index / channels) (float: channel gain)");
 
-  // Argument 1 should be a float between 0 and 1
-  MY_ASSERT((atom_gettype(argv + 1) != A_FLOAT) && (atom_gettype(argv + 1) != A_LONG), "gain_in:  Arg 1:  Float [0-1] expected: the gain of the input channel.");
-  t_double gain = (t_double)atom_getfloat(argv + 1);
-  MY_ASSERT(gain < 0, "gain_in:  Arg 1:  Positive float expected: the gain of the input channel.");
+  // The last argument should be a positive float
+  MY_ASSERT((atom_gettype(argv + sel_len) != A_FLOAT) && (atom_gettype(argv + sel_len) != A_LONG), "gain_in:  Arg %i:  Float [0-1] expected: the gain of the input channel.", sel_len);
+  t_double gain = (t_double)atom_getfloat(argv + sel_len);
+  MY_ASSERT(gain < 0, "gain_in:  Arg %i:  Positive float expected: the gain of the input channel.", sel_len);
 
-  channel->gain = gain;
+  MY_ASSERT(_channel_post_sel(x, CMD_GAIN_IN, 0, gain) != ERR_NONE,
+    "gain_in:  The command queue is full, the message is dropped.");
 }
 
 // ====  CHANNEL_MUTE_RAMP  ====
@@ -992,5 +1502,8 @@ void channel_mute_ramp(t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv)
   t_int32 is_mute_ramp = (t_int32)atom_getlong(argv + 1);
   MY_ASSERT((is_mute_ramp != 0) && (is_mute_ramp != 1), "mute_ramp:  Arg 1:  0 or 1 expected to mute end or ramp messages.");
 
-  channel->is_mute_ramp = is_mute_ramp;
+  _diffuse_post_lock(x);
+  t_my_err err = core_post(x->core, CMD_MUTE_RAMP, (t_int32)(channel - x->core->channel_arr), is_mute_ramp, 0, 0);
+  _diffuse_post_unlock(x);
+  MY_ASSERT(err != ERR_NONE, "mute_ramp:  The command queue is full, the message is dropped.");
 }
@@ -4,7 +4,7 @@
 // ========  INCLUDES  ========
 
 #include "max_util.h"
-#include "envelopes.h"
+#include "diffuse_core.h"
 #include "dict.h"
 
 // ========  DEFINES  ========
@@ -14,69 +14,91 @@
 #define OUT_CNT_DEF     2
 #define STATE_CNT_DEF   10
 
-#define INDEFINITE    -1    // Has to be negative to be intrinsically differentiated from valid countdown value
+#define OUTP_RATE_DEF   30    // Default rate in Hz of the output message
+#define OUTP_RATE_MAX   1000  // Maximum rate in Hz of the output message
+
+#define SYM_HASH_SIZE   128   // Size of the table of symbols: a power of 2, at least twice SYM_CNT
+
+#define SYNC_CHECK_MS   20    // Minimum time in ms after which commands not applied are checked again
+#define SYNC_VEC_CNT    4     // Number of vectors without a call to the perform routine, after which it is not running
+
+// ========  SYMBOLS  ========
+// The symbols of the commands and of the replies, interned once by main.
+// The methods send them without hashing a string, and dispatch the commands with a switch
+// on the index that sym_id finds in a table keyed by the address of the symbol.
+
+typedef enum _sym_id {
+
+  SYM_NONE = -1,  // Not in the table
+  SYM_EMPTY,
+  SYM_NULL,
+  SYM_DSP_ADD64,
+  SYM_DIFFUSE,
+  SYM_STATS,
+  SYM_OUTPUT,
+  SYM_CHANNEL,
+  SYM_STATE,
+  SYM_END_RAMP,
+  SYM_END_RAMPS,
+  SYM_ON,
+  SYM_OFF,
+  SYM_FROZEN,
+  SYM_ACTIVE,
+  SYM_ALL,
+  SYM_DB,
+  SYM_AMPL,
+  SYM_RAMP,
+  SYM_XFADE,
+  SYM_TABLE,
+  SYM_LINEAR,
+  SYM_SPLINE,
+  SYM_POLY,
+  SYM_EXP,
+  SYM_SIGMOID,
+  SYM_SQRT,
+  SYM_SINUS,
+  SYM_LUT,
+  SYM_SILENCE,
+  SYM_SMOOTH,
+  SYM_CONTROL_RATE,
+  SYM_EXACT,
+  SYM_THREADS,
+  SYM_END_MERGE,
+  SYM_SET,
+  SYM_GET,
+  SYM_POST,
+  SYM_CURRENT,
+  SYM_MATRIX,
+  SYM_RANGE,
+  SYM_LIST,
+  SYM_NEW,
+  SYM_FREE,
+  SYM_RESIZE,
+  SYM_NAME,
+  SYM_STORE,
+  SYM_SAVE,
+  SYM_LOAD,
+  SYM_DELETE,
+  SYM_RENAME,
+  SYM_STATES,
+  SYM_STATE_SAVE,
+  SYM_STATE_LOAD,
+  SYM_STATE_DELETE,
+  SYM_STATE_RENAME,
+  SYM_ORDINATE,
+  SYM_COUNT,
+  SYM_CNT
+
+} t_sym_id;
+
+extern t_symbol* sym_arr[SYM_CNT];
+
+#define SYM(id)  (sym_arr[SYM_##id])
 
 // ========  STRUCTURES  ========
 
-typedef struct _state     t_state;
-typedef struct _channel   t_channel;
 typedef struct _diffuse   t_diffuse;
 
-// ========  STRUCTURE:  STATE  ========
-// Used to store a state
-
-typedef struct _state {
-
-  t_double* A_arr;      // Vector of abscissa values: 0 to 1
-  t_double* U_rm_arr;   // Vector of ordinate values using the ramping function: 0 to 1
-  t_double* U_xf_arr;   // Vector of ordinate values using the crossfade function: 0 to 1
-
-  t_double* U_cur;  // Pointer used to select between ramping and crossfading
-
-  t_int32 cnt;      // Number of output channels
-  t_int32 index;    // Index of the state, _state_init sets to -1, _state_arr_new sets to index
-
-  t_symbol* name;   // Name of the state
-
-} t_state;
-
-// ========  STRUCTURE:  CHANNEL  ========
-// Used to store an input channel
-
-typedef enum _mode_type {
-
-  MODE_TYPE_OFF,    // The channel is off: no processing in the perform function
-  MODE_TYPE_FIX,    // The channel is fixed: no ramping
-  MODE_TYPE_VAR,    // The channel is variable: amplitude ramping
-
-} t_mode_type;
-
-typedef struct _channel {
-
-  t_double* U_cur;    // Vector of N current abscissa values: 0 to 1
-  t_double* A_cur;    // Vector of N current ordinate value: 0 to 1
-  t_double* U_targ;   // Vector of N target abscissa values: 0 to 1
-  t_double* A_targ;   // Vector of N target ordinate values: 0 to 1
-
-  t_int32  cntd;      // Countdown in samples
-  t_double velocity;  // Velocity multiplier to affect the rate of change
-  t_double gain;      // Gain for the input channel
-
-  t_ramp   interp_func;
-  t_ramp   interp_inv_func;
-  t_double interp_param;
-
-  t_int32  out_cnt;   // Number of output channels
-  t_int32  state_ind; // Index of the state ramping to
-
-  t_bool is_on;         // Is the channel on or not
-  t_bool is_frozen;     // Is the channel frozen or not
-  t_bool is_mute_ramp;  // Send a message on ramp completion or not
-
-  t_mode_type mode_type;
-
-} t_channel;
-
 // ========  STRUCTURE:  DIFFUSE  ========
 
 typedef enum _output_type {
@@ -88,37 +110,58 @@ typedef enum _output_type {
 } t_output_type;
 
 
+//******************************************************************************
+//  Passed to dict_save to save a state, with the scratch atoms to use.
+//
+typedef struct _state_save {
+
+  t_state* state;
+  t_atom*  atom_arr;  // At least state->cnt atoms
+
+} t_state_save;
+
 typedef struct _diffuse {
 
   t_pxobject obj;           // Use t_pxobject for MSP objects
 
   void*    outl_mess;       // Last outlet: for messages
 
-  t_channel* channel_arr;   // Array of input channels
-  t_int32    channel_cnt;   // Number of input channels
+  t_core   core[1];         // The mixing core: channels, gains and curves
+  volatile int32_t is_perform_off; // The perform routine cannot be running: set when created and when the audio stops, cleared by dsp64
+  t_critical post_lock;     // Taken by the control threads to post commands, see _diffuse_post_lock
+  volatile int32_t is_core_busy; // Set while a thread runs the core: the perform routine, or a control thread applying commands
+  volatile int32_t perform_cnt;  // Number of calls to the perform routine, to tell when it is not called
+  void*    sync_clock;      // Clock checking the commands and the curve change not applied yet, see _diffuse_sync
+  t_bool   is_sync_armed;   // The clock is set
+  int32_t  sync_cnt;        // Number of calls to the perform routine when the clock was set
+  t_double sync_interval;   // Interval in ms of the clock: at least SYNC_VEC_CNT vectors
 
   t_state* state_arr;       // Array of states
   t_int32  state_cnt;       // Number of states
   t_state  state_tmp[1];    // For temporary calculations
 
-  t_double  master;         // Master gain
-  t_int32   out_cnt;        // Number of output channels
-  t_double* out_gain;       // Vector of gains for the output channels
+  t_channel* outp_channel;  // Current channel for output
+  t_output_type outp_type;  // Type of output
+  t_atom*    outp_mess_arr; // Output message array
+  t_double*  outp_buf_arr;  // Double buffer of snapshots of the current channel: 2 x out_cnt values
+  volatile int32_t outp_seq;   // Number of snapshots completed by the audio thread, the last one in buffer outp_seq % 2
+  volatile int32_t outp_start; // Number of snapshots started by the audio thread
+  int32_t    outp_sent;     // Snapshot last sent by the clock
+  void*      outp_clock;    // Clock sending the output message from the scheduler
+  t_double   outp_interval; // Interval in ms between two output messages
 
-  t_double ramp_param;      // Ramping parameter
-  t_ramp   ramp_func;       // Ramping function
-  t_ramp   ramp_inv_func;   // Inverse ramping function
+  void*      end_clock;     // Clock sending the end_ramp messages from the scheduler
+  t_bool     end_is_merged; // Send the ramps ending on the same sample in one message
+  t_atom*    end_mess_arr;  // Message array for the ramp completions: 1 + 2 x channel_cnt atoms
 
-  t_double xfade_param;     // Crossfade parameter
-  t_ramp   xfade_func;      // Crossfade function
-  t_ramp   xfade_inv_func;  // Inverse crossfade function
+  t_atom*    reply_arr;     // Scratch for the replies to the queries: one half per thread, see _diffuse_reply_begin
+  t_int32    reply_len;     // Number of atoms in each half: the longest reply
+  t_int32    reply_depth[2]; // Number of replies in progress on each thread, the nested ones allocate their atoms
 
-  t_double  samplerate;     // Stores the samplerate
-  t_double  msr;            // The samplerate in milliseconds
+  t_int32*   sel_arr;       // Indices of the channels selected by the last batch message
+  t_int32    sel_cnt;       // Number of channels selected
 
-  t_channel* outp_channel;  // Current channel for output
-  t_output_type outp_type;  // Type of output
-  t_atom*    outp_mess_arr; // Output message array
+  void*      block;         // Single allocation holding the message arrays and state_tmp, see _diffuse_layout
 
   t_symbol* dict_sym;       // Name of a dictionary for storage
 
@@ -131,27 +174,47 @@ typedef struct _diffuse {
 void* diffuse_new       (t_symbol* sym, t_int32 argc, t_atom* argv);
 void  diffuse_free      (t_diffuse* x);
 void  diffuse_dsp64     (t_diffuse* x, t_object* dsp64, t_int32* count, t_double samplerate, long maxvectorsize, long flags);
+void  diffuse_dspstate  (t_diffuse* x, long is_on);
 void  diffuse_perform64 (t_diffuse* x, t_object* dsp64, t_double** ins, long numins, t_double** outs, long numouts, long sampleframes, long flags, void* userparam);
 void  diffuse_assist    (t_diffuse* x, void* b, long msg, t_int32 arg, char* str);
 
+// ========  SYMBOL METHODS  ========
+
+void     sym_init (void);
+t_sym_id sym_id   (t_symbol* sym);
+
 // ======== DIFFUSE METHODS ========
 
 void diffuse_bang       (t_diffuse* x);
 void diffuse_dictionary (t_diffuse* x, t_symbol* dict_sym);
 void diffuse_get        (t_diffuse* x);
+void diffuse_stats      (t_diffuse* x);
 void diffuse_master     (t_diffuse* x, double master);
 void diffuse_gain_out   (t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv);
-void diffuse_output     (t_diffuse* x, t_symbol* outp_type);
+void diffuse_output     (t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv);
+void diffuse_outp_tick  (t_diffuse* x);
+void _diffuse_outp_snap (t_diffuse* x);
 void diffuse_set        (t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv);
+void _diffuse_set       (t_diffuse* x, t_int32 argc, t_atom* argv);
+
+t_my_err _diffuse_parse_breaks (t_int32 argc, t_atom* argv, t_double* x_arr, t_double* y_arr, t_int32* cnt, t_bool* is_spline);
+
+void diffuse_end_ramp   (t_diffuse* x);
+void _diffuse_post_lock   (t_diffuse* x);
+void _diffuse_post_unlock (t_diffuse* x);
+void _diffuse_sync      (t_diffuse* x, t_bool is_stalled);
+void diffuse_sync_tick  (t_diffuse* x);
+void _diffuse_drain     (t_diffuse* x);
+t_bool _diffuse_curves_publish (t_diffuse* x);
+t_atom* _diffuse_reply_begin (t_diffuse* x);
+void    _diffuse_reply_end   (t_diffuse* x, t_atom* mess_arr);
+void    _diffuse_layout    (t_diffuse* x, t_arena* arena);
 
 // ========  CHANNEL METHODS  ========
 
 t_channel* _channel_find  (t_diffuse* x, t_atom* argv);
-void       _channel_init  (t_diffuse* x, t_channel* channel);
-t_my_err   _channel_alloc (t_diffuse* x, t_channel* channel, t_double u, t_double a);
-void       _channel_free  (t_diffuse* x, t_channel* channel);
-
-void       _channel_calc_absc (t_diffuse* x, t_channel* channel);
+t_int32    _channel_select   (t_diffuse* x, t_int32 argc, t_atom* argv);
+t_my_err   _channel_post_sel (t_diffuse* x, t_cmd_type type, t_int32 val_i, t_double val_d);
 
 void channel_channel   (t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv);
 void channel_gain_in   (t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv);
@@ -159,20 +222,13 @@ void channel_mute_ramp (t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv)
 
 // ========  STATE METHODS  ========
 
-void     _state_init  (t_state* state);
-t_my_err _state_alloc (t_state* state, t_int32 param_cnt, t_double u, t_double a);
-void     _state_free  (t_state* state);
-
 t_state* _state_arr_new  (t_int32 _state_cnt, t_int32* state_cnt, t_int32 param_cnt);
 void     _state_arr_free (t_state** state_arr, t_int32* state_cnt);
 
 t_state* _state_find      (t_state* state_arr, t_int32 state_cnt, t_atom* atom);
-void     _state_calc_absc (t_diffuse* x, t_state * state);
 t_my_err _state_store     (t_diffuse* x, t_channel* channel, t_state* state, t_symbol* name);
-void     _state_ramp      (t_diffuse* x, t_channel* channel, t_state* state, t_int32 cntd, t_int32 offset);
-void     _state_iterate   (t_diffuse* x, t_channel* channel);
 
-t_my_err _state_dict_save (t_state* state, t_dictionary* dict_arr_states, t_symbol* state_sym, t_symbol* is_prot);
+t_my_err _state_dict_save (t_state_save* save, t_dictionary* dict_arr_states, t_symbol* state_sym, t_symbol* is_prot);
 t_my_err _state_dict_load (t_dictionary* dict_state, t_state* state);
 
 void state_state        (t_diffuse* x, t_symbol* sym, t_int32 argc, t_atom* argv);
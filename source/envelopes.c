@@ -56,6 +56,51 @@ t_double xfade_sinus_inv(t_double y, t_double a) {
   return (2 * asin(y) / PI);
 }
 
+// ====  BATCH CROSSFADE FUNCTIONS  ====
+// Vector versions of the functions above: y_arr[i] = F(x_arr[i], a)
+
+void xfade_none_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = (x_arr[i] < 0.5) ? 0 : 1; }
+}
+
+void xfade_none_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = (x_arr[i] < 0.5) ? 0 : 1; }
+}
+
+void xfade_linear_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i]; }
+}
+
+void xfade_linear_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i]; }
+}
+
+void xfade_sqrt_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = sqrt(x_arr[i]); }
+}
+
+void xfade_sqrt_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i] * x_arr[i]; }
+}
+
+void xfade_sinus_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i] * PI / 2; }
+  kernels->sin(y_arr, y_arr, cnt);
+}
+
+void xfade_sinus_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  kernels->asin(y_arr, x_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] *= 2 / PI; }
+}
+
 // ====  PROCEDURE: RAMP_NONE and RAMP_NONE_INV ====
 // No ramp from 0 to 1, to 0 to 1
 
@@ -151,6 +196,251 @@ t_double ramp_sigmoid_inv(t_double y, t_double a) {
   return (y);
 }
 
+// ====  BATCH RAMP FUNCTIONS  ====
+// Vector versions of the functions above: y_arr[i] = F(x_arr[i], a)
+// The values outside of the domain are patched after the math kernels
+
+void ramp_none_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = (x_arr[i] < 0.5) ? 0 : 1; }
+}
+
+void ramp_none_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = (x_arr[i] < 0.5) ? 0 : 1; }
+}
+
+void ramp_linear_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i]; }
+}
+
+void ramp_linear_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i]; }
+}
+
+void ramp_poly_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  kernels->log(y_arr, x_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] *= a; }
+  kernels->exp(y_arr, y_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { if (x_arr[i] == 0) { y_arr[i] = 0; } }
+}
+
+void ramp_poly_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  kernels->log(y_arr, x_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] /= a; }
+  kernels->exp(y_arr, y_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { if (x_arr[i] == 0) { y_arr[i] = 0; } }
+}
+
+void ramp_poly_s_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  ramp_poly_arr(kernels, y_arr, x_arr, a, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { if ((a <= 0) || (x_arr[i] <= 0)) { y_arr[i] = 0; } }
+}
+
+void ramp_poly_inv_s_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  if (a <= 0) { for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = 0; } return; }
+  ramp_poly_inv_arr(kernels, y_arr, x_arr, a, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { if (x_arr[i] <= 0) { y_arr[i] = 0; } }
+}
+
+void ramp_exp_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  t_double scale = 1 / (exp(a) - 1);
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = a * x_arr[i]; }
+  kernels->exp(y_arr, y_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = (y_arr[i] - 1) * scale; }
+}
+
+void ramp_exp_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  t_double scale = exp(a) - 1;
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = 1 + x_arr[i] * scale; }
+  kernels->log(y_arr, y_arr, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] /= a; }
+}
+
+void ramp_exp_s_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  if (a == 0) { ramp_linear_arr(kernels, y_arr, x_arr, a, cnt); }
+  else        { ramp_exp_arr(kernels, y_arr, x_arr, a, cnt); }
+}
+
+void ramp_exp_inv_s_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  if (a == 0) { ramp_linear_inv_arr(kernels, y_arr, x_arr, a, cnt); return; }
+
+  t_double scale = exp(a) - 1;
+  ramp_exp_inv_arr(kernels, y_arr, x_arr, a, cnt);
+  for (t_int32 i = 0; i < cnt; i++) { if (1 + x_arr[i] * scale <= 0) { y_arr[i] = 0; } }
+}
+
+void ramp_sigmoid_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i]; }
+}
+
+void ramp_sigmoid_inv_arr(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = x_arr[i]; }
+}
+
+// ====  CURVE_LUT_BUILD  ====
+
+//******************************************************************************
+//  Fill a table for a ramp or crossfade function with a given parameter.
+//  The number of intervals is doubled from CURVE_LUT_SIZE_MIN until the error of the
+//  linear interpolation, measured at the middle of each interval, is within err.
+//  The table has to be allocated with CURVE_LUT_SIZE_MAX + 1 values.
+//  If the bound cannot be met, for instance near a vertical tangent,
+//  the table is left unused and the function has to be evaluated exactly.
+//  Returns true if the table is in use.
+//
+t_bool curve_lut_build(t_curve_lut* lut, t_ramp func, t_double param, t_double err) {
+
+  lut->size = 0;
+  if ((!lut->y_arr) || (err <= 0)) { return false; }
+
+  for (t_int32 size = CURVE_LUT_SIZE_MIN; size <= CURVE_LUT_SIZE_MAX; size *= 2) {
+
+    for (t_int32 ind = 0; ind <= size; ind++) {
+      lut->y_arr[ind] = func((t_double)ind / size, param);
+    }
+
+    t_bool is_within = true;
+    for (t_int32 ind = 0; (ind < size) && (is_within); ind++) {
+      t_double y_mid = func((ind + 0.5) / size, param);
+      is_within = (fabs(y_mid - 0.5 * (lut->y_arr[ind] + lut->y_arr[ind + 1])) <= err);
+    }
+
+    if (is_within) { lut->size = size; return true; }
+  }
+
+  return false;
+}
+
+// ====  CURVE_LUT_EVAL_ARR  ====
+
+//******************************************************************************
+//  Evaluate a table over a vector, by linear interpolation.
+//
+void curve_lut_eval_arr(const t_curve_lut* lut, t_double* y_arr, const t_double* x_arr, t_int32 cnt) {
+
+  for (t_int32 i = 0; i < cnt; i++) { y_arr[i] = curve_lut_eval(lut, x_arr[i]); }
+}
+
+// ====  CURVE_BREAK_EVAL  ====
+
+//******************************************************************************
+//  Evaluate a breakpoint curve at x, with the breakpoints normalized to [0,1].
+//  Linear between the breakpoints, or cubic Hermite with the tangents in m_arr.
+//
+static t_double _curve_break_eval(const t_double* x_arr, const t_double* y_arr, const t_double* m_arr,
+    t_int32 cnt, t_double x) {
+
+  t_int32 k = 0;
+  while ((k < cnt - 2) && (x > x_arr[k + 1])) { k++; }
+
+  t_double h = x_arr[k + 1] - x_arr[k];
+  t_double t = (x - x_arr[k]) / h;
+
+  if (!m_arr) { return y_arr[k] + t * (y_arr[k + 1] - y_arr[k]); }
+
+  t_double t2 = t * t;
+  t_double t3 = t2 * t;
+  return (2 * t3 - 3 * t2 + 1) * y_arr[k] + (t3 - 2 * t2 + t) * h * m_arr[k]
+    + (-2 * t3 + 3 * t2) * y_arr[k + 1] + (t3 - t2) * h * m_arr[k + 1];
+}
+
+// ====  CURVE_BREAK_BUILD  ====
+
+//******************************************************************************
+//  Compile a breakpoint curve into a table and the table of its inverse, CURVE_BREAK_SIZE intervals each.
+//  The tables have to be allocated with CURVE_BREAK_SIZE + 1 values.
+//  The abscissas have to be strictly increasing and the ordinates increasing, with distinct end points:
+//  both are normalized to [0,1]. The spline is a monotone cubic (Fritsch-Carlson),
+//  so that it does not overshoot between the breakpoints and can be inverted.
+//  The inverse is found by bisection, which is only done here and not when ramping.
+//  Returns false if the breakpoints are invalid, and the tables are unchanged.
+//
+t_bool curve_break_build(t_curve_lut* lut, t_curve_lut* inv_lut,
+    const t_double* x_arr, const t_double* y_arr, t_int32 cnt, t_bool is_spline) {
+
+  t_double x_nrm[CURVE_BREAK_CNT_MAX];
+  t_double y_nrm[CURVE_BREAK_CNT_MAX];
+  t_double m_arr[CURVE_BREAK_CNT_MAX];
+
+  if ((!lut->y_arr) || (!inv_lut->y_arr) || (cnt < 2) || (cnt > CURVE_BREAK_CNT_MAX)) { return false; }
+  if (!(y_arr[cnt - 1] > y_arr[0])) { return false; }
+  for (t_int32 k = 0; k < cnt - 1; k++) {
+    if ((!(x_arr[k + 1] > x_arr[k])) || (y_arr[k + 1] < y_arr[k])) { return false; }
+  }
+
+  // Normalize to [0,1], with exact end points
+  for (t_int32 k = 0; k < cnt; k++) {
+    x_nrm[k] = (x_arr[k] - x_arr[0]) / (x_arr[cnt - 1] - x_arr[0]);
+    y_nrm[k] = (y_arr[k] - y_arr[0]) / (y_arr[cnt - 1] - y_arr[0]);
+  }
+  x_nrm[cnt - 1] = 1;
+  y_nrm[cnt - 1] = 1;
+
+  // Monotone tangents: the average of the secants, 0 at a flat segment, limited to avoid overshoot
+  if (is_spline) {
+
+    for (t_int32 k = 0; k < cnt; k++) {
+      t_double d_prev = (k > 0) ? (y_nrm[k] - y_nrm[k - 1]) / (x_nrm[k] - x_nrm[k - 1]) : -1;
+      t_double d_next = (k < cnt - 1) ? (y_nrm[k + 1] - y_nrm[k]) / (x_nrm[k + 1] - x_nrm[k]) : -1;
+      if (d_prev < 0) { d_prev = d_next; }
+      if (d_next < 0) { d_next = d_prev; }
+      m_arr[k] = ((d_prev == 0) || (d_next == 0)) ? 0 : (d_prev + d_next) / 2;
+    }
+
+    for (t_int32 k = 0; k < cnt - 1; k++) {
+      t_double d = (y_nrm[k + 1] - y_nrm[k]) / (x_nrm[k + 1] - x_nrm[k]);
+      if (d == 0) { continue; }
+      t_double alpha = m_arr[k] / d;
+      t_double beta = m_arr[k + 1] / d;
+      t_double norm = alpha * alpha + beta * beta;
+      if (norm > 9) {
+        t_double tau = 3 / sqrt(norm);
+        m_arr[k] = tau * alpha * d;
+        m_arr[k + 1] = tau * beta * d;
+      }
+    }
+  }
+
+  const t_double* m_ptr = is_spline ? m_arr : NULL;
+
+  for (t_int32 ind = 0; ind <= CURVE_BREAK_SIZE; ind++) {
+    t_double x = (t_double)ind / CURVE_BREAK_SIZE;
+    t_double y = _curve_break_eval(x_nrm, y_nrm, m_ptr, cnt, x);
+    lut->y_arr[ind] = (y < 0) ? 0 : ((y > 1) ? 1 : y);
+
+    // Inverse: the smallest abscissa that reaches the ordinate, by bisection on the increasing curve
+    t_double lo = 0;
+    t_double hi = 1;
+    for (t_int32 iter = 0; iter < 60; iter++) {
+      t_double mid = 0.5 * (lo + hi);
+      if (_curve_break_eval(x_nrm, y_nrm, m_ptr, cnt, mid) < x) { lo = mid; } else { hi = mid; }
+    }
+    inv_lut->y_arr[ind] = hi;
+  }
+
+  lut->y_arr[0] = 0;
+  lut->y_arr[CURVE_BREAK_SIZE] = 1;
+  inv_lut->y_arr[0] = 0;
+  inv_lut->y_arr[CURVE_BREAK_SIZE] = 1;
+  lut->size = CURVE_BREAK_SIZE;
+  inv_lut->size = CURVE_BREAK_SIZE;
+
+  return true;
+}
+
 // ====  PROCEDURE: RECTANGULAR_UNIT  ====
 // Rectangular function from 0 to 1
 
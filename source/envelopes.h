@@ -3,8 +3,8 @@
 
 // ========  HEADER FILE FOR MISCELLANEOUS MAX UTILITIES  ========
 
-#include "ext.h"      // Header file for all objects, should always be first
-#include "z_dsp.h"    // Header file for MSP objects
+#include "core_types.h"  // Max headers or the headless types
+#include "diffuse_kernels.h"  // Math kernels used by the batch functions
 
 // ====  OUTPUTTING INFORMATION  ====
 
@@ -26,6 +26,7 @@ typedef enum _xfade_type {
   XFADE_LINEAR,
   XFADE_SQRT,
   XFADE_SINUSOIDAL,
+  XFADE_TABLE,      // Breakpoint curve, compiled into a curve table
   XFADE_LAST
 
 } t_xfade_type;
@@ -41,6 +42,15 @@ t_double xfade_sinus_inv  (t_double y, t_double a);
 
 typedef t_double(*t_xfade)(t_double, t_double);
 
+void xfade_none_arr       (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void xfade_none_inv_arr   (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void xfade_linear_arr     (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void xfade_linear_inv_arr (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void xfade_sqrt_arr       (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void xfade_sqrt_inv_arr   (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void xfade_sinus_arr      (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void xfade_sinus_inv_arr  (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+
 // ==  RAMP FUNCTIONS  ==
 //     F: [0,1] --> [0,1]
 //          0   -->   1
@@ -53,10 +63,13 @@ typedef enum _ramp_type {
   RAMP_POLY,
   RAMP_EXP,
   RAMP_SIGMOID,
+  RAMP_TABLE,       // Breakpoint curve, compiled into a curve table
   RAMP_LAST
 
 } t_ramp_type;
 
+#define RAMP_EXP_PARAM_MAX  700.0   // Above this exp(a) overflows in ramp_exp and ramp_exp_inv
+
 t_double ramp_none        (t_double x, t_double a);
 t_double ramp_none_inv    (t_double y, t_double a);
 t_double ramp_linear      (t_double x, t_double a);
@@ -74,6 +87,82 @@ t_double ramp_sigmoid_inv (t_double y, t_double a);
 
 typedef t_double(*t_ramp)(t_double, t_double);
 
+void ramp_none_arr        (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_none_inv_arr    (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_linear_arr      (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_linear_inv_arr  (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_poly_arr        (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_poly_inv_arr    (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_poly_s_arr      (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_poly_inv_s_arr  (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_exp_arr         (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_exp_inv_arr     (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_exp_s_arr       (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_exp_inv_s_arr   (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_sigmoid_arr     (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+void ramp_sigmoid_inv_arr (const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+
+//******************************************************************************
+//  Batch version of a ramp or crossfade function, over a vector:  y_arr[i] = F(x_arr[i], a)
+//  Uses the math kernels of the instruction set selected for the core.
+//  const t_kernels* kernels:  The kernels providing exp, log, sin and asin
+//  t_double* y_arr:  The output vector, must not overlap x_arr
+//  t_double* x_arr:  The input vector
+//  t_double a:  The parameter of the function
+//  t_int32 cnt:  The number of values
+//
+typedef void (*t_ramp_arr)(const t_kernels* kernels, t_double* y_arr, const t_double* x_arr, t_double a, t_int32 cnt);
+
+// ==  CURVE TABLES  ==
+//     Lookup tables with linear interpolation for the ramp and crossfade functions,
+//     and their inverses, over [0,1]
+
+#define CURVE_LUT_SIZE_MIN  16      // Number of intervals of the smallest table tried
+#define CURVE_LUT_SIZE_MAX  4096    // Number of intervals of the largest table
+#define CURVE_LUT_ERR_DEF   1e-6    // Default error bound: -120 dB
+
+typedef struct _curve_lut {
+
+  t_double* y_arr;    // size + 1 values of the function on a uniform grid over [0,1]
+  t_int32   size;     // Number of intervals, 0 if the table is not in use
+
+} t_curve_lut;
+
+t_bool curve_lut_build    (t_curve_lut* lut, t_ramp func, t_double param, t_double err);
+void   curve_lut_eval_arr (const t_curve_lut* lut, t_double* y_arr, const t_double* x_arr, t_int32 cnt);
+
+//******************************************************************************
+//  Return the table if it is in use, or NULL to evaluate the function exactly.
+//
+static inline const t_curve_lut* curve_lut_get(const t_curve_lut* lut) {
+
+  return ((lut->size > 0) ? lut : NULL);
+}
+
+//******************************************************************************
+//  Evaluate a table at x, by linear interpolation. x is clipped to [0,1].
+//
+static inline t_double curve_lut_eval(const t_curve_lut* lut, t_double x) {
+
+  t_double pos = x * lut->size;
+  if (pos <= 0) { return lut->y_arr[0]; }
+  if (pos >= lut->size) { return lut->y_arr[lut->size]; }
+
+  t_int32 ind = (t_int32)pos;
+  t_double frac = pos - ind;
+  return lut->y_arr[ind] + frac * (lut->y_arr[ind + 1] - lut->y_arr[ind]);
+}
+
+// ==  BREAKPOINT CURVES  ==
+//     User defined monotonic curves through breakpoints, compiled into a curve table and its inverse,
+//     so that they cost the same as a built-in curve with its tables
+
+#define CURVE_BREAK_CNT_MAX  64     // Maximum number of breakpoints
+#define CURVE_BREAK_SIZE     1024   // Number of intervals of the compiled tables
+
+t_bool curve_break_build (t_curve_lut* lut, t_curve_lut* inv_lut,
+  const t_double* x_arr, const t_double* y_arr, t_int32 cnt, t_bool is_spline);
+
 // ==  ENVELOPE FUNCTIONS  ==
 //     F: [0,1] --> [0,1]    max(F) = 1
 //          0   -->   0      (or close to it)
@@ -0,0 +1,818 @@
+//******************************************************************************
+//  @file
+//  diffuse_test - Tests of the headless core against its reference paths
+//  Yves Candau - ycandau@gmail.com
+//
+//  Usage:
+//  diffuse_test
+//
+//  Each fast path is checked against the simpler path it replaces:
+//    kernels:  Each SIMD kernel supported by the CPU against the scalar kernel
+//    threads:  The perform routine split across threads against one thread
+//    blocked:  The blocked engine against the route loop
+//    exact:    Exact exponential ramps against ramp_exp
+//    break:    Breakpoint tables and their inverses, built directly and through the core
+//    queue:    Batches and cancellation of the command queue, and posted against direct changes
+//
+//  Prints one line per check, and returns 0 if all the checks passed and 1 otherwise.
+//
+
+// ========  HEADER FILES  ========
+
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "diffuse_core.h"
+
+// ========  DEFINES  ========
+
+#define TEST_SAMPLERATE  48000.0
+#define TEST_LEN         263     // Longest kernel vector: odd, so that every vector width has a tail
+#define TEST_THREADS     4       // Number of threads compared against one thread
+
+#define ARR_CNT(arr) ((t_int32)(sizeof(arr) / sizeof(arr[0])))
+
+// ========  STRUCTURES  ========
+
+//******************************************************************************
+//  A core with its signal vectors and two states to ramp to.
+//
+typedef struct _rig {
+
+  t_core     core[1];
+  t_state    states[2];
+  t_double** in_arr;
+  t_double** out_arr;
+  t_int32    vec_size;
+  t_int32    silent_in;   // Index of an input that stays silent, -1 for none
+  int64_t    smp_time;    // Sample time of the next vector of the inputs
+
+} t_rig;
+
+// ========  GLOBAL VARIABLES  ========
+
+static const char* simd_names[SIMD_LAST] = { "scalar", "sse2", "avx2", "avx512", "auto" };
+
+static t_int32 check_cnt = 0;
+static t_int32 fail_cnt = 0;
+
+// ========  FUNCTIONS  ========
+
+// ====  TEST_CHECK  ====
+
+//******************************************************************************
+//  Record one check: an error measured against a tolerance. A NaN error fails.
+//
+static void test_check(const char* group, const char* name, t_double err, t_double tol) {
+
+  t_bool is_ok = (err <= tol);
+  check_cnt++;
+  if (!is_ok) { fail_cnt++; }
+  printf("%-8s %-40s %-4s  err %-12g tol %g\n", group, name, is_ok ? "ok" : "FAIL", err, tol);
+}
+
+// ====  TEST_TRUE  ====
+
+static void test_true(const char* group, const char* name, t_bool is_ok) {
+
+  check_cnt++;
+  if (!is_ok) { fail_cnt++; }
+  printf("%-8s %-40s %s\n", group, name, is_ok ? "ok" : "FAIL");
+}
+
+// ====  TEST_MAX  ====
+
+//******************************************************************************
+//  Largest of two errors, keeping NaN so that it fails the check.
+//
+static t_double test_max(t_double err, t_double d) {
+
+  return (isnan(err) || (d <= err)) ? err : d;
+}
+
+// ====  TEST_DIFF  ====
+
+//******************************************************************************
+//  Largest absolute difference between two vectors. NaN if any value is NaN.
+//
+static t_double test_diff(const t_double* x_arr, const t_double* y_arr, t_int32 cnt) {
+
+  t_double diff = 0;
+  for (t_int32 i = 0; i < cnt; i++) {
+    diff = test_max(diff, fabs(x_arr[i] - y_arr[i]));
+  }
+  return diff;
+}
+
+// ====  TEST_DIFF_REL  ====
+
+//******************************************************************************
+//  Largest difference relative to the reference, absolute below 1.
+//
+static t_double test_diff_rel(const t_double* x_arr, const t_double* ref_arr, t_int32 cnt) {
+
+  t_double diff = 0;
+  for (t_int32 i = 0; i < cnt; i++) {
+    diff = test_max(diff, fabs(x_arr[i] - ref_arr[i]) / MAX(1, fabs(ref_arr[i])));
+  }
+  return diff;
+}
+
+// ====  RIG_NEW  ====
+
+//******************************************************************************
+//  Initialize and allocate a rig, with vectors of vec_size samples.
+//  The states are allocated with all their values at 0, the tests set them.
+//
+static t_my_err rig_new(t_rig* rig, t_int32 channel_cnt, t_int32 out_cnt, t_int32 vec_size,
+    t_simd_type simd_type, t_int32 thread_cnt) {
+
+  t_core* core = rig->core;
+
+  core_init(core, channel_cnt, out_cnt, TEST_SAMPLERATE);
+  core->kernels = kernels_select(simd_type);
+  core_set_threads(core, thread_cnt);
+  _state_init(rig->states, NULL);
+  _state_init(rig->states + 1, NULL);
+  rig->vec_size = vec_size;
+  rig->silent_in = -1;
+  rig->smp_time = 0;
+
+  rig->in_arr = (t_double**)calloc(channel_cnt, sizeof(t_double*));
+  rig->out_arr = (t_double**)calloc(out_cnt, sizeof(t_double*));
+  if (!rig->in_arr || !rig->out_arr) { return ERR_ALLOC; }
+
+  for (t_int32 in = 0; in < channel_cnt; in++) {
+    if (!(rig->in_arr[in] = (t_double*)malloc(sizeof(t_double) * vec_size))) { return ERR_ALLOC; }
+  }
+  for (t_int32 out = 0; out < out_cnt; out++) {
+    if (!(rig->out_arr[out] = (t_double*)malloc(sizeof(t_double) * vec_size))) { return ERR_ALLOC; }
+  }
+
+  if (core_alloc(core) != ERR_NONE) { return ERR_ALLOC; }
+  if (_state_alloc(rig->states, out_cnt, 0, 0) != ERR_NONE) { return ERR_ALLOC; }
+  if (_state_alloc(rig->states + 1, out_cnt, 0, 0) != ERR_NONE) { return ERR_ALLOC; }
+  rig->states[0].index = 0;
+  rig->states[1].index = 1;
+
+  return core_dsp(core, TEST_SAMPLERATE, vec_size);
+}
+
+// ====  RIG_FREE  ====
+
+static void rig_free(t_rig* rig) {
+
+  if (rig->in_arr) {
+    for (t_int32 in = 0; in < rig->core->channel_cnt; in++) { free(rig->in_arr[in]); }
+    free(rig->in_arr);
+  }
+  if (rig->out_arr) {
+    for (t_int32 out = 0; out < rig->core->out_cnt; out++) { free(rig->out_arr[out]); }
+    free(rig->out_arr);
+  }
+
+  core_free(rig->core);
+  _state_free(rig->states);
+  _state_free(rig->states + 1);
+}
+
+// ====  RIG_PERFORM  ====
+
+//******************************************************************************
+//  Fill the inputs with the next vector of distinct sinusoids, and run the perform routine.
+//
+static void rig_perform(t_rig* rig) {
+
+  for (t_int32 in = 0; in < rig->core->channel_cnt; in++) {
+    for (t_int32 smp = 0; smp < rig->vec_size; smp++) {
+      rig->in_arr[in][smp] = (in == rig->silent_in) ? 0 : sin(0.013 * (rig->smp_time + smp) + 0.7 * in);
+    }
+  }
+
+  core_perform(rig->core, rig->in_arr, rig->out_arr, rig->vec_size);
+  rig->smp_time += rig->vec_size;
+}
+
+// ====  RIG_DIFF  ====
+
+//******************************************************************************
+//  Largest difference between the outputs of two rigs of the same size.
+//
+static t_double rig_diff(t_rig* rig1, t_rig* rig2) {
+
+  t_double diff = 0;
+  for (t_int32 out = 0; out < rig1->core->out_cnt; out++) {
+    diff = test_max(diff, test_diff(rig1->out_arr[out], rig2->out_arr[out], rig1->vec_size));
+  }
+  return diff;
+}
+
+// ====  RIG_SET_STATE  ====
+
+//******************************************************************************
+//  Set the values of a state, with some outputs at 0, and calculate its abscissas.
+//
+static void rig_set_state(t_rig* rig, t_int32 index, t_int32 seed) {
+
+  t_state* state = rig->states + index;
+  for (t_int32 out = 0; out < rig->core->out_cnt; out++) {
+    state->A_arr[out] = ((out + seed) % 3) ? 0.2 + 0.7 * (t_double)((out * 5 + seed) % 11) / 11.0 : 0;
+  }
+  _state_calc_absc(rig->core, state);
+  state->U_cur = state->U_xf_arr;
+}
+
+// ====  TEST_KERNELS  ====
+
+//******************************************************************************
+//  Each SIMD kernel against the scalar kernel, over lengths that exercise the tails,
+//  with a misaligned input, and both storing and accumulating.
+//
+static void test_kernels(void) {
+
+  static const t_int32 len_arr[] = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 64, 100, TEST_LEN - 1 };
+
+  const t_kernels* ref = kernels_select(SIMD_SCALAR);
+  t_simd_type simd_max = kernels_detect();
+
+  t_double in[TEST_LEN + 1];
+  t_double out_ref[TEST_LEN];
+  t_double out[TEST_LEN];
+  t_double mix_in[5][TEST_LEN + 1];
+  t_double mix_ref[KERNELS_MIX_OUT][TEST_LEN];
+  t_double mix_out[KERNELS_MIX_OUT][TEST_LEN];
+  t_double gain[5][9];
+  t_double x_arr[4][TEST_LEN];
+  t_double y_ref[TEST_LEN];
+  t_double y_arr[TEST_LEN];
+  char name[64];
+
+  for (t_int32 smp = 0; smp < TEST_LEN + 1; smp++) { in[smp] = sin(0.37 * smp + 0.1); }
+  for (t_int32 i = 0; i < 5; i++) {
+    for (t_int32 smp = 0; smp < TEST_LEN + 1; smp++) { mix_in[i][smp] = cos(0.11 * smp * (i + 1)); }
+    for (t_int32 j = 0; j < 9; j++) { gain[i][j] = 0.1 * ((i * 9 + j) % 13) - 0.4; }
+  }
+
+  // Arguments of the math kernels over their domains, with the end points and special values
+  for (t_int32 i = 0; i < TEST_LEN; i++) {
+    t_double t = (t_double)i / (TEST_LEN - 1);
+    x_arr[0][i] = -40 + 80 * t;
+    x_arr[1][i] = exp(-700 + 1400 * t);
+    x_arr[2][i] = -M_PI / 2 + M_PI * t;
+    x_arr[3][i] = -1 + 2 * t;
+  }
+  x_arr[0][0] = KERNELS_EXP_MIN - 10;
+  x_arr[0][1] = KERNELS_EXP_MAX + 10;
+  x_arr[0][2] = 0;
+  x_arr[1][0] = 1;
+  x_arr[1][1] = DBL_MIN;
+
+  if (simd_max == SIMD_SCALAR) { printf("kernels  no SIMD kernels supported by this CPU\n"); }
+
+  // The scalar elementary functions against the standard library, away from the clipped ends
+  t_double (*libm_arr[4])(t_double) = { exp, log, sin, asin };
+  t_kernel_math ref_math[4] = { ref->exp, ref->log, ref->sin, ref->asin };
+  const char* math_names[4] = { "exp", "log", "sin", "asin" };
+
+  for (t_int32 f = 0; f < 4; f++) {
+    t_int32 first = (f == 0) ? 2 : 0;
+    for (t_int32 i = first; i < TEST_LEN; i++) { y_ref[i] = libm_arr[f](x_arr[f][i]); }
+    ref_math[f](y_arr + first, x_arr[f] + first, TEST_LEN - first);
+    snprintf(name, sizeof(name), "scalar %s against libm", math_names[f]);
+    test_check("kernels", name, test_diff_rel(y_arr + first, y_ref + first, TEST_LEN - first), 1e-14);
+  }
+
+  for (t_int32 simd = SIMD_SSE2; simd <= (t_int32)simd_max; simd++) {
+
+    const t_kernels* kernels = kernels_select((t_simd_type)simd);
+    t_double err_fix = 0, err_var = 0, err_geo = 0, err_mix = 0;
+
+    for (t_int32 l = 0; l < ARR_CNT(len_arr); l++) {
+      for (t_int32 is_first = 0; is_first < 2; is_first++) {
+        for (t_int32 ofs = 0; ofs < 2; ofs++) {
+
+          t_int32 len = len_arr[l];
+          const t_double* sig_in = in + ofs;
+
+          for (t_int32 smp = 0; smp < TEST_LEN; smp++) { out_ref[smp] = out[smp] = 0.25 * cos(0.5 * smp); }
+          ref->fix(out_ref, sig_in, 0.7, len, is_first);
+          kernels->fix(out, sig_in, 0.7, len, is_first);
+          err_fix = test_max(err_fix, test_diff(out, out_ref, TEST_LEN));
+
+          for (t_int32 smp = 0; smp < TEST_LEN; smp++) { out_ref[smp] = out[smp] = 0.25 * cos(0.5 * smp); }
+          ref->var(out_ref, sig_in, 0.3, 0.002, len, is_first);
+          kernels->var(out, sig_in, 0.3, 0.002, len, is_first);
+          err_var = test_max(err_var, test_diff(out, out_ref, TEST_LEN));
+
+          for (t_int32 smp = 0; smp < TEST_LEN; smp++) { out_ref[smp] = out[smp] = 0.25 * cos(0.5 * smp); }
+          ref->geo(out_ref, sig_in, 0.9, 0.9995, 0.0004, len, is_first);
+          kernels->geo(out, sig_in, 0.9, 0.9995, 0.0004, len, is_first);
+          err_geo = test_max(err_geo, test_diff(out, out_ref, TEST_LEN));
+
+          // A block of 5 inputs into the outputs 3 to 6 of the rows, starting at sample ofs
+          t_double* ref_ptr[KERNELS_MIX_OUT];
+          t_double* out_ptr[KERNELS_MIX_OUT];
+          t_double* in_ptr[5];
+          const t_double* gain_ptr[5];
+          for (t_int32 k = 0; k < KERNELS_MIX_OUT; k++) {
+            for (t_int32 smp = 0; smp < TEST_LEN; smp++) { mix_ref[k][smp] = mix_out[k][smp] = 0.1 * k + 0.01 * smp; }
+            ref_ptr[k] = mix_ref[k];
+            out_ptr[k] = mix_out[k];
+          }
+          for (t_int32 i = 0; i < 5; i++) { in_ptr[i] = mix_in[i]; gain_ptr[i] = gain[i]; }
+          t_int32 mix_len = MIN(len, TEST_LEN - ofs);
+          ref->mix(ref_ptr, in_ptr, gain_ptr, 3, 5, ofs, mix_len, is_first);
+          kernels->mix(out_ptr, in_ptr, gain_ptr, 3, 5, ofs, mix_len, is_first);
+          for (t_int32 k = 0; k < KERNELS_MIX_OUT; k++) {
+            err_mix = test_max(err_mix, test_diff(mix_out[k], mix_ref[k], TEST_LEN));
+          }
+        }
+      }
+    }
+
+    snprintf(name, sizeof(name), "%s fix", simd_names[simd]);
+    test_check("kernels", name, err_fix, 1e-15);
+    snprintf(name, sizeof(name), "%s var", simd_names[simd]);
+    test_check("kernels", name, err_var, 1e-14);
+    snprintf(name, sizeof(name), "%s geo", simd_names[simd]);
+    test_check("kernels", name, err_geo, 1e-12);
+    snprintf(name, sizeof(name), "%s mix", simd_names[simd]);
+    test_check("kernels", name, err_mix, 1e-14);
+
+    // The elementary functions, over each length and in place
+    t_kernel_math math[4] = { kernels->exp, kernels->log, kernels->sin, kernels->asin };
+
+    for (t_int32 f = 0; f < 4; f++) {
+      t_double err = 0;
+      ref_math[f](y_ref, x_arr[f], TEST_LEN);
+      for (t_int32 l = 0; l < ARR_CNT(len_arr); l++) {
+        for (t_int32 i = 0; i < TEST_LEN; i++) { y_arr[i] = -1; }
+        math[f](y_arr, x_arr[f], len_arr[l]);
+        err = test_max(err, test_diff_rel(y_arr, y_ref, len_arr[l]));
+        if (len_arr[l] < TEST_LEN && y_arr[len_arr[l]] != -1) { err = INFINITY; }
+      }
+      memcpy(y_arr, x_arr[f], sizeof(y_arr));
+      math[f](y_arr, y_arr, TEST_LEN);
+      err = test_max(err, test_diff_rel(y_arr, y_ref, TEST_LEN));
+
+      snprintf(name, sizeof(name), "%s %s", simd_names[simd], math_names[f]);
+      test_check("kernels", name, err, 1e-14);
+    }
+  }
+}
+
+// ====  TEST_THREADS  ====
+
+//******************************************************************************
+//  The perform routine on TEST_THREADS threads against one thread, vector by vector.
+//  The helpers add their channels into partial outputs, added together at the end:
+//  the order of the additions differs, so the outputs only agree to rounding.
+//  The ramps end at different samples, and the ramp completions have to be the same.
+//
+static void test_threads(void) {
+
+  t_rig rigs[2];
+  memset(rigs, 0, sizeof(rigs));
+
+  if ((rig_new(rigs, 96, 64, 128, SIMD_AUTO, 1) != ERR_NONE)
+    || (rig_new(rigs + 1, 96, 64, 128, SIMD_AUTO, TEST_THREADS) != ERR_NONE)) {
+    test_true("threads", "allocation", false);
+    rig_free(rigs);
+    rig_free(rigs + 1);
+    return;
+  }
+
+  test_true("threads", "helper threads started", rigs[1].core->workers != NULL);
+
+  for (t_int32 r = 0; r < 2; r++) {
+
+    t_rig* rig = rigs + r;
+    t_core* core = rig->core;
+    core->thread_routes_min = 1024;
+    core->end_is_on = true;
+    rig->silent_in = 5;
+    rig_set_state(rig, 0, 1);
+
+    for (t_int32 in = 0; in < core->channel_cnt; in++) {
+
+      t_channel* channel = core->channel_arr + in;
+      channel->is_on = (in % 11 != 3);
+      if (in % 4 == 0) {
+        for (t_int32 out = 0; out < core->out_cnt; out++) { channel->A_cur[out] = 0.5 * ((in + out) % 3); }
+        _channel_calc_absc(core, channel);
+        _channel_calc_routes(core, channel);
+        continue;
+      }
+      if (in % 7 == 1) { channel->velocity = 0.6; }
+      _channel_set_interp(core, channel, INTERP_TYPE_XFADE);
+      _state_ramp(core, channel, rig->states, 1000 + 37 * in, in);
+    }
+  }
+
+  t_double diff = 0;
+  t_int32 end_cnt = 0;
+  t_bool is_end_same = true;
+
+  for (t_int32 vec = 0; vec < 200; vec++) {
+
+    rig_perform(rigs);
+    rig_perform(rigs + 1);
+    diff = test_max(diff, rig_diff(rigs, rigs + 1));
+
+    t_end_event* end1;
+    t_end_event* end2;
+    while ((end1 = core_end_front(rigs[0].core))) {
+      end2 = core_end_front(rigs[1].core);
+      if ((!end2) || (end1->time != end2->time) || (end1->channel != end2->channel) || (end1->state != end2->state)) {
+        is_end_same = false;
+      }
+      core_end_pop(rigs[0].core);
+      if (end2) { core_end_pop(rigs[1].core); }
+      end_cnt++;
+    }
+    if (core_end_front(rigs[1].core)) { is_end_same = false; }
+  }
+
+  test_check("threads", "outputs of 1 and 4 threads", diff, 1e-12);
+  test_true("threads", "same ramp completions", is_end_same && (end_cnt > 0));
+
+  rig_free(rigs);
+  rig_free(rigs + 1);
+}
+
+// ====  TEST_BLOCKED  ====
+
+//******************************************************************************
+//  The blocked engine against the route loop, for each kernel type, with small tiles
+//  so that the vectors and the inputs have partial tiles. One channel ramps for a while,
+//  so that the blocked engine hands over to the route loop and back.
+//
+static void test_blocked(void) {
+
+  char name[64];
+
+  for (t_int32 simd = SIMD_SCALAR; simd <= (t_int32)kernels_detect(); simd++) {
+
+    t_rig rigs[2];
+    memset(rigs, 0, sizeof(rigs));
+
+    if ((rig_new(rigs, 13, 11, 200, (t_simd_type)simd, 1) != ERR_NONE)
+      || (rig_new(rigs + 1, 13, 11, 200, (t_simd_type)simd, 1) != ERR_NONE)) {
+      test_true("blocked", "allocation", false);
+      rig_free(rigs);
+      rig_free(rigs + 1);
+      return;
+    }
+
+    for (t_int32 r = 0; r < 2; r++) {
+
+      t_rig* rig = rigs + r;
+      t_core* core = rig->core;
+      rig->silent_in = 4;
+      rig_set_state(rig, 0, 2);
+
+      for (t_int32 in = 0; in < core->channel_cnt; in++) {
+        t_channel* channel = core->channel_arr + in;
+        channel->is_on = ((in % 5) != 2);
+        channel->gain = 0.5 + 0.1 * in;
+        for (t_int32 out = 0; out < core->out_cnt; out++) { channel->A_cur[out] = ((in * 7 + out * 3) % 5) / 4.0; }
+        _channel_calc_absc(core, channel);
+        _channel_calc_routes(core, channel);
+      }
+      for (t_int32 out = 0; out < core->out_cnt; out++) { core->out_gain[out] = 1 + 0.1 * out; }
+
+      core->mix_smp_tile = 48;
+      core->mix_in_tile = 3;
+      core->mix_density_min = 0;
+    }
+
+    // Route loop only
+    rigs[1].core->mix_vec_max = 0;
+
+    t_double diff = 0;
+    for (t_int32 vec = 0; vec < 12; vec++) {
+
+      if (vec == 3) {
+        for (t_int32 r = 0; r < 2; r++) {
+          core_post_ramp(rigs[r].core, 6, INTERP_TYPE_XFADE, rigs[r].states, 500, 0);
+        }
+      }
+      rig_perform(rigs);
+      rig_perform(rigs + 1);
+      diff = test_max(diff, rig_diff(rigs, rigs + 1));
+    }
+
+    snprintf(name, sizeof(name), "%s blocked against route loop", simd_names[simd]);
+    test_check("blocked", name, diff, 1e-13);
+
+    rig_free(rigs);
+    rig_free(rigs + 1);
+  }
+}
+
+// ====  TEST_EXACT  ====
+
+//******************************************************************************
+//  Exact exponential ramps against ramp_exp evaluated at each sample,
+//  for each kernel type and vector sizes that do not divide the ramp.
+//
+static void test_exact(void) {
+
+  static const t_int32 vec_arr[] = { 37, 64, 512 };
+  const t_int32 cntd = 5000;
+  char name[64];
+
+  for (t_int32 simd = SIMD_SCALAR; simd <= (t_int32)kernels_detect(); simd++) {
+    for (t_int32 v = 0; v < ARR_CNT(vec_arr); v++) {
+
+      t_rig rig[1];
+      memset(rig, 0, sizeof(rig));
+      if (rig_new(rig, 1, 2, vec_arr[v], (t_simd_type)simd, 1) != ERR_NONE) {
+        test_true("exact", "allocation", false);
+        rig_free(rig);
+        return;
+      }
+
+      t_core* core = rig->core;
+      t_channel* channel = core->channel_arr;
+      core->ramp_is_exact = true;
+      core_set_ramp(core, RAMP_EXP, 4.0);
+      core_curves_publish(core);
+      core_cmd_drain(core);
+
+      // Constant input of 1, the output 0 ramps from 0.01 to 1
+      t_state* state = rig->states;
+      state->A_arr[0] = 1;
+      state->A_arr[1] = 0.5;
+      _state_calc_absc(core, state);
+      state->U_cur = state->U_rm_arr;
+
+      channel->is_on = true;
+      channel->A_cur[0] = 0.01;
+      _channel_set_interp(core, channel, INTERP_TYPE_RAMP);
+      _channel_calc_absc(core, channel);
+      t_double u0 = channel->U_cur[0];
+      t_double u1 = state->U_rm_arr[0];
+      _state_ramp(core, channel, state, cntd, 0);
+
+      t_double err = 0;
+      t_double last = 0;
+      for (t_int32 smp = 0; smp < cntd + vec_arr[v]; smp += vec_arr[v]) {
+        for (t_int32 i = 0; i < vec_arr[v]; i++) { rig->in_arr[0][i] = 1; }
+        core_perform(core, rig->in_arr, rig->out_arr, vec_arr[v]);
+        for (t_int32 i = 0; (i < vec_arr[v]) && (smp + i < cntd); i++) {
+          t_double ref = ramp_exp(u0 + (smp + i) * (u1 - u0) / cntd, 4.0);
+          err = test_max(err, fabs(rig->out_arr[0][i] - ref));
+        }
+        last = rig->out_arr[0][vec_arr[v] - 1];
+      }
+
+      snprintf(name, sizeof(name), "%s vector %i against ramp_exp", simd_names[simd], vec_arr[v]);
+      test_check("exact", name, err, 1e-12);
+      snprintf(name, sizeof(name), "%s vector %i end of ramp", simd_names[simd], vec_arr[v]);
+      test_check("exact", name, fabs(last - 1), 1e-12);
+
+      rig_free(rig);
+    }
+  }
+}
+
+// ====  TEST_BREAK_ROUND  ====
+
+//******************************************************************************
+//  Round trips of a table and its inverse over a fine grid: y = f(f_inv(y)) and x = f_inv(f(x)).
+//  The second only holds where the curve is not flat.
+//
+static void test_break_round(const char* name, const t_curve_lut* lut, const t_curve_lut* inv_lut,
+    t_double tol, t_bool is_flat) {
+
+  char text[64];
+  t_double err_y = 0;
+  t_double err_x = 0;
+  t_bool is_mono = true;
+  t_double prev = -1;
+
+  for (t_int32 i = 0; i <= 4096; i++) {
+    t_double t = i / 4096.0;
+    t_double y = curve_lut_eval(lut, t);
+    if (y < prev) { is_mono = false; }
+    prev = y;
+    err_y = test_max(err_y, fabs(curve_lut_eval(lut, curve_lut_eval(inv_lut, t)) - t));
+    err_x = test_max(err_x, fabs(curve_lut_eval(inv_lut, y) - t));
+  }
+
+  snprintf(text, sizeof(text), "%s increasing", name);
+  test_true("break", text, is_mono && (lut->y_arr[0] == 0) && (lut->y_arr[lut->size] == 1));
+  snprintf(text, sizeof(text), "%s table of inverse", name);
+  test_check("break", text, err_y, tol);
+  if (!is_flat) {
+    snprintf(text, sizeof(text), "%s inverse of table", name);
+    test_check("break", text, err_x, tol);
+  }
+}
+
+// ====  TEST_BREAK  ====
+
+//******************************************************************************
+//  Breakpoint tables: the linear table against the segments, the round trips through the inverse,
+//  the rejection of invalid breakpoints, and the same curves published and used by the core.
+//
+static void test_break(void) {
+
+  static t_double lut_y[CURVE_BREAK_SIZE + 1];
+  static t_double inv_y[CURVE_BREAK_SIZE + 1];
+  static t_double copy_y[CURVE_BREAK_SIZE + 1];
+  t_curve_lut lut = { lut_y, 0 };
+  t_curve_lut inv_lut = { inv_y, 0 };
+
+  // Linear: the table holds the segments at the grid
+  const t_double x1[4] = { 0, 0.2, 0.5, 1 };
+  const t_double y1[4] = { 0, 0.5, 0.6, 1 };
+  test_true("break", "linear built", curve_break_build(&lut, &inv_lut, x1, y1, 4, false));
+
+  t_double err = 0;
+  for (t_int32 ind = 0; ind <= CURVE_BREAK_SIZE; ind++) {
+    t_double x = (t_double)ind / CURVE_BREAK_SIZE;
+    t_int32 k = (x <= 0.2) ? 0 : ((x <= 0.5) ? 1 : 2);
+    t_double y = y1[k] + (x - x1[k]) * (y1[k + 1] - y1[k]) / (x1[k + 1] - x1[k]);
+    err = test_max(err, fabs(lut.y_arr[ind] - y));
+  }
+  test_check("break", "linear table against segments", err, 1e-14);
+  test_break_round("linear", &lut, &inv_lut, 1e-3, false);
+
+  // Spline through unnormalized breakpoints, with a flat segment
+  const t_double x2[4] = { 0, 1, 2, 3 };
+  const t_double y2[4] = { 0, 0, 5, 10 };
+  test_true("break", "spline built", curve_break_build(&lut, &inv_lut, x2, y2, 4, true));
+  test_break_round("spline", &lut, &inv_lut, 1e-3, true);
+
+  // Invalid breakpoints are rejected and the tables are unchanged
+  const t_double x_bad[3] = { 0, 0.5, 0.4 };
+  const t_double y_bad[3] = { 0, 0.8, 0.7 };
+  const t_double y_flat[3] = { 0.5, 0.5, 0.5 };
+  memcpy(copy_y, lut_y, sizeof(copy_y));
+  t_bool is_rejected = !curve_break_build(&lut, &inv_lut, x_bad, y1, 3, false)
+    && !curve_break_build(&lut, &inv_lut, x1, y_bad, 3, false)
+    && !curve_break_build(&lut, &inv_lut, x1, y_flat, 3, true)
+    && !curve_break_build(&lut, &inv_lut, x1, y1, 1, false)
+    && !curve_break_build(&lut, &inv_lut, x1, y1, CURVE_BREAK_CNT_MAX + 1, false);
+  test_true("break", "invalid breakpoints rejected", is_rejected && !memcmp(copy_y, lut_y, sizeof(copy_y)));
+
+  // Through the core: the ramp function of the published curves and its inverse
+  t_core core[1];
+  core_init(core, 2, 2, TEST_SAMPLERATE);
+  if ((core_alloc(core) != ERR_NONE) || (core_dsp(core, TEST_SAMPLERATE, 64) != ERR_NONE)) {
+    test_true("break", "allocation", false);
+    core_free(core);
+    return;
+  }
+
+  test_true("break", "table ramp refused before a table",
+    core_set_ramp(core, RAMP_TABLE, 1) == ERR_ARG_VALUE);
+  test_true("break", "core table set",
+    core_set_ramp_table(core, x2, y2, 4, true) == ERR_NONE);
+  test_true("break", "core table published",
+    (core_curves_publish(core) == ERR_NONE) && (core->curves->ramp_type == RAMP_TABLE));
+  core_cmd_drain(core);
+
+  t_double u_arr[1025], a_arr[1025], u2_arr[1025], a2_arr[1025];
+  for (t_int32 i = 0; i <= 1024; i++) { u_arr[i] = i / 1024.0; }
+  _core_interp_arr(core, INTERP_TYPE_RAMP, a_arr, u_arr, 1025);
+  _core_interp_inv_arr(core, INTERP_TYPE_RAMP, u2_arr, a_arr, 1025);
+  _core_interp_arr(core, INTERP_TYPE_RAMP, a2_arr, u2_arr, 1025);
+  test_check("break", "core ramp of inverse", test_diff(a2_arr, a_arr, 1025), 1e-3);
+
+  core_free(core);
+}
+
+// ====  TEST_QUEUE_RUN  ====
+
+//******************************************************************************
+//  Run a core with a set of changes, either posted through the queue or applied directly.
+//  Returns a weighted sum of the outputs.
+//
+static t_double test_queue_run(t_bool is_posted) {
+
+  t_rig rig[1];
+  memset(rig, 0, sizeof(rig));
+  if (rig_new(rig, 3, 4, 64, SIMD_AUTO, 1) != ERR_NONE) {
+    rig_free(rig);
+    return NAN;
+  }
+
+  t_core* core = rig->core;
+  t_state* state = rig->states;
+  for (t_int32 out = 0; out < 4; out++) { state->A_arr[out] = 0.2 * (out + 1); }
+  _state_calc_absc(core, state);
+  state->U_cur = state->U_xf_arr;
+  t_double gains[4] = { 0.5, 0, 0.25, 1 };
+
+  if (is_posted) {
+    core_post(core, CMD_ON, -1, 1, 0, 0);
+    core_post_gains(core, 1, gains);
+    core_post(core, CMD_VELOCITY, 2, 0, 1.5, 0);
+    core_post_ramp(core, 0, INTERP_TYPE_XFADE, state, 3000, 1);
+    core_post_ramp(core, 2, INTERP_TYPE_XFADE, state, 2000, 0);
+    core_post(core, CMD_GAIN_OUT, 3, 0, 0.5, 0);
+    core_post(core, CMD_MASTER, -1, 0, 0.8, 0);
+  }
+  else {
+    for (t_int32 in = 0; in < 3; in++) { core->channel_arr[in].is_on = true; }
+    for (t_int32 out = 0; out < 4; out++) { core->channel_arr[1].A_cur[out] = gains[out]; }
+    _channel_calc_routes(core, core->channel_arr + 1);
+    core->channel_arr[1].is_gain_dirty = true;
+    core->channel_arr[2].velocity = 1.5;
+    _channel_set_interp(core, core->channel_arr, INTERP_TYPE_XFADE);
+    _state_ramp(core, core->channel_arr, state, 3000, 1);
+    _channel_set_interp(core, core->channel_arr + 2, INTERP_TYPE_XFADE);
+    _state_ramp(core, core->channel_arr + 2, state, 2000, 0);
+    core_set_gain_out(core, 3, 0.5);
+    core_set_master(core, 0.8);
+  }
+
+  t_double acc = 0;
+  for (t_int32 vec = 0; vec < 80; vec++) {
+    rig_perform(rig);
+    for (t_int32 out = 0; out < 4; out++) {
+      for (t_int32 smp = 0; smp < 64; smp++) { acc += rig->out_arr[out][smp] * (out + 1) * (smp % 7 + 1); }
+    }
+  }
+
+  rig_free(rig);
+  return acc;
+}
+
+// ====  TEST_QUEUE  ====
+
+//******************************************************************************
+//  The command queue: a batch is only applied once it is ended, a cancelled batch is dropped
+//  and frees its slots, the rings refuse commands when full, and posted changes have the same
+//  result as the same changes applied directly.
+//
+static void test_queue(void) {
+
+  t_core core[1];
+  t_double gains[2] = { 1, 1 };
+
+  core_init(core, 40, 2, TEST_SAMPLERATE);
+  if (core_alloc(core) != ERR_NONE) {
+    test_true("queue", "allocation", false);
+    core_free(core);
+    return;
+  }
+
+  core_post_begin(core);
+  for (t_int32 in = 0; in < 40; in++) { core_post(core, CMD_VELOCITY, in, 0, 2.0, 0); }
+  core_cmd_drain(core);
+  test_true("queue", "batch not applied before its end", core->channel_arr[5].velocity == 1);
+  core_post_end(core);
+  core_cmd_drain(core);
+  test_true("queue", "batch applied after its end",
+    (core->channel_arr[0].velocity == 2) && (core->channel_arr[39].velocity == 2));
+
+  core_post_begin(core);
+  core_post(core, CMD_VELOCITY, 1, 0, 3.0, 0);
+  core_post_cancel(core);
+  core_cmd_drain(core);
+  test_true("queue", "cancelled batch dropped", core->channel_arr[1].velocity == 2);
+
+  // A batch that fills the rows, cancelled: the rows are free again
+  t_int32 cnt = 0;
+  core_post_begin(core);
+  while (core_post_gains(core, 0, gains) == ERR_NONE) { cnt++; }
+  core_post_cancel(core);
+  test_true("queue", "batch holds all the rows", cnt == core->cmd_row_cnt);
+  test_true("queue", "rows free after cancel", core_post_gains(core, 0, gains) == ERR_NONE);
+  core_cmd_drain(core);
+
+  // Full rings refuse commands until they are drained
+  cnt = 0;
+  while (core_post(core, CMD_MASTER, -1, 0, 1, 0) == ERR_NONE) { cnt++; }
+  test_true("queue", "ring holds all the commands", cnt == core->cmd_ring_size);
+  core_cmd_drain(core);
+  test_true("queue", "ring empty after drain", core_cmd_is_empty(core)
+    && (core_post(core, CMD_MASTER, -1, 0, 1, 0) == ERR_NONE));
+  core_cmd_drain(core);
+
+  core_free(core);
+
+  t_double direct = test_queue_run(false);
+  t_double posted = test_queue_run(true);
+  test_check("queue", "posted against direct", fabs(posted - direct), 0);
+}
+
+// ========  MAIN  ========
+
+int main(int argc, char** argv) {
+
+  test_kernels();
+  test_threads();
+  test_blocked();
+  test_exact();
+  test_break();
+  test_queue();
+
+  printf("\n%i checks, %i failed\n", check_cnt, fail_cnt);
+  return (fail_cnt > 0) ? 1 : 0;
+}